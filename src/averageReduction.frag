@@ -0,0 +1,17 @@
+uniform sampler2DRect tex;
+uniform float blockSize;
+
+/* mean of a blockSize square, summed row by row as the CPU decoder does */
+void main()
+{
+    vec2 sampleBase = gl_TexCoord[0].st - vec2(0.5, 0.5) * blockSize + vec2(0.5, 0.5);
+    float acc = 0.0;
+    for (float j = 0.0; j < blockSize; j += 1.0)
+    {
+        for (float i = 0.0; i < blockSize; i += 1.0)
+        {
+            acc += texture2DRect(tex, sampleBase + vec2(i, j)).r;
+        }
+    }
+    gl_FragData[0] = vec4(acc / (blockSize * blockSize));
+}
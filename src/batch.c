@@ -0,0 +1,345 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#include "errors.h"
+#include "imageio.h"
+#include "batch.h"
+
+typedef struct batchJob {
+    size_t index;
+    char* inPath;
+    grayImage* img;
+    fractureEncoding* enc;
+    struct batchJob* next;
+} batchJob;
+
+/* blocking FIFO between pipeline stages, closed when its last producer finishes */
+typedef struct jobQueue {
+    pthread_mutex_t lock;
+    pthread_cond_t notEmpty;
+    pthread_cond_t notFull;
+    batchJob* head;
+    batchJob* tail;
+    size_t length;
+    size_t capacity;            /* 0 for unbounded */
+    size_t producers;
+} jobQueue;
+
+typedef struct batchState {
+    const batchOptions* bo;
+    char** inputs;
+    size_t count;
+    pthread_mutex_t nextLock;
+    size_t nextInput;
+    jobQueue decoded;
+    jobQueue encoded;
+} batchState;
+
+static void initJobQueue(jobQueue* q, size_t capacity, size_t producers)
+{
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->notEmpty, NULL);
+    pthread_cond_init(&q->notFull, NULL);
+    q->head = NULL;
+    q->tail = NULL;
+    q->length = 0;
+    q->capacity = capacity;
+    q->producers = producers;
+}
+
+static void destroyJobQueue(jobQueue* q)
+{
+    pthread_mutex_destroy(&q->lock);
+    pthread_cond_destroy(&q->notEmpty);
+    pthread_cond_destroy(&q->notFull);
+}
+
+static void pushJob(jobQueue* q, batchJob* job)
+{
+    pthread_mutex_lock(&q->lock);
+    while (q->capacity > 0 && q->length >= q->capacity)
+    {
+        pthread_cond_wait(&q->notFull, &q->lock);
+    }
+    job->next = NULL;
+    if (q->tail != NULL)
+    {
+        q->tail->next = job;
+    }
+    else
+    {
+        q->head = job;
+    }
+    q->tail = job;
+    q->length++;
+    pthread_cond_signal(&q->notEmpty);
+    pthread_mutex_unlock(&q->lock);
+}
+
+/* NULL once the queue is empty and closed */
+static batchJob* popJob(jobQueue* q)
+{
+    pthread_mutex_lock(&q->lock);
+    while (q->head == NULL && q->producers > 0)
+    {
+        pthread_cond_wait(&q->notEmpty, &q->lock);
+    }
+    batchJob* job = q->head;
+    if (job != NULL)
+    {
+        q->head = job->next;
+        if (q->head == NULL)
+        {
+            q->tail = NULL;
+        }
+        q->length--;
+        pthread_cond_signal(&q->notFull);
+    }
+    pthread_mutex_unlock(&q->lock);
+    
+    return job;
+}
+
+static void finishProducer(jobQueue* q)
+{
+    pthread_mutex_lock(&q->lock);
+    q->producers--;
+    pthread_cond_broadcast(&q->notEmpty);
+    pthread_mutex_unlock(&q->lock);
+}
+
+/* "dir/lena.png" -> "lena" */
+static char* createBaseName(const char* path)
+{
+    const char* start = strrchr(path, '/');
+    start = start != NULL ? start + 1 : path;
+    const char* end = strrchr(start, '.');
+    if (end == NULL)
+    {
+        end = start + strlen(start);
+    }
+    return strndup(start, end - start);
+}
+
+static void* readerMain(void* arg)
+{
+    batchState* bs = arg;
+    for (;;)
+    {
+        pthread_mutex_lock(&bs->nextLock);
+        size_t index = bs->nextInput++;
+        pthread_mutex_unlock(&bs->nextLock);
+        if (index >= bs->count)
+        {
+            break;
+        }
+        
+        batchJob* job = calloc(1, sizeof(batchJob));
+        job->index = index;
+        job->inPath = bs->inputs[index];
+        const char* failure;
+        job->img = loadGrayImage(job->inPath, &failure);
+        CHK_NULL(job->img, (char*)failure, job->inPath);
+        pushJob(&bs->decoded, job);
+    }
+    finishProducer(&bs->decoded);
+    
+    return NULL;
+}
+
+static void* writerMain(void* arg)
+{
+    batchState* bs = arg;
+    batchJob* job;
+    while ((job = popJob(&bs->encoded)) != NULL)
+    {
+        char* base = createBaseName(job->inPath);
+        char* trnOutPath;
+        asprintf(&trnOutPath, "OpenGL-%s%s.trn", base, bs->bo->outSuffix);
+        
+        FILE* trnOutFile = fopen(trnOutPath, "w");
+        CHK_NULL(trnOutFile, "fopen() failed", trnOutPath);
+        writeFractureEncoding(trnOutFile, job->enc);
+        fclose(trnOutFile);
+        
+        releaseFractureEncoding(job->enc);
+        free(trnOutPath);
+        free(base);
+        free(job);
+    }
+    
+    return NULL;
+}
+
+void runBatch(fractureContext* fc, char** inputs, size_t count, const batchOptions* bo)
+{
+    batchState bs;
+    bs.bo = bo;
+    bs.inputs = inputs;
+    bs.count = count;
+    bs.nextInput = 0;
+    pthread_mutex_init(&bs.nextLock, NULL);
+    fractureSequence* seq = NULL;
+    size_t numReaders = bo->numReaders;
+    if (bo->changeThreshold >= 0.0)
+    {
+        seq = createFractureSequence(fc, bo->d_size, bo->r_size, bo->changeThreshold);
+        numReaders = 1;
+    }
+    initJobQueue(&bs.decoded, bo->prefetch, numReaders);
+    initJobQueue(&bs.encoded, 0, 1);
+    
+    struct timeval start, end;
+    gettimeofday(&start, NULL);
+    
+    pthread_t* readers = malloc(numReaders * sizeof(pthread_t));
+    pthread_t* writers = malloc(bo->numWriters * sizeof(pthread_t));
+    size_t i;
+    for (i = 0; i < numReaders; i++)
+    {
+        if (pthread_create(&readers[i], NULL, readerMain, &bs) != 0) ERR("pthread_create() failed", "reader");
+    }
+    for (i = 0; i < bo->numWriters; i++)
+    {
+        if (pthread_create(&writers[i], NULL, writerMain, &bs) != 0) ERR("pthread_create() failed", "writer");
+    }
+    
+    /* the encoder stays on this thread, which owns the context */
+    size_t done = 0;
+    size_t rangesSearched = 0;
+    size_t numRanges = 0;
+    batchJob* job;
+    while ((job = popJob(&bs.decoded)) != NULL)
+    {
+        grayImage* img = job->img;
+        if (seq != NULL)
+        {
+            job->enc = fractureEncodeFrame(seq, img->data, img->w, img->h, img->stride);
+        }
+        else
+        {
+            job->enc = fractureEncode(fc, img->data, img->w, img->h, img->stride, bo->d_size, bo->r_size);
+        }
+        releaseGrayImage(img);
+        job->img = NULL;
+        rangesSearched += job->enc->rangesSearched;
+        numRanges += job->enc->rangeCols * job->enc->rangeRows;
+        printf("%d / %d %s", (int)++done, (int)count, job->inPath);
+        if (seq != NULL)
+        {
+            printf(" (%d / %d ranges searched)",
+                (int)job->enc->rangesSearched, (int)(job->enc->rangeCols * job->enc->rangeRows));
+        }
+        printf("\n");
+        pushJob(&bs.encoded, job);
+    }
+    finishProducer(&bs.encoded);
+    
+    for (i = 0; i < numReaders; i++)
+    {
+        pthread_join(readers[i], NULL);
+    }
+    for (i = 0; i < bo->numWriters; i++)
+    {
+        pthread_join(writers[i], NULL);
+    }
+    
+    gettimeofday(&end, NULL);
+    double seconds = (end.tv_sec - start.tv_sec) + 1e-6 * (end.tv_usec - start.tv_usec);
+    printf("batch: %d images in %0.2f s (%0.2f images/s)\n",
+        (int)count, seconds, count / seconds);
+    if (seq != NULL)
+    {
+        printf("sequence: %0.2f%% of ranges searched\n", 100.0 * rangesSearched / numRanges);
+        releaseFractureSequence(seq);
+    }
+    
+    free(readers);
+    free(writers);
+    destroyJobQueue(&bs.decoded);
+    destroyJobQueue(&bs.encoded);
+    pthread_mutex_destroy(&bs.nextLock);
+}
+
+static int compareStrings(const void* a, const void* b)
+{
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+char** createBatchInputList(const char* path, size_t* count)
+{
+    size_t capacity = 64;
+    char** inputs = malloc(capacity * sizeof(char*));
+    *count = 0;
+    
+    struct stat st;
+    CHK_SYSCALL(stat(path, &st), "stat() failed", (char*)path);
+    if (S_ISDIR(st.st_mode))
+    {
+        DIR* dir = opendir(path);
+        CHK_NULL(dir, "opendir() failed", (char*)path);
+        struct dirent* entry;
+        while ((entry = readdir(dir)) != NULL)
+        {
+            size_t len = strlen(entry->d_name);
+            const char* ext = len < 4 ? "" : entry->d_name + len - 4;
+            if (strcmp(".png", ext) != 0 && strcmp(".pgm", ext) != 0 && strcmp(".raw", ext) != 0)
+            {
+                continue;
+            }
+            if (*count == capacity)
+            {
+                capacity *= 2;
+                inputs = realloc(inputs, capacity * sizeof(char*));
+            }
+            asprintf(&inputs[(*count)++], "%s/%s", path, entry->d_name);
+        }
+        closedir(dir);
+        
+        /* readdir order is arbitrary */
+        qsort(inputs, *count, sizeof(char*), compareStrings);
+    }
+    else
+    {
+        FILE* listFile = fopen(path, "r");
+        CHK_NULL(listFile, "fopen() failed", (char*)path);
+        char line[4096];
+        while (fgets(line, sizeof(line), listFile) != NULL)
+        {
+            line[strcspn(line, "\r\n")] = '\0';
+            if (line[0] == '\0' || line[0] == '#')
+            {
+                continue;
+            }
+            if (*count == capacity)
+            {
+                capacity *= 2;
+                inputs = realloc(inputs, capacity * sizeof(char*));
+            }
+            inputs[(*count)++] = strdup(line);
+        }
+        fclose(listFile);
+    }
+    
+    if (*count == 0)
+    {
+        ERR("no input images", (char*)path);
+    }
+    
+    return inputs;
+}
+
+void releaseBatchInputList(char** inputs, size_t count)
+{
+    size_t i;
+    for (i = 0; i < count; i++)
+    {
+        free(inputs[i]);
+    }
+    free(inputs);
+}
@@ -0,0 +1,35 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdlib.h>
+
+#include "fracture.h"
+
+/*
+ * batch encoding of many images with one warm fractureContext
+ *
+ * Reader threads decode or map the next images while the calling thread encodes,
+ * and writer threads write finished transforms as .trn files, so the
+ * encoder only waits on I/O when the readers fall behind.
+ *
+ * As a sequence, one reader keeps the frames in order and each frame only
+ * searches the ranges that changed, see fractureEncodeFrame.
+ */
+
+typedef struct batchOptions {
+    size_t d_size;
+    size_t r_size;
+    const char* outSuffix;      /* e.g. "-HD", appended to each output base name */
+    size_t numReaders;
+    size_t numWriters;
+    size_t prefetch;            /* decoded images waiting for the encoder, at most */
+    float changeThreshold;      /* >= 0 encodes the inputs in order as frames of one sequence */
+} batchOptions;
+
+/* inputs: a directory of .png, .pgm and .raw files, or a text file listing one path per line */
+char** createBatchInputList(const char* path, size_t* count);
+void releaseBatchInputList(char** inputs, size_t count);
+
+void runBatch(fractureContext* fc, char** inputs, size_t count, const batchOptions* bo);
+
+#endif
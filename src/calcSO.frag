@@ -11,7 +11,7 @@ uniform float r_j;
 void main()
 {
     vec2 tc = gl_TexCoord[0].st;
-    float packedOrigin = (tc.x * float(originXMult) + tc.y) * 2.0;
+    float packedOrigin = floor(tc.x) * float(originXMult) + floor(tc.y);
     
     vec4 PD = texture2DRect(sumD_sumD2_sumDr_tex, tc);
     float sumD  = PD.r;
@@ -0,0 +1,162 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "errors.h"
+#include "glio.h"
+
+#include "computeenc.h"
+
+#ifdef GL_ARB_compute_shader
+
+#define DOMAINS_PER_GROUP 64
+#define RANGES_PER_GROUP 16
+
+static float floatFromOrderedKey(GLuint key)
+{
+    GLuint u = (key & 0x80000000u) ? (key & 0x7FFFFFFFu) : ~key;
+    float f;
+    memcpy(&f, &u, sizeof(f));
+    return f;
+}
+
+computeEncoder* createComputeEncoder(glContextObj cgl_ctx)
+{
+    const char* extensions = (const char*)glGetString(GL_EXTENSIONS);
+    if (extensions == NULL || strstr(extensions, "GL_ARB_compute_shader") == NULL)
+    {
+        return NULL;
+    }
+    
+    computeEncoder* ce = calloc(1, sizeof(computeEncoder));
+    ce->cgl_ctx = cgl_ctx;
+    
+    ce->searchComputeShader.program = loadComputeProgram(cgl_ctx, "searchCompute.comp");
+    GET_UNIFORM(ce->searchComputeShader, srcTex);
+    GET_UNIFORM(ce->searchComputeShader, r_size);
+    GET_UNIFORM(ce->searchComputeShader, m);
+    GET_UNIFORM(ce->searchComputeShader, rangeCols);
+    GET_UNIFORM(ce->searchComputeShader, numRanges);
+    GET_UNIFORM(ce->searchComputeShader, domainCols);
+    GET_UNIFORM(ce->searchComputeShader, numDomains);
+    GET_UNIFORM(ce->searchComputeShader, phase);
+    CHK_OGL;
+    
+    return ce;
+}
+
+void releaseComputeEncoder(computeEncoder* ce)
+{
+    glContextObj cgl_ctx = ce->cgl_ctx;
+    
+    glDeleteProgram(ce->searchComputeShader.program);
+    CHK_OGL;
+    
+    free(ce);
+}
+
+void computeSearchAll(computeEncoder* ce,
+    texInfo* srcImgT,
+    size_t d_size, size_t r_size,
+    rangeTransform* transforms)
+{
+    glContextObj cgl_ctx = ce->cgl_ctx;
+    
+    int m = 0;
+    while ((r_size << m) < d_size)
+    {
+        m++;
+    }
+    if (r_size > 8 || (r_size << m) != d_size)
+    {
+        ERR("unsupported block sizes for compute shader", "");
+    }
+    
+    size_t rangeCols = srcImgT->w / r_size;
+    size_t numRanges = rangeCols * (srcImgT->h / r_size);
+    size_t domainCols = (srcImgT->w >> m) / r_size;
+    size_t numDomains = domainCols * ((srcImgT->h >> m) / r_size);
+    
+    glUseProgram(ce->searchComputeShader.program);
+    glUniform1i(ce->searchComputeShader.srcTex, 0 /* GL_TEXTURE0 */);
+    glUniform1i(ce->searchComputeShader.r_size, r_size);
+    glUniform1i(ce->searchComputeShader.m, m);
+    glUniform1i(ce->searchComputeShader.rangeCols, rangeCols);
+    glUniform1i(ce->searchComputeShader.numRanges, numRanges);
+    glUniform1i(ce->searchComputeShader.domainCols, domainCols);
+    glUniform1i(ce->searchComputeShader.numDomains, numDomains);
+    CHK_OGL;
+    
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_RECTANGLE_ARB, srcImgT->tex);
+    
+    /* every key and Morton index starts at the maximum so atomicMin can lower it */
+    size_t bestLen = numRanges * 4 * sizeof(GLuint);
+    GLuint* best = malloc(bestLen);
+    memset(best, 0xFF, bestLen);
+    GLuint ssbo;
+    glGenBuffers(1, &ssbo);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, bestLen, best, GL_DYNAMIC_COPY);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, ssbo);
+    CHK_OGL;
+    
+    GLint phase;
+    for (phase = 0; phase < 3; phase++)
+    {
+        glUniform1i(ce->searchComputeShader.phase, phase);
+        glDispatchCompute(
+            (numDomains + DOMAINS_PER_GROUP - 1) / DOMAINS_PER_GROUP,
+            (numRanges + RANGES_PER_GROUP - 1) / RANGES_PER_GROUP,
+            1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        CHK_OGL;
+    }
+    
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, bestLen, best);
+    CHK_OGL;
+    
+    size_t r;
+    for (r = 0; r < numRanges; r++)
+    {
+        GLuint* b = best + 4 * r;
+        rangeTransform* t = &transforms[r];
+        t->MSE = floatFromOrderedKey(b[0]);
+        memcpy(&t->s, &b[2], sizeof(float));
+        memcpy(&t->o, &b[3], sizeof(float));
+        t->d_i = 0;
+        t->d_j = 0;
+        t->iso = 0;
+        size_t bit;
+        for (bit = 0; bit < 16; bit++)
+        {
+            t->d_i |= ((b[1] >> (2 * bit)) & 1) << bit;
+            t->d_j |= ((b[1] >> (2 * bit + 1)) & 1) << bit;
+        }
+    }
+    
+    free(best);
+    glDeleteBuffers(1, &ssbo);
+    CHK_OGL;
+}
+
+#else
+
+computeEncoder* createComputeEncoder(glContextObj cgl_ctx)
+{
+    return NULL;
+}
+
+void releaseComputeEncoder(computeEncoder* ce)
+{
+}
+
+void computeSearchAll(computeEncoder* ce,
+    texInfo* srcImgT,
+    size_t d_size, size_t r_size,
+    rangeTransform* transforms)
+{
+    ERR("compute shaders not supported by this OpenGL", "");
+}
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef COMPUTEENC_H
+#define COMPUTEENC_H
+
+#include <stdlib.h>
+
+#include "glcontext.h"
+#include "glio.h"
+#include "glenc.h"
+#include "transform.h"
+
+/*
+ * GL 4.3 compute shader encoder
+ *
+ * searchCompute.comp reads range and domain blocks straight from the source
+ * texture, so there are no intermediate textures or framebuffer binds; the
+ * only other GPU object is one SSBO with a (key, Morton index, s, o) record
+ * per range. Only available where the GL headers define compute shaders.
+ */
+
+typedef struct searchComputeProgram {
+    GLuint program;
+    GLint srcTex;
+    GLint r_size;
+    GLint m;
+    GLint rangeCols;
+    GLint numRanges;
+    GLint domainCols;
+    GLint numDomains;
+    GLint phase;
+} searchComputeProgram;
+
+/* the program and its uniform locations, built once per GL context */
+typedef struct computeEncoder {
+    glContextObj cgl_ctx;
+    searchComputeProgram searchComputeShader;
+} computeEncoder;
+
+/* NULL when the context has no compute shaders */
+computeEncoder* createComputeEncoder(glContextObj cgl_ctx);
+void releaseComputeEncoder(computeEncoder* ce);
+
+void computeSearchAll(computeEncoder* ce,
+    texInfo* srcImgT,
+    size_t d_size, size_t r_size,
+    rangeTransform* transforms);
+
+#endif
@@ -0,0 +1,746 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+/* AVX2 kernels are built whatever the compiler flags and chosen at run time */
+#define CPUENC_AVX2
+#endif
+
+#include "errors.h"
+
+#include "cpuenc.h"
+
+/* r_size <= 8, so no block is longer than 64 samples */
+static const int16_t ones[64] __attribute__((aligned(64))) = {
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1
+};
+
+static void* allocBlocks(size_t count, size_t nPad)
+{
+    void* p;
+    if (posix_memalign(&p, 64, count * nPad * sizeof(int16_t)) != 0)
+    {
+        ERR("posix_memalign() failed", "");
+    }
+    memset(p, 0, count * nPad * sizeof(int16_t));
+    return p;
+}
+
+/* the sum and sum of squares of every size x size window of img, from running sums */
+static void windowSums(const int32_t* img, size_t w, size_t h, size_t size, size_t step,
+    size_t cols, size_t rows, int32_t* sums, int32_t* sums2)
+{
+    /* column sums over the window's rows, moved down by step rows at a time */
+    int32_t* colSum = calloc(w, sizeof(int32_t));
+    int32_t* colSum2 = calloc(w, sizeof(int32_t));
+    size_t x, y, bi, bj, top = 0;
+    for (y = 0; y < size; y++)
+    {
+        for (x = 0; x < w; x++)
+        {
+            colSum[x] += img[y * w + x];
+            colSum2[x] += img[y * w + x] * img[y * w + x];
+        }
+    }
+    
+    for (bj = 0; bj < rows; bj++)
+    {
+        for (; top < bj * step; top++)
+        {
+            for (x = 0; x < w; x++)
+            {
+                int32_t out = img[top * w + x];
+                int32_t in = img[(top + size) * w + x];
+                colSum[x] += in - out;
+                colSum2[x] += in * in - out * out;
+            }
+        }
+        
+        /* and the window slid along them */
+        int32_t sum = 0, sum2 = 0;
+        size_t left = 0;
+        for (x = 0; x < size; x++)
+        {
+            sum += colSum[x];
+            sum2 += colSum2[x];
+        }
+        for (bi = 0; bi < cols; bi++)
+        {
+            for (; left < bi * step; left++)
+            {
+                sum += colSum[left + size] - colSum[left];
+                sum2 += colSum2[left + size] - colSum2[left];
+            }
+            sums[bj * cols + bi] = sum;
+            sums2[bj * cols + bi] = sum2;
+        }
+    }
+    
+    free(colSum);
+    free(colSum2);
+}
+
+cpuEncodeData* createCPUEncodeData(
+    const uint8_t* pixels, size_t w, size_t h, size_t stride,
+    size_t d_size, size_t r_size, size_t d_step)
+{
+    size_t m = 0;
+    while ((r_size << m) < d_size)
+    {
+        m++;
+    }
+    if (r_size > 8 || (r_size << m) != d_size)
+    {
+        ERR("unsupported block sizes for integer kernels", "");
+    }
+    if (d_step == 0 || (w >> m) < r_size || (h >> m) < r_size)
+    {
+        ERR("bad domain step for image", "");
+    }
+    
+    cpuEncodeData* ced = calloc(1, sizeof(cpuEncodeData));
+    ced->r_size = r_size;
+    ced->n = r_size * r_size;
+    ced->nPad = (ced->n + BLOCK_ALIGN - 1) / BLOCK_ALIGN * BLOCK_ALIGN;
+    ced->rangeCols = w / r_size;
+    ced->rangeRows = h / r_size;
+    ced->domainCols = ((w >> m) - r_size) / d_step + 1;
+    ced->domainRows = ((h >> m) - r_size) / d_step + 1;
+    ced->d_step = d_step;
+    ced->rScale = 1.0 / 255.0;
+    ced->dScale = 1.0 / 255.0;
+    
+    size_t numRanges = ced->rangeCols * ced->rangeRows;
+    size_t numDomains = ced->domainCols * ced->domainRows;
+    ced->rangeBlocks = allocBlocks(numRanges, ced->nPad);
+    ced->domainBlocks = allocBlocks(numDomains, ced->nPad);
+    ced->sumR = malloc(numRanges * sizeof(int32_t));
+    ced->sumR2 = malloc(numRanges * sizeof(int32_t));
+    ced->sumD = malloc(numDomains * sizeof(int32_t));
+    ced->sumD2 = malloc(numDomains * sizeof(int32_t));
+    
+    size_t bi, bj, x, y;
+    
+    /* range blocks straight from the source */
+    for (bj = 0; bj < ced->rangeRows; bj++)
+    {
+        for (bi = 0; bi < ced->rangeCols; bi++)
+        {
+            size_t b = bj * ced->rangeCols + bi;
+            int16_t* block = ced->rangeBlocks + b * ced->nPad;
+            for (y = 0; y < r_size; y++)
+            {
+                for (x = 0; x < r_size; x++)
+                {
+                    block[y * r_size + x] = pixels[(bj * r_size + y) * stride + bi * r_size + x];
+                }
+            }
+            ced->sumR[b] = dotBlocks(block, ones, ced->nPad);
+            ced->sumR2[b] = dotBlocks(block, block, ced->nPad);
+        }
+    }
+    
+    /*
+     * domain blocks: paint() decimates with nearest sampling, which picks the
+     * source pixel at 2^m * x + 2^(m - 1), so do the same to keep the engines
+     * interchangeable
+     */
+    size_t dOff = ((size_t)1 << m) >> 1;
+    size_t dW = w >> m;
+    size_t dH = h >> m;
+    int32_t* decimated = malloc(dW * dH * sizeof(int32_t));
+    for (y = 0; y < dH; y++)
+    {
+        for (x = 0; x < dW; x++)
+        {
+            decimated[y * dW + x] = pixels[((y << m) + dOff) * stride + (x << m) + dOff];
+        }
+    }
+    for (bj = 0; bj < ced->domainRows; bj++)
+    {
+        for (bi = 0; bi < ced->domainCols; bi++)
+        {
+            int16_t* block = ced->domainBlocks + (bj * ced->domainCols + bi) * ced->nPad;
+            for (y = 0; y < r_size; y++)
+            {
+                for (x = 0; x < r_size; x++)
+                {
+                    block[y * r_size + x] = decimated[(bj * d_step + y) * dW + bi * d_step + x];
+                }
+            }
+        }
+    }
+    windowSums(decimated, dW, dH, r_size, d_step,
+        ced->domainCols, ced->domainRows, ced->sumD, ced->sumD2);
+    free(decimated);
+    
+    return ced;
+}
+
+void releaseCPUEncodeData(cpuEncodeData* ced)
+{
+    free(ced->rangeBlocks);
+    free(ced->domainBlocks);
+    free(ced->sumR);
+    free(ced->sumR2);
+    free(ced->sumD);
+    free(ced->sumD2);
+    free(ced->coarseRangeBlocks);
+    free(ced->coarseSumR2);
+    free(ced->coarseDomainSamples);
+    free(ced->coarseSumD);
+    free(ced->coarseSumD2);
+    free(ced->coarseInvS_lo);
+    free(ced->coarseScratch);
+    free(ced->coarseCandidates);
+    free(ced->isometryBlocks);
+    free(ced);
+}
+
+#if defined(CPUENC_AVX2)
+__attribute__((target("avx2")))
+static int32_t dotBlocksAVX2(const int16_t* a, const int16_t* b, size_t nPad)
+{
+    size_t k;
+    __m256i acc = _mm256_setzero_si256();
+    for (k = 0; k < nPad; k += 16)
+    {
+        acc = _mm256_add_epi32(acc, _mm256_madd_epi16(
+            _mm256_load_si256((const __m256i*)(a + k)),
+            _mm256_load_si256((const __m256i*)(b + k))));
+    }
+    __m128i acc4 = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+    acc4 = _mm_add_epi32(acc4, _mm_shuffle_epi32(acc4, _MM_SHUFFLE(1, 0, 3, 2)));
+    acc4 = _mm_add_epi32(acc4, _mm_shuffle_epi32(acc4, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(acc4);
+}
+#endif
+
+/* exact inner product of two packed blocks (pmaddwd) */
+int32_t dotBlocks(const int16_t* a, const int16_t* b, size_t nPad)
+{
+    size_t k;
+#if defined(__SSE2__)
+    __m128i acc = _mm_setzero_si128();
+    for (k = 0; k < nPad; k += 8)
+    {
+        acc = _mm_add_epi32(acc, _mm_madd_epi16(
+            _mm_load_si128((const __m128i*)(a + k)),
+            _mm_load_si128((const __m128i*)(b + k))));
+    }
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(acc);
+#else
+    int32_t acc = 0;
+    for (k = 0; k < nPad; k++)
+    {
+        acc += (int32_t)a[k] * b[k];
+    }
+    return acc;
+#endif
+}
+
+/* inner products of one block with NUM_ISOMETRIES consecutive blocks, reading a once */
+static void dotBlocksIsometries(const int16_t* a, const int16_t* b, size_t nPad, int32_t* dots)
+{
+    size_t k;
+    int i;
+#if defined(__SSE2__)
+    __m128i acc[NUM_ISOMETRIES];
+    for (i = 0; i < NUM_ISOMETRIES; i++)
+    {
+        acc[i] = _mm_setzero_si128();
+    }
+    for (k = 0; k < nPad; k += 8)
+    {
+        __m128i ak = _mm_load_si128((const __m128i*)(a + k));
+        for (i = 0; i < NUM_ISOMETRIES; i++)
+        {
+            acc[i] = _mm_add_epi32(acc[i], _mm_madd_epi16(ak,
+                _mm_load_si128((const __m128i*)(b + i * nPad + k))));
+        }
+    }
+    /* four horizontal sums at a time, transposing as they are added */
+    for (i = 0; i < NUM_ISOMETRIES; i += 4)
+    {
+        __m128i s01 = _mm_add_epi32(_mm_unpacklo_epi32(acc[i], acc[i + 1]), _mm_unpackhi_epi32(acc[i], acc[i + 1]));
+        __m128i s23 = _mm_add_epi32(_mm_unpacklo_epi32(acc[i + 2], acc[i + 3]), _mm_unpackhi_epi32(acc[i + 2], acc[i + 3]));
+        _mm_storeu_si128((__m128i*)(dots + i),
+            _mm_add_epi32(_mm_unpacklo_epi64(s01, s23), _mm_unpackhi_epi64(s01, s23)));
+    }
+#else
+    for (i = 0; i < NUM_ISOMETRIES; i++)
+    {
+        dots[i] = 0;
+    }
+    for (k = 0; k < nPad; k++)
+    {
+        for (i = 0; i < NUM_ISOMETRIES; i++)
+        {
+            dots[i] += (int32_t)a[k] * b[i * nPad + k];
+        }
+    }
+#endif
+}
+
+/* the orientation fitSO would give the least squared error, with its S_lo inverted once */
+static int bestIsometry(const int32_t* sumDr, float n, float sumD, float sumD2, float sumR,
+    float drScale, float invS_lo)
+{
+    int iso, best = 0;
+#if defined(__SSE2__)
+    __m128 error[2];
+    for (iso = 0; iso < NUM_ISOMETRIES; iso += 4)
+    {
+        __m128 x = _mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128((const __m128i*)(sumDr + iso))), _mm_set1_ps(drScale));
+        __m128 S = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(n), x), _mm_set1_ps(sumR * sumD)), _mm_set1_ps(invS_lo));
+        S = _mm_max_ps(S, _mm_set1_ps(-1.0f + FIT_EPSILON));
+        S = _mm_min_ps(S, _mm_set1_ps( 1.0f - FIT_EPSILON));
+        __m128 O = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(sumR), _mm_mul_ps(S, _mm_set1_ps(sumD))), _mm_set1_ps(1.0f / n));
+        __m128 e = _mm_mul_ps(S, _mm_add_ps(_mm_mul_ps(S, _mm_set1_ps(sumD2)),
+            _mm_mul_ps(_mm_set1_ps(2.0f), _mm_sub_ps(_mm_mul_ps(O, _mm_set1_ps(sumD)), x))));
+        error[iso / 4] = _mm_add_ps(e, _mm_mul_ps(O, _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(n), O), _mm_set1_ps(2.0f * sumR))));
+    }
+    __m128 m = _mm_min_ps(error[0], error[1]);
+    m = _mm_min_ps(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(1, 0, 3, 2)));
+    m = _mm_min_ps(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(2, 3, 0, 1)));
+    int mask = _mm_movemask_ps(_mm_cmpeq_ps(error[0], m)) | (_mm_movemask_ps(_mm_cmpeq_ps(error[1], m)) << 4);
+    best = mask != 0 ? __builtin_ctz(mask) : 0;
+#else
+    float error[NUM_ISOMETRIES];
+    for (iso = 0; iso < NUM_ISOMETRIES; iso++)
+    {
+        float x = sumDr[iso] * drScale;
+        float S = (n * x + sumR * sumD) * invS_lo;
+        S = S < -1.0f + FIT_EPSILON ? -1.0f + FIT_EPSILON : S;
+        S = S >  1.0f - FIT_EPSILON ?  1.0f - FIT_EPSILON : S;
+        float O = (sumR - S * sumD) / n;
+        error[iso] = S * (S * sumD2 + 2.0f * (O * sumD - x)) + O * (n * O - 2.0f * sumR);
+        if (error[iso] < error[best])
+        {
+            best = iso;
+        }
+    }
+#endif
+    return best;
+}
+
+void createIsometryBlocks(cpuEncodeData* ced)
+{
+    size_t numRanges = ced->rangeCols * ced->rangeRows;
+    size_t r_size = ced->r_size;
+    ced->isometryBlocks = allocBlocks(numRanges * NUM_ISOMETRIES, ced->nPad);
+    
+    size_t r, x, y, u, v;
+    int iso;
+    for (r = 0; r < numRanges; r++)
+    {
+        const int16_t* block = ced->rangeBlocks + r * ced->nPad;
+        for (iso = 0; iso < NUM_ISOMETRIES; iso++)
+        {
+            int16_t* inverse = ced->isometryBlocks + (r * NUM_ISOMETRIES + iso) * ced->nPad;
+            for (y = 0; y < r_size; y++)
+            {
+                for (x = 0; x < r_size; x++)
+                {
+                    isometrySource(iso, r_size, x, y, &u, &v);
+                    inverse[v * r_size + u] = block[y * r_size + x];
+                }
+            }
+        }
+    }
+}
+
+/*
+ * full resolution fit of range r to domain (d_i, d_j), in its best
+ * orientation with isometries; inlined into each fitDomain variant with
+ * that variant's inner product
+ */
+static inline __attribute__((always_inline)) void fitDomainWith(cpuEncodeData* ced,
+    size_t r, size_t d_i, size_t d_j,
+    rangeTransform* t,
+    int32_t (*dot)(const int16_t* a, const int16_t* b, size_t nPad))
+{
+    size_t d = d_j * ced->domainCols + d_i;
+    const int16_t* domain = ced->domainBlocks + d * ced->nPad;
+    int32_t sumDr[NUM_ISOMETRIES];
+    int numIsometries = 1;
+    if (ced->isometryBlocks != NULL)
+    {
+        dotBlocksIsometries(domain, ced->isometryBlocks + r * NUM_ISOMETRIES * ced->nPad, ced->nPad, sumDr);
+        numIsometries = NUM_ISOMETRIES;
+    }
+    else
+    {
+        sumDr[0] = dot(domain, ced->rangeBlocks + r * ced->nPad, ced->nPad);
+    }
+    
+    float n = ced->n;
+    float sumD = ced->sumD[d] * ced->dScale;
+    float sumD2 = ced->sumD2[d] * ced->dScale * ced->dScale;
+    float sumR = ced->sumR[r] * ced->rScale;
+    double drScale = ced->rScale * ced->dScale;
+    
+    /*
+     * fitSO's squared error in every orientation, less the part they share,
+     * with one division; ties go to the lower isometry, the identity first
+     */
+    int bestIso = 0;
+    float S_lo = n * sumD2 + sumD * sumD;
+    if (numIsometries > 1 && fabsf(S_lo) > FIT_EPSILON)
+    {
+        bestIso = bestIsometry(sumDr, n, sumD, sumD2, sumR, drScale, 1.0f / S_lo);
+    }
+    
+    fitSO(n, sumD, sumD2,
+        sumDr[bestIso] * drScale,
+        sumR,
+        ced->sumR2[r] * ced->rScale * ced->rScale,
+        t);
+    t->d_i = d_i;
+    t->d_j = d_j;
+    t->iso = bestIso;
+}
+
+#if defined(CPUENC_AVX2)
+__attribute__((target("avx2")))
+static void fitDomainAVX2(cpuEncodeData* ced,
+    size_t r, size_t d_i, size_t d_j,
+    rangeTransform* t)
+{
+    fitDomainWith(ced, r, d_i, d_j, t, dotBlocksAVX2);
+}
+#endif
+
+/* for the spiral and coarse searches; the exhaustive one picks its variant once per window */
+static void fitDomain(cpuEncodeData* ced,
+    size_t r, size_t d_i, size_t d_j,
+    rangeTransform* t)
+{
+#if defined(CPUENC_AVX2)
+    if (__builtin_cpu_supports("avx2"))
+    {
+        fitDomainAVX2(ced, r, d_i, d_j, t);
+        return;
+    }
+#endif
+    fitDomainWith(ced, r, d_i, d_j, t, dotBlocks);
+}
+
+/* the best of the domains in [i0, i1) x [j0, j1); ties go to the first found */
+static inline __attribute__((always_inline)) void searchDomainWindowWith(cpuEncodeData* ced,
+    size_t r_i, size_t r_j,
+    size_t i0, size_t i1, size_t j0, size_t j1,
+    rangeTransform* best,
+    int32_t (*dot)(const int16_t* a, const int16_t* b, size_t nPad))
+{
+    size_t r = r_j * ced->rangeCols + r_i;
+    
+    rangeTransform t;
+    size_t d_i, d_j;
+    for (d_j = j0; d_j < j1; d_j++)
+    {
+        for (d_i = i0; d_i < i1; d_i++)
+        {
+            fitDomainWith(ced, r, d_i, d_j, &t, dot);
+            if ((d_i == i0 && d_j == j0) || betterTransform(&t, best))
+            {
+                *best = t;
+            }
+        }
+    }
+}
+
+#if defined(CPUENC_AVX2)
+__attribute__((target("avx2")))
+static void searchDomainWindowAVX2(cpuEncodeData* ced,
+    size_t r_i, size_t r_j,
+    size_t i0, size_t i1, size_t j0, size_t j1,
+    rangeTransform* best)
+{
+    searchDomainWindowWith(ced, r_i, r_j, i0, i1, j0, j1, best, dotBlocksAVX2);
+}
+#endif
+
+static void searchDomainWindow(cpuEncodeData* ced,
+    size_t r_i, size_t r_j,
+    size_t i0, size_t i1, size_t j0, size_t j1,
+    rangeTransform* best)
+{
+#if defined(CPUENC_AVX2)
+    if (__builtin_cpu_supports("avx2"))
+    {
+        searchDomainWindowAVX2(ced, r_i, r_j, i0, i1, j0, j1, best);
+        return;
+    }
+#endif
+    searchDomainWindowWith(ced, r_i, r_j, i0, i1, j0, j1, best, dotBlocks);
+}
+
+void cpuSearchRange(cpuEncodeData* ced,
+    size_t r_i, size_t r_j,
+    rangeTransform* best)
+{
+    searchDomainWindow(ced, r_i, r_j,
+        0, ced->domainCols, 0, ced->domainRows,
+        best);
+}
+
+void cpuSearchRangeNear(cpuEncodeData* ced,
+    size_t r_i, size_t r_j,
+    size_t d_i, size_t d_j, size_t radius,
+    rangeTransform* best)
+{
+    size_t i0 = d_i > radius ? d_i - radius : 0;
+    size_t j0 = d_j > radius ? d_j - radius : 0;
+    size_t i1 = d_i + radius + 1 < ced->domainCols ? d_i + radius + 1 : ced->domainCols;
+    size_t j1 = d_j + radius + 1 < ced->domainRows ? d_j + radius + 1 : ced->domainRows;
+    searchDomainWindow(ced, r_i, r_j,
+        i0, i1, j0, j1,
+        best);
+}
+
+size_t cpuSearchRangeSpiral(cpuEncodeData* ced,
+    size_t r_i, size_t r_j,
+    size_t d_i, size_t d_j, size_t maxDomains,
+    double stopMSE, double stopRelative,
+    rangeTransform* best)
+{
+    size_t r = r_j * ced->rangeCols + r_i;
+    long cols = ced->domainCols;
+    long rows = ced->domainRows;
+    long ci = d_i;
+    long cj = d_j;
+    
+    /* the range's variance is the MSE of fitting it with s = 0 */
+    double meanR = ced->sumR[r] * ced->rScale / ced->n;
+    double variance = ced->sumR2[r] * ced->rScale * ced->rScale / ced->n - meanR * meanR;
+    double stop = stopRelative * variance > stopMSE ? stopRelative * variance : stopMSE;
+    
+    rangeTransform t;
+    size_t examined = 0;
+    long k;
+    long maxK = cols > rows ? cols : rows;
+    for (k = 0; k <= maxK; k++)
+    {
+        /* ring k: the full top and bottom rows, only the end points in between */
+        long i, j;
+        for (j = cj - k; j <= cj + k; j++)
+        {
+            if (j < 0 || j >= rows)
+            {
+                continue;
+            }
+            long step = (k == 0 || j == cj - k || j == cj + k) ? 1 : 2 * k;
+            for (i = ci - k; i <= ci + k; i += step)
+            {
+                if (i < 0 || i >= cols)
+                {
+                    continue;
+                }
+                fitDomain(ced, r, i, j, &t);
+                if (examined == 0 || betterTransform(&t, best))
+                {
+                    *best = t;
+                }
+                examined++;
+                if (best->MSE <= stop || examined == maxDomains)
+                {
+                    return examined;
+                }
+            }
+        }
+    }
+    
+    return examined;
+}
+
+/* 2x2 averages of a packed block, scaled to [0, 1] */
+static void decimateBlock(const int16_t* block, size_t r_size, double scale, float* coarse, size_t coarseStride)
+{
+    size_t c_size = r_size / 2;
+    size_t x, y;
+    for (y = 0; y < c_size; y++)
+    {
+        for (x = 0; x < c_size; x++)
+        {
+            const int16_t* p = block + 2 * y * r_size + 2 * x;
+            coarse[(y * c_size + x) * coarseStride] = (p[0] + p[1] + p[r_size] + p[r_size + 1]) * scale / 4;
+        }
+    }
+}
+
+static void createCoarseBlocks(cpuEncodeData* ced)
+{
+    size_t numRanges = ced->rangeCols * ced->rangeRows;
+    size_t numDomains = ced->domainCols * ced->domainRows;
+    size_t cn = ced->n / 4;
+    size_t b, i;
+    
+    ced->coarseRangeBlocks = malloc(numRanges * cn * sizeof(float));
+    ced->coarseSumR2 = malloc(numRanges * sizeof(float));
+    for (b = 0; b < numRanges; b++)
+    {
+        float* coarse = ced->coarseRangeBlocks + b * cn;
+        decimateBlock(ced->rangeBlocks + b * ced->nPad, ced->r_size, ced->rScale, coarse, 1);
+        ced->coarseSumR2[b] = 0.0f;
+        for (i = 0; i < cn; i++)
+        {
+            ced->coarseSumR2[b] += coarse[i] * coarse[i];
+        }
+    }
+    
+    /*
+     * domains sample-major, sample i of every domain in one row, so a range
+     * is scored against all of them in vectorizable loops; fitSO's
+     * denominator depends only on the domain, so its reciprocal is kept
+     */
+    ced->coarseDomainSamples = malloc(cn * numDomains * sizeof(float));
+    ced->coarseSumD = malloc(numDomains * sizeof(float));
+    ced->coarseSumD2 = malloc(numDomains * sizeof(float));
+    ced->coarseInvS_lo = malloc(numDomains * sizeof(float));
+    ced->coarseScratch = malloc(2 * numDomains * sizeof(float));
+    for (b = 0; b < numDomains; b++)
+    {
+        decimateBlock(ced->domainBlocks + b * ced->nPad, ced->r_size, ced->dScale,
+            ced->coarseDomainSamples + b, numDomains);
+        float sumD = 0.0f;
+        float sumD2 = 0.0f;
+        for (i = 0; i < cn; i++)
+        {
+            float c = ced->coarseDomainSamples[i * numDomains + b];
+            sumD += c;
+            sumD2 += c * c;
+        }
+        float S_lo = cn * sumD2 + sumD * sumD;
+        ced->coarseSumD[b] = sumD;
+        ced->coarseSumD2[b] = sumD2;
+        ced->coarseInvS_lo[b] = fabsf(S_lo) > FIT_EPSILON ? 1.0f / S_lo : 0.0f;
+    }
+}
+
+/* max-heap of candidate domains on their coarse error */
+static void siftDown(size_t* candidates, const float* errors, size_t count, size_t i)
+{
+    for (;;)
+    {
+        size_t largest = i;
+        size_t child;
+        for (child = 2 * i + 1; child <= 2 * i + 2 && child < count; child++)
+        {
+            if (errors[candidates[child]] > errors[candidates[largest]])
+            {
+                largest = child;
+            }
+        }
+        if (largest == i)
+        {
+            return;
+        }
+        size_t tmp = candidates[i];
+        candidates[i] = candidates[largest];
+        candidates[largest] = tmp;
+        i = largest;
+    }
+}
+
+void cpuSearchRangeCoarse(cpuEncodeData* ced,
+    size_t r_i, size_t r_j, size_t k,
+    rangeTransform* best)
+{
+    if (ced->r_size < 4)
+    {
+        ERR("coarse search needs range blocks of at least 4x4", "");
+    }
+    if (ced->coarseRangeBlocks == NULL)
+    {
+        createCoarseBlocks(ced);
+    }
+    
+    size_t numDomains = ced->domainCols * ced->domainRows;
+    if (k > numDomains)
+    {
+        k = numDomains;
+    }
+    if (k > ced->coarseCandidatesSize)
+    {
+        free(ced->coarseCandidates);
+        ced->coarseCandidates = malloc(k * sizeof(size_t));
+        ced->coarseCandidatesSize = k;
+    }
+    
+    /*
+     * Every domain gets fitSO's squared error on the coarse blocks. An
+     * inverse of 0 gives the flat fit, S = 0, so neither case branches.
+     */
+    size_t r = r_j * ced->rangeCols + r_i;
+    size_t cn = ced->n / 4;
+    const float* rangeBlock = ced->coarseRangeBlocks + r * cn;
+    float n = cn;
+    float invN = 1.0f / n;
+    float sumR = ced->sumR[r] * ced->rScale / 4;
+    float sumR2 = ced->coarseSumR2[r];
+    float* sumDr = ced->coarseScratch;
+    float* errors = ced->coarseScratch + numDomains;
+    
+    size_t d, i;
+    for (d = 0; d < numDomains; d++)
+    {
+        sumDr[d] = 0.0f;
+    }
+    for (i = 0; i < cn; i++)
+    {
+        const float* samples = ced->coarseDomainSamples + i * numDomains;
+        float rSample = rangeBlock[i];
+        for (d = 0; d < numDomains; d++)
+        {
+            sumDr[d] += samples[d] * rSample;
+        }
+    }
+    for (d = 0; d < numDomains; d++)
+    {
+        float sumD = ced->coarseSumD[d];
+        float S = (n * sumDr[d] + sumR * sumD) * ced->coarseInvS_lo[d];
+        S = S < -1.0f + FIT_EPSILON ? -1.0f + FIT_EPSILON : S;
+        S = S >  1.0f - FIT_EPSILON ?  1.0f - FIT_EPSILON : S;
+        float O = (sumR - S * sumD) * invN;
+        errors[d] = S * (S * ced->coarseSumD2[d] + 2.0f * (O * sumD - sumDr[d]))
+            + sumR2 + O * (n * O - 2.0f * sumR);
+    }
+    
+    /* the k smallest errors */
+    size_t* candidates = ced->coarseCandidates;
+    for (d = 0; d < k; d++)
+    {
+        candidates[d] = d;
+    }
+    for (i = k / 2; i-- > 0;)
+    {
+        siftDown(candidates, errors, k, i);
+    }
+    for (d = k; d < numDomains; d++)
+    {
+        if (errors[d] < errors[candidates[0]])
+        {
+            candidates[0] = d;
+            siftDown(candidates, errors, k, 0);
+        }
+    }
+    
+    rangeTransform t;
+    for (i = 0; i < k; i++)
+    {
+        fitDomain(ced, r, candidates[i] % ced->domainCols, candidates[i] / ced->domainCols, &t);
+        if (i == 0 || betterTransform(&t, best))
+        {
+            *best = t;
+        }
+    }
+}
@@ -0,0 +1,110 @@
+#ifndef CPUENC_H
+#define CPUENC_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "transform.h"
+
+/*
+ * CPU encoder on 8-bit samples
+ *
+ * Range blocks are taken from the source image and domain blocks from the
+ * image decimated by 2^m, both as the original 8-bit samples. Domain
+ * blocks start every d_step samples of the decimated image, so they
+ * overlap when d_step < r_size; d_step = r_size tiles it. Every block
+ * is packed contiguously as int16, padded with zeros to a multiple of
+ * BLOCK_ALIGN samples, so block inner products are a run of integer
+ * multiply-adds with no rounding.
+ */
+
+#define BLOCK_ALIGN 16
+
+typedef struct cpuEncodeData {
+    size_t r_size;
+    size_t n;         /* samples per block */
+    size_t nPad;      /* n rounded up to BLOCK_ALIGN */
+    size_t rangeCols;
+    size_t rangeRows;
+    size_t domainCols;
+    size_t domainRows;
+    size_t d_step;    /* decimated samples between domain origins */
+    int16_t* rangeBlocks;
+    int16_t* domainBlocks;
+    int32_t* sumR;
+    int32_t* sumR2;
+    int32_t* sumD;
+    int32_t* sumD2;
+    double rScale;    /* range sample -> [0, 1] */
+    double dScale;    /* domain sample -> [0, 1] */
+    
+    /*
+     * each range block under the inverse of every isometry, NUM_ISOMETRIES
+     * packed blocks per range, created by createIsometryBlocks
+     */
+    int16_t* isometryBlocks;
+    
+    /*
+     * blocks decimated 2x for the coarse search, as [0, 1] averages of
+     * four samples, created by the first cpuSearchRangeCoarse
+     */
+    float* coarseRangeBlocks;
+    float* coarseSumR2;
+    float* coarseDomainSamples;   /* sample-major: sample i of domain d at i * numDomains + d */
+    float* coarseSumD;
+    float* coarseSumD2;
+    float* coarseInvS_lo;         /* 1 / fitSO's S_lo, 0 where the fit is flat */
+    float* coarseScratch;
+    size_t* coarseCandidates;     /* heap of the best k, grown to the largest k asked for */
+    size_t coarseCandidatesSize;
+} cpuEncodeData;
+
+cpuEncodeData* createCPUEncodeData(
+    const uint8_t* pixels, size_t w, size_t h, size_t stride,
+    size_t d_size, size_t r_size, size_t d_step);
+void releaseCPUEncodeData(cpuEncodeData* ced);
+
+int32_t dotBlocks(const int16_t* a, const int16_t* b, size_t nPad);
+
+/*
+ * From then on every search also tries the rotations and flips of each
+ * domain. sumD and sumD2 do not change under them, and <iso(D), R> is
+ * <D, iso^-1(R)>, so the range blocks are what is transformed: each
+ * domain block is read once for all eight inner products.
+ */
+void createIsometryBlocks(cpuEncodeData* ced);
+
+void cpuSearchRange(cpuEncodeData* ced,
+    size_t r_i, size_t r_j,
+    rangeTransform* best);
+
+/*
+ * Coarse-to-fine: every domain is ranked by the same fit on blocks
+ * decimated 2x, a quarter of the samples, and only the best k are fit at
+ * full resolution as cpuSearchRange does. The exhaustive search's domain
+ * is missed when it ranks below k. Needs r_size >= 4. The ranking
+ * ignores isometries; only the k candidates are fit in every orientation.
+ */
+void cpuSearchRangeCoarse(cpuEncodeData* ced,
+    size_t r_i, size_t r_j, size_t k,
+    rangeTransform* best);
+
+/* the same search, over the domains within radius of (d_i, d_j) */
+void cpuSearchRangeNear(cpuEncodeData* ced,
+    size_t r_i, size_t r_j,
+    size_t d_i, size_t d_j, size_t radius,
+    rangeTransform* best);
+
+/*
+ * Domains in rings of growing distance around (d_i, d_j), stopping at the
+ * first whose MSE is at most stopMSE or stopRelative times the range's
+ * variance, or after maxDomains (0 for no limit). With neither threshold
+ * met, the result is cpuSearchRange's. Returns the number of domains fit.
+ */
+size_t cpuSearchRangeSpiral(cpuEncodeData* ced,
+    size_t r_i, size_t r_j,
+    size_t d_i, size_t d_j, size_t maxDomains,
+    double stopMSE, double stopRelative,
+    rangeTransform* best);
+
+#endif
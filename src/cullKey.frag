@@ -0,0 +1,14 @@
+uniform sampler2DRect sumD_sumD2_tex;
+
+uniform float n;
+uniform float blockSize;
+
+/* depth = 0.5 + standard deviation of the domain block this pixel belongs to */
+void main()
+{
+    vec2 block = floor(gl_TexCoord[0].st / blockSize) + vec2(0.5, 0.5);
+    vec4 PD = texture2DRect(sumD_sumD2_tex, block);
+    float mean = PD.r / n;
+    float variance = max(PD.g / n - mean * mean, 0.0);
+    gl_FragDepth = 0.5 + sqrt(variance);
+}
@@ -0,0 +1,8 @@
+uniform sampler2DRect D_tex;
+
+varying float s, o;
+
+void main()
+{
+    gl_FragData[0] = vec4(s * texture2DRect(D_tex, gl_TexCoord[0].st).r + o);
+}
@@ -0,0 +1,51 @@
+#extension GL_ARB_draw_instanced : require
+
+uniform sampler2DRect transform_tex;
+uniform float rangeCols;
+uniform float originXMult;
+uniform float r_size;
+uniform float d_step;
+uniform float w, h;
+
+varying float s, o;
+
+/*
+ * one instance per range: the quad covers the range block in the output
+ * image, and its texture coordinates cover the chosen domain block in the
+ * decimated image, both r_size on a side, domains d_step apart. The first channel holds the
+ * isometry, see isometrySource in transform.h; the GL search leaves its
+ * MSE there, which is below 1, so the identity.
+ */
+void main()
+{
+    float id = float(gl_InstanceIDARB);
+    float r_j = floor((id + 0.5) / rangeCols);
+    float r_i = id - r_j * rangeCols;
+    
+    vec4 T = texture2DRect(transform_tex, vec2(r_i, r_j) + vec2(0.5, 0.5));
+    s = T.g;
+    o = T.b;
+    
+    /* unpackOrigin, corrected for a division that may be off by an ulp */
+    float d_i = floor((T.a + 0.5) / originXMult);
+    float d_j = T.a - d_i * originXMult;
+    if (d_j < 0.0)
+    {
+        d_i -= 1.0;
+        d_j += originXMult;
+    }
+    else if (d_j >= originXMult)
+    {
+        d_i += 1.0;
+        d_j -= originXMult;
+    }
+    
+    float iso = floor(T.r);
+    vec2 corner = gl_MultiTexCoord0.st;
+    vec2 source = mod(iso, 8.0) >= 4.0 ? corner.ts : corner;
+    source.s = mod(iso, 2.0) >= 1.0 ? 1.0 - source.s : source.s;
+    source.t = mod(iso, 4.0) >= 2.0 ? 1.0 - source.t : source.t;
+    gl_TexCoord[0] = vec4(vec2(d_i, d_j) * d_step + source * r_size, 0.0, 1.0);
+    vec2 scrn = (vec2(r_i, r_j) + corner) * r_size / vec2(w, h) * 2.0 - 1.0;
+    gl_Position = vec4(scrn.x, scrn.y, 0.0, 1.0);
+}
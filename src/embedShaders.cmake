@@ -0,0 +1,30 @@
+# Writes OUTPUT, a C file holding every shader in SHADER_DIR as a byte
+# array, for shaders.h.
+#
+#   cmake -DSHADER_DIR=<dir> -DOUTPUT=<file.c> -P embedShaders.cmake
+
+file(GLOB SHADERS ${SHADER_DIR}/*.vert ${SHADER_DIR}/*.frag ${SHADER_DIR}/*.comp)
+list(SORT SHADERS)
+
+file(WRITE ${OUTPUT} "/* generated from ${SHADER_DIR} by embedShaders.cmake */\n\n")
+file(APPEND ${OUTPUT} "#include \"shaders.h\"\n\n")
+
+# 16 bytes per line; CMake regular expressions have no {n}
+set(line "")
+foreach(i RANGE 15)
+    set(line "${line}0x..,")
+endforeach()
+
+set(index 0)
+set(entries "")
+foreach(path ${SHADERS})
+    get_filename_component(name ${path} NAME)
+    file(READ ${path} hex HEX)
+    string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1," bytes "${hex}")
+    string(REGEX REPLACE "(${line})" "\\1\n    " bytes "${bytes}")
+    file(APPEND ${OUTPUT} "/* ${name} */\nstatic const char shader${index}[] = {\n    ${bytes}0x00\n};\n\n")
+    set(entries "${entries}    { \"${name}\", shader${index}, sizeof(shader${index}) - 1 },\n")
+    math(EXPR index "${index} + 1")
+endforeach()
+
+file(APPEND ${OUTPUT} "const embeddedShader embeddedShaders[] = {\n${entries}    { NULL, NULL, 0 }\n};\n")
@@ -2,9 +2,9 @@
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef __APPLE__
 #include <CoreFoundation/CoreFoundation.h>
-#include <OpenGL/OpenGL.h>
-#include <OpenGL/CGLMacro.h>
+#endif
 
 #include "errors.h"
 
@@ -14,6 +14,7 @@ void reportGenericError(char *file, const char* func, unsigned long line, char*
     exit(EXIT_FAILURE);
 }
 
+#ifdef __APPLE__
 void checkCGLError(CGLContextObj cgl_ctx, char *file, const char* func, unsigned long line, CGLError error)
 {
     if (error != kCGLNoError)
@@ -21,8 +22,55 @@ void checkCGLError(CGLContextObj cgl_ctx, char *file, const char* func, unsigned
         reportGenericError(file, func, line, "CGL error", (char*)CGLErrorString(error));
     }
 }
+#endif
 
-void checkOGLError(CGLContextObj cgl_ctx, char *file, const char* func, unsigned long line)
+_Thread_local GLenum framebufferConfig;
+
+#if defined(GL_KHR_debug) && !defined(__APPLE__)
+static void GLAPIENTRY reportDebugMessage(GLenum source, GLenum type, GLuint id,
+    GLenum severity, GLsizei length, const GLchar* message, const void* userParam)
+{
+    /* userParam is the context's expectGLErrors flag, which lives as long
+       as the context, asynchronous messages may arrive on a driver thread */
+    if (type != GL_DEBUG_TYPE_ERROR || *(const GLboolean*)userParam)
+    {
+        return;
+    }
+#if GL_CHECK_LEVEL >= GL_CHECK_DEBUG
+    /* the next CHK_OGL reports where it happened */
+    printf("KHR_debug: %s\n", message);
+#else
+    reportGenericError("KHR_debug", "", 0, "OpenGL error", (char*)message);
+#endif
+}
+#endif
+
+/*
+ * Routes GL errors to reportDebugMessage where KHR_debug is available.
+ * Release builds leave debug output asynchronous so the driver never waits
+ * on it, debug builds make it synchronous so messages line up with CHK_OGL.
+ */
+void installGLErrorCallback(glContextObj cgl_ctx, const GLboolean* expected)
+{
+#if defined(GL_KHR_debug) && !defined(__APPLE__) && GL_CHECK_LEVEL > GL_CHECK_NONE
+    const char* extensions = (const char*)glGetString(GL_EXTENSIONS);
+    if (extensions == NULL || strstr(extensions, "GL_KHR_debug") == NULL)
+    {
+        return;
+    }
+    
+    glDebugMessageCallback(reportDebugMessage, expected);
+    glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, NULL, GL_FALSE);
+    glDebugMessageControl(GL_DONT_CARE, GL_DEBUG_TYPE_ERROR, GL_DONT_CARE, 0, NULL, GL_TRUE);
+    glEnable(GL_DEBUG_OUTPUT);
+#if GL_CHECK_LEVEL >= GL_CHECK_DEBUG
+    glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+#endif
+    checkOGLError(cgl_ctx, __FILE__, __func__, __LINE__);
+#endif
+}
+
+void checkOGLError(glContextObj cgl_ctx, char *file, const char* func, unsigned long line)
 {
     // TODO: print entire OpenGL error stack instead of just the top
     GLenum error = glGetError();
@@ -32,9 +80,9 @@ void checkOGLError(CGLContextObj cgl_ctx, char *file, const char* func, unsigned
     }
 }
 
-void checkFramebufferError(CGLContextObj cgl_ctx, char *file, const char* func, unsigned long line) {
+void checkFramebufferError(glContextObj cgl_ctx, char *file, const char* func, unsigned long line) {
     GLenum status = glCheckFramebufferStatusEXT(GL_FRAMEBUFFER_EXT);
-    CHK_OGL;
+    checkOGLError(cgl_ctx, file, func, line);
     switch (status) {
         case GL_FRAMEBUFFER_COMPLETE_EXT:
             return;
@@ -69,7 +117,6 @@ void checkFramebufferError(CGLContextObj cgl_ctx, char *file, const char* func,
         case 0:
             printf("%s:%s:%d framebuffer error: %s\n", file, func, line,
                 "glCheckFramebufferStatusEXT(GL_FRAMEBUFFER_EXT) failed");
-            CHK_OGL;
             break;
         default:
             printf("%s:%s:%d framebuffer error: Unknown error code %d\n", file, func, line, status);
@@ -78,6 +125,30 @@ void checkFramebufferError(CGLContextObj cgl_ctx, char *file, const char* func,
     exit(EXIT_FAILURE);
 }
 
+/* remembers which framebufferConfig values passed, so each is checked once */
+#define MAX_FRAMEBUFFER_CONFIGS 16
+static _Thread_local GLenum checkedConfigs[MAX_FRAMEBUFFER_CONFIGS];
+static _Thread_local size_t numCheckedConfigs;
+
+void checkFramebufferConfig(glContextObj cgl_ctx, char *file, const char* func, unsigned long line)
+{
+    size_t i;
+    for (i = 0; i < numCheckedConfigs; i++)
+    {
+        if (checkedConfigs[i] == framebufferConfig)
+        {
+            return;
+        }
+    }
+    
+    checkFramebufferError(cgl_ctx, file, func, line);
+    if (numCheckedConfigs < MAX_FRAMEBUFFER_CONFIGS)
+    {
+        checkedConfigs[numCheckedConfigs++] = framebufferConfig;
+    }
+}
+
+#ifdef __APPLE__
 /* credit: jfroy */
 void dumpPixFmt(CGLContextObj cgl_ctx, CGLPixelFormatObj pix) {
     CGLError err;
@@ -150,9 +221,10 @@ void dumpPixFmt(CGLContextObj cgl_ctx, CGLPixelFormatObj pix) {
     PRINTPF(kCGLPFARemotePBuffer);
     PRINTPF(kCGLPFAAllowOfflineRenderers);
 }
+#endif
 
 /* credit: CS 101c */
-void printShaderInfoLog(CGLContextObj cgl_ctx, GLuint obj)
+void printShaderInfoLog(glContextObj cgl_ctx, GLuint obj)
 {
     GLint infologLength = 0;
     GLint charsWritten  = 0;
@@ -170,7 +242,7 @@ void printShaderInfoLog(CGLContextObj cgl_ctx, GLuint obj)
 }
 
 /* credit: CS 101c */
-void printProgramInfoLog(CGLContextObj cgl_ctx, GLuint obj)
+void printProgramInfoLog(glContextObj cgl_ctx, GLuint obj)
 {
     GLint infologLength = 0;
     GLint charsWritten  = 0;
@@ -187,6 +259,7 @@ void printProgramInfoLog(CGLContextObj cgl_ctx, GLuint obj)
     }
 }
 
+#ifdef __APPLE__
 void checkCFURLError(char *file, const char* func, unsigned long line, Boolean success, SInt32 errorCode)
 {
     if (!success)
@@ -225,4 +298,5 @@ void checkCFURLError(char *file, const char* func, unsigned long line, Boolean s
             break;
         }
     }
-}
\ No newline at end of file
+}
+#endif
@@ -1,8 +1,11 @@
 #ifndef ERRORS_H
 #define ERRORS_H
 
+#ifdef __APPLE__
 #include <CoreFoundation/CoreFoundation.h>
-#include <OpenGL/OpenGL.h>
+#endif
+
+#include "glcontext.h"
 
 void reportGenericError(char* file, const char* func, unsigned long line, char* msg, char* detail);
 #define ERR(msg, detail) reportGenericError(__FILE__, __func__, __LINE__, (msg), (detail))
@@ -10,21 +13,66 @@ void reportGenericError(char* file, const char* func, unsigned long line, char*
 #define CHK_SYSCALL(fn, msg, detail) if ((fn) == -1) ERR(msg, detail)
 #define CHK_NULL(ptr, msg, detail) if ((ptr) == NULL) ERR(msg, detail)
 
+#ifdef __APPLE__
 void checkCGLError(CGLContextObj cgl_ctx, char* file, const char* func, unsigned long line, CGLError error);
 #define CHK_CGL(fn) (checkCGLError(cgl_ctx, __FILE__, __func__, __LINE__, (fn)))
+#endif
 
-void checkOGLError(CGLContextObj cgl_ctx, char* file, const char* func, unsigned long line);
-#define CHK_OGL (checkOGLError(cgl_ctx, __FILE__, __func__, __LINE__))
+/*
+ * GL error check levels, chosen at compile time:
+ *
+ * GL_CHECK_DEBUG: CHK_OGL calls glGetError and CHK_FBO checks framebuffer
+ * completeness wherever they appear, reporting the exact call site.
+ *
+ * GL_CHECK_RELEASE: CHK_OGL compiles away, so nothing waits on the GL.
+ * Errors arrive asynchronously through a KHR_debug callback, where the
+ * driver has one. CHK_FBO checks each framebufferConfig value once.
+ *
+ * GL_CHECK_NONE: neither.
+ */
+#define GL_CHECK_NONE 0
+#define GL_CHECK_RELEASE 1
+#define GL_CHECK_DEBUG 2
+
+#ifndef GL_CHECK_LEVEL
+#define GL_CHECK_LEVEL GL_CHECK_DEBUG
+#endif
+
+/*
+ * The caller's current framebuffer layout, e.g. its color attachment format.
+ * Per thread, like the GL context current on it, so contexts on separate
+ * threads never see each other's state.
+ */
+extern _Thread_local GLenum framebufferConfig;
 
-void checkFramebufferError(CGLContextObj cgl_ctx, char* file, const char* func, unsigned long line);
+/* expected points at the context's own flag, see expectGLErrors in glcontext.h */
+void installGLErrorCallback(glContextObj cgl_ctx, const GLboolean* expected);
+
+void checkOGLError(glContextObj cgl_ctx, char* file, const char* func, unsigned long line);
+void checkFramebufferError(glContextObj cgl_ctx, char* file, const char* func, unsigned long line);
+void checkFramebufferConfig(glContextObj cgl_ctx, char* file, const char* func, unsigned long line);
+
+#if GL_CHECK_LEVEL >= GL_CHECK_DEBUG
+#define CHK_OGL (checkOGLError(cgl_ctx, __FILE__, __func__, __LINE__))
 #define CHK_FBO (checkFramebufferError(cgl_ctx, __FILE__, __func__, __LINE__))
+#elif GL_CHECK_LEVEL == GL_CHECK_RELEASE
+#define CHK_OGL ((void)0)
+#define CHK_FBO (checkFramebufferConfig(cgl_ctx, __FILE__, __func__, __LINE__))
+#else
+#define CHK_OGL ((void)0)
+#define CHK_FBO ((void)0)
+#endif
 
+#ifdef __APPLE__
 void dumpPixFmt(CGLContextObj cgl_ctx, CGLPixelFormatObj pix);
+#endif
 
-void printProgramInfoLog(CGLContextObj cgl_ctx, GLuint obj);
-void printShaderInfoLog(CGLContextObj cgl_ctx, GLuint obj);
+void printProgramInfoLog(glContextObj cgl_ctx, GLuint obj);
+void printShaderInfoLog(glContextObj cgl_ctx, GLuint obj);
 
+#ifdef __APPLE__
 void checkCFURLError(char* file, const char* func, unsigned long line, Boolean success, SInt32 errorCode);
 #define CHK_CFURL(success, errorCode) (checkCFURLError(__FILE__, __func__, __LINE__, (success), (errorCode)))
+#endif
 
 #endif
\ No newline at end of file
@@ -0,0 +1,221 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "errors.h"
+
+#include "fpimage.h"
+
+static size_t alignUp(size_t x, size_t a)
+{
+    return (x + a - 1) / a * a;
+}
+
+void parseFloatImage(floatImage* img, void* base, size_t len, char* name)
+{
+    img->base = base;
+    img->len = len;
+    size_t payloadLen;
+    
+    if (len < 16) ERR("file too short for fl32 header", name);
+    char* sig = (char*)base;
+    
+    if (memcmp(sig, "23lv", 4) == 0)
+    {
+        struct floatImageHeader* hdr = (struct floatImageHeader*)base;
+        if (len < sizeof(struct floatImageHeader)) ERR("truncated fl32 header", name);
+        if (hdr->version != FL32_VERSION) ERR("unsupported fl32 version", name);
+        if (hdr->headerSize % FL32_ALIGN != 0) ERR("misaligned fl32 payload", name);
+        if (hdr->headerSize + hdr->payloadSize > len) ERR("truncated fl32 payload", name);
+        img->version = hdr->version;
+        img->numChannels = hdr->numChannels;
+        img->w = hdr->w;
+        img->h = hdr->h;
+        img->layout = hdr->layout;
+        img->tileW = hdr->tileW;
+        img->tileH = hdr->tileH;
+        img->rowStride = hdr->rowStride;
+        img->data = (float*)((char*)base + hdr->headerSize);
+        payloadLen = hdr->payloadSize;
+        if (img->layout == FL32_LAYOUT_TILED && (img->tileW == 0 || img->tileH == 0))
+        {
+            ERR("bad tile size", name);
+        }
+        else if (img->layout != FL32_LAYOUT_LINEAR && img->layout != FL32_LAYOUT_TILED)
+        {
+            ERR("unknown fl32 layout", name);
+        }
+    }
+    else if (memcmp(sig, "23lf", 4) == 0)
+    {
+        /* legacy: either our native size_t header or Python's '<4sIII' */
+        struct floatImageHeaderLegacy* hdr = (struct floatImageHeaderLegacy*)base;
+        uint32_t* hdr32 = (uint32_t*)((char*)base + 4);
+        size_t headerSize;
+        if (len >= sizeof(struct floatImageHeaderLegacy)
+            && sizeof(struct floatImageHeaderLegacy) + hdr->numChannels * hdr->w * hdr->h * sizeof(float) == len)
+        {
+            headerSize = sizeof(struct floatImageHeaderLegacy);
+            img->numChannels = hdr->numChannels;
+            img->w = hdr->w;
+            img->h = hdr->h;
+        }
+        else
+        {
+            headerSize = 16;
+            img->numChannels = hdr32[0];
+            img->w = hdr32[1];
+            img->h = hdr32[2];
+            if (headerSize + img->numChannels * img->w * img->h * sizeof(float) > len)
+            {
+                ERR("truncated legacy fl32 payload", name);
+            }
+        }
+        img->version = 1;
+        img->layout = FL32_LAYOUT_LINEAR;
+        img->tileW = 0;
+        img->tileH = 0;
+        img->rowStride = img->numChannels * img->w * sizeof(float);
+        img->data = (float*)((char*)base + headerSize);
+        payloadLen = len - headerSize;
+    }
+    else if (memcmp(sig, "fl32", 4) == 0)
+    {
+        ERR("big-endian fl32 files are not supported", name);
+    }
+    else
+    {
+        ERR("bad signature", name);
+    }
+    
+    if (img->numChannels == 0 || img->w == 0 || img->h == 0)
+    {
+        ERR("bad dimensions", name);
+    }
+    
+    /* every pixel floatImagePixel can reach must lie inside the payload */
+    size_t pixelLen = img->numChannels * sizeof(float);
+    size_t rowPixels = img->layout == FL32_LAYOUT_TILED ? img->tileW : img->w;
+    if (img->rowStride / pixelLen < rowPixels)
+    {
+        ERR("fl32 row stride shorter than a row", name);
+    }
+    double rows = img->h;
+    if (img->layout == FL32_LAYOUT_TILED)
+    {
+        rows = (double)((img->w + img->tileW - 1) / img->tileW)
+            * ((img->h + img->tileH - 1) / img->tileH) * img->tileH;
+    }
+    if (rows * img->rowStride > (double)payloadLen)
+    {
+        ERR("fl32 payload smaller than its image", name);
+    }
+}
+
+floatImage* mapFloatImage(char* filePath)
+{
+    int fd;
+    struct stat sb;
+    void* base;
+    
+    fd = open(filePath, O_RDONLY);
+    CHK_SYSCALL(fd, "open() failed", filePath);
+    CHK_SYSCALL(fstat(fd, &sb), "fstat() failed", filePath);
+    if (!S_ISREG(sb.st_mode)) ERR("not a regular file", filePath);
+    if (sb.st_size == 0) ERR("file is empty", filePath);
+    base = mmap(NULL, sb.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) ERR("mmap() failed", filePath);
+    CHK_SYSCALL(close(fd), "close() failed", filePath);
+    
+    floatImage* img = calloc(1, sizeof(floatImage));
+    parseFloatImage(img, base, sb.st_size, filePath);
+    return img;
+}
+
+void unmapFloatImage(floatImage* img)
+{
+    CHK_SYSCALL(munmap(img->base, img->len), "munmap() failed", "");
+    free(img);
+}
+
+float* floatImagePixel(floatImage* img, size_t x, size_t y)
+{
+    char* p = (char*)img->data;
+    if (img->layout == FL32_LAYOUT_TILED)
+    {
+        size_t tilesX = (img->w + img->tileW - 1) / img->tileW;
+        size_t tileBytes = img->rowStride * img->tileH;
+        p += ((y / img->tileH) * tilesX + x / img->tileW) * tileBytes;
+        x %= img->tileW;
+        y %= img->tileH;
+    }
+    p += y * img->rowStride + x * img->numChannels * sizeof(float);
+    return (float*)p;
+}
+
+size_t floatImagePayloadSize(size_t numChannels, size_t w, size_t h, uint32_t layout, size_t tileSize)
+{
+    size_t pixelLen = numChannels * sizeof(float);
+    if (layout == FL32_LAYOUT_TILED)
+    {
+        return alignUp(w, tileSize) * alignUp(h, tileSize) * pixelLen;
+    }
+    return w * h * pixelLen;
+}
+
+void writeFloatImage(char* filePath,
+    const float* src, size_t srcPixelStride, size_t srcRowStride,
+    size_t numChannels, size_t w, size_t h,
+    uint32_t layout, size_t tileSize)
+{
+    if (layout == FL32_LAYOUT_TILED && tileSize == 0)
+    {
+        ERR("bad tile size", filePath);
+    }
+    
+    size_t headerSize = alignUp(sizeof(struct floatImageHeader), FL32_ALIGN);
+    size_t payloadSize = floatImagePayloadSize(numChannels, w, h, layout, tileSize);
+    char* buf = calloc(1, headerSize + payloadSize);
+    CHK_NULL(buf, "calloc() failed", filePath);
+    
+    struct floatImageHeader* hdr = (struct floatImageHeader*)buf;
+    memcpy(hdr->sig, "23lv", 4);
+    hdr->numChannels = numChannels;
+    hdr->w = w;
+    hdr->h = h;
+    hdr->version = FL32_VERSION;
+    hdr->headerSize = headerSize;
+    hdr->layout = layout;
+    hdr->tileW = layout == FL32_LAYOUT_TILED ? tileSize : 0;
+    hdr->tileH = layout == FL32_LAYOUT_TILED ? tileSize : 0;
+    hdr->rowStride = numChannels * sizeof(float) * (layout == FL32_LAYOUT_TILED ? tileSize : w);
+    hdr->payloadSize = payloadSize;
+    
+    floatImage img;
+    parseFloatImage(&img, buf, headerSize + payloadSize, filePath);
+    
+    size_t i, j;
+    for (j = 0; j < h; j++)
+    {
+        for (i = 0; i < w; i++)
+        {
+            memcpy(floatImagePixel(&img, i, j),
+                src + j * srcRowStride + i * srcPixelStride,
+                numChannels * sizeof(float));
+        }
+    }
+    
+    int fd = open(filePath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    CHK_SYSCALL(fd, "open() failed", filePath);
+    if (write(fd, buf, headerSize + payloadSize) != (ssize_t)(headerSize + payloadSize))
+    {
+        ERR("write() failed", filePath);
+    }
+    CHK_SYSCALL(close(fd), "close() failed", filePath);
+    
+    free(buf);
+}
@@ -1,14 +1,75 @@
 #ifndef FPIMAGE_H
 #define FPIMAGE_H
 
+#include <stdint.h>
 #include <stdlib.h>
 
+/*
+ * fl32 float image dumps
+ *
+ * Version 2 files start with a fixed 64-byte header. numChannels, w and h
+ * sit at the same offsets as in the Python writer's '<4sIII' header, and the
+ * payload starts at headerSize, which is always a multiple of FL32_ALIGN, so
+ * a mapped file can be fed to SIMD code or a pixel unpack buffer as-is.
+ *
+ * Legacy files ("23lf" followed by either size_t or uint32 fields, with the
+ * payload right after the header) are still accepted by parseFloatImage().
+ */
+
+#define FL32_VERSION 2
+#define FL32_ALIGN 64
+
+#define FL32_LAYOUT_LINEAR 0 /* w x h pixels, rows rowStride bytes apart */
+#define FL32_LAYOUT_TILED  1 /* tileW x tileH tiles in row-major order, each stored linearly */
+
 struct floatImageHeader
 {
-    char sig[4];
+    char sig[4]; /* "23lv": little-endian, versioned */
+    uint32_t numChannels;
+    uint32_t w;
+    uint32_t h;
+    uint32_t version;
+    uint32_t headerSize;
+    uint32_t layout;
+    uint32_t tileW;
+    uint32_t tileH;
+    uint32_t rowStride; /* bytes between rows of the image (linear) or of a tile (tiled) */
+    uint64_t payloadSize;
+    char reserved[16];
+};
+
+/* header written by fracture before version 2, size depends on the platform */
+struct floatImageHeaderLegacy
+{
+    char sig[4]; /* "23lf" */
     size_t numChannels;
     size_t w;
     size_t h;
 };
 
+typedef struct floatImage {
+    void* base;
+    size_t len;
+    float* data;
+    size_t numChannels;
+    size_t w;
+    size_t h;
+    uint32_t version;
+    uint32_t layout;
+    size_t tileW;
+    size_t tileH;
+    size_t rowStride;
+} floatImage;
+
+void parseFloatImage(floatImage* img, void* base, size_t len, char* name);
+floatImage* mapFloatImage(char* filePath);
+void unmapFloatImage(floatImage* img);
+float* floatImagePixel(floatImage* img, size_t x, size_t y);
+
+size_t floatImagePayloadSize(size_t numChannels, size_t w, size_t h, uint32_t layout, size_t tileSize);
+void writeFloatImage(char* filePath,
+    const float* src, size_t srcPixelStride, size_t srcRowStride,
+    size_t numChannels, size_t w, size_t h,
+    uint32_t layout, size_t tileSize);
+
 #endif
@@ -1,11 +1,6 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <fcntl.h>
-#include <sys/mman.h>
-#include <sys/stat.h>
-
-#include <CoreFoundation/CoreFoundation.h>
 
 #include "errors.h"
 #include "fpimage.h"
@@ -18,58 +13,36 @@ int main(int argc, char** argv)
     }
     
     char* filePath = argv[1];
-    int fd;
-    struct stat sb;
-    void* imgBase;
-    size_t len;
-    
-    fd = open(filePath, O_RDONLY);
-    CHK_SYSCALL(fd, "open() failed", filePath);
-    CHK_SYSCALL(fstat(fd, &sb), "fstat() failed", filePath);
-    if (!S_ISREG(sb.st_mode)) ERR("not a regular file", filePath);
-    len = sb.st_size;
-    if (len == 0) ERR("file is empty", filePath);
-    imgBase = mmap(NULL, sb.st_size, PROT_READ, MAP_SHARED, fd, 0);
-    CHK_NULL(imgBase, "mmap() failed", filePath);
-    
-    struct floatImageHeader* imgHeaderBase = (struct floatImageHeader*)imgBase;
-    if (   imgHeaderBase->sig[0] != '2'
-        || imgHeaderBase->sig[1] != '3'
-        || imgHeaderBase->sig[2] != 'l'
-        || imgHeaderBase->sig[3] != 'f')
-    {
-        ERR("bad signature", "");
-    }
-    size_t numChannels = imgHeaderBase->numChannels;
-    size_t w = imgHeaderBase->w;
-    size_t h = imgHeaderBase->h;
-    if (w == 0 || h == 0)
-    {
-        ERR("bad dimensions", "");
-    }
+    floatImage* img = mapFloatImage(filePath);
+    size_t numChannels = img->numChannels;
     
-    float* imgDataBase = imgBase + sizeof(struct floatImageHeader);
-    float* imgDataEnd = (float*)(imgBase + len);
     float* minVals = malloc(numChannels * sizeof(float));
     float* maxVals = malloc(numChannels * sizeof(float));
+    float* pxlPtr = floatImagePixel(img, 0, 0);
     int i;
     for (i = 0; i < numChannels; i++)
     {
-        minVals[i] = imgDataBase[i];
-        maxVals[i] = imgDataBase[i];
+        minVals[i] = pxlPtr[i];
+        maxVals[i] = pxlPtr[i];
     }
-    float* pxlPtr;
-    for (pxlPtr = imgDataBase + numChannels; pxlPtr != imgDataEnd; pxlPtr += numChannels)
+    size_t x, y;
+    for (y = 0; y < img->h; y++)
     {
-        for (i = 0; i < numChannels; i++)
+        for (x = 0; x < img->w; x++)
         {
-            minVals[i] = minVals[i] < pxlPtr[i] ? minVals[i] : pxlPtr[i];
-            maxVals[i] = maxVals[i] > pxlPtr[i] ? maxVals[i] : pxlPtr[i];
+            pxlPtr = floatImagePixel(img, x, y);
+            for (i = 0; i < numChannels; i++)
+            {
+                minVals[i] = minVals[i] < pxlPtr[i] ? minVals[i] : pxlPtr[i];
+                maxVals[i] = maxVals[i] > pxlPtr[i] ? maxVals[i] : pxlPtr[i];
+            }
         }
     }
     
-    CHK_SYSCALL(munmap(imgBase, len), "munmap() failed", filePath);
-    CHK_SYSCALL(close(fd), "close() failed", filePath);
+    printf("%s: v%d, %d x %d, %d channels, %s\n", filePath,
+        (int)img->version, (int)img->w, (int)img->h, (int)img->numChannels,
+        img->layout == FL32_LAYOUT_TILED ? "tiled" : "linear");
+    unmapFloatImage(img);
     
     for (i = 0; i < numChannels; i++)
     {
@@ -1,878 +1,570 @@
 #include <stdio.h>
-
-#include <OpenGL/OpenGL.h>
-#include <OpenGL/CGLMacro.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
 
 #include "errors.h"
-#include "glio.h"
-
-/*
- * configuration variables
- */
-
-int originXMult = 4096;
-
-/*
- * common variables
- */
-
-size_t fbW, fbH;
-GLuint fboTex[2];
-
-GLuint paintShader;
-GLuint paintShader_w;
-GLuint paintShader_h;
-GLuint paintShader_tex;
+#include "imageio.h"
+#include "fracture.h"
+#include "batch.h"
+#include "server.h"
 
-GLuint sumReductionShader;
-GLuint sumReductionShader_w;
-GLuint sumReductionShader_h;
-GLuint sumReductionShader_tex;
-
-GLuint squareShader;
-GLuint squareShader_w;
-GLuint squareShader_h;
-GLuint squareShader_tex;
-
-GLuint zipperShader;
-GLuint zipperShader_w;
-GLuint zipperShader_h;
-GLuint zipperShader_RG_tex;
-GLuint zipperShader_BA_tex;
-
-GLuint multiplyTiledShader;
-GLuint multiplyTiledShader_w;
-GLuint multiplyTiledShader_h;
-GLuint multiplyTiledShader_D_tex;
-GLuint multiplyTiledShader_R_tex;
-GLuint multiplyTiledShader_r_size;
-GLuint multiplyTiledShader_r_x;
-GLuint multiplyTiledShader_r_y;
-
-GLuint calcSOShader;
-GLuint calcSOShader_originXMult;
-GLuint calcSOShader_w;
-GLuint calcSOShader_h;
-GLuint calcSOShader_sumD_sumD2_sumDr_tex;
-GLuint calcSOShader_sumR_sumR2_tex;
-GLuint calcSOShader_n;
-GLuint calcSOShader_r_i;
-GLuint calcSOShader_r_j;
-
-GLuint searchReductionShader;
-GLuint searchReductionShader_w;
-GLuint searchReductionShader_h;
-GLuint searchReductionShader_tex;
+/* qualities one invocation can encode together, SD+HD */
+#define MAX_LEVELS 2
 
 /*
- * function declarations
+ * command line wrapper around libfracture:
+ * fracture <image base name> <SD|HD|SD+HD> [option=value ...]
+ * fracture batch <directory or list file> <SD|HD> [option=value ...]
+ * fracture serve <socket path> [option=value ...]
+ * fracture client <socket path> <request, see runClient>
+ * fracture decode <in.trn> <out.png|pgm|raw> [option=value ...]
+ * fracture enlarge <in image> <out image> <SD|HD> [option=value ...]
  */
 
-int log2int(int x);
-
-void loadGLResources(CGLContextObj cgl_ctx);
-
-texInfo* paint(CGLContextObj cgl_ctx,
-    texInfo* srcT,
-    size_t dstW, size_t dstH);
-
-texInfo* sumReduce(CGLContextObj cgl_ctx,
-    texInfo* srcT,
-    size_t times);
-
-texInfo* square(CGLContextObj cgl_ctx,
-    texInfo* srcT);
-
-texInfo* zipper(CGLContextObj cgl_ctx,
-    texInfo* rgT, texInfo* baT);
-
-texInfo* multiplyTiled(CGLContextObj cgl_ctx,
-    texInfo* D_T, texInfo* R_T,
-    size_t r_size, size_t r_x, size_t r_y);
-
-texInfo* calcSO(CGLContextObj cgl_ctx,
-    texInfo* sumD_sumD2_sumDr_T, texInfo* sumR_sumR2_T,
-    size_t n, size_t r_i, size_t r_j,
-    GLfloat originXMult);
-
-texInfo* searchReduce(CGLContextObj cgl_ctx,
-    texInfo* srcT,
-    size_t times);
-
-GLfloat* createTupleFromPointTexture(CGLContextObj cgl_ctx,
-    texInfo* t);
+static void printProgress(void* userData, size_t rowsDone, size_t rows)
+{
+    printf("row %d / %d\n", (int)rowsDone, (int)rows);
+}
 
-/*
- * function implementations
- */
+/* replaces the .trn at userData whole, so a reader never sees a partial file */
+static void writeSnapshot(void* userData, const fractureEncoding* enc)
+{
+    const char* trnOutPath = userData;
+    char* tmpPath;
+    asprintf(&tmpPath, "%s.tmp", trnOutPath);
+    FILE* f = fopen(tmpPath, "w");
+    CHK_NULL(f, "fopen() failed", tmpPath);
+    writeFractureEncoding(f, enc);
+    fclose(f);
+    if (rename(tmpPath, trnOutPath) != 0)
+    {
+        ERR("rename() failed", tmpPath);
+    }
+    free(tmpPath);
+}
 
-int log2int(int x)
+/* options shared by every mode, returns 0 for anything else */
+static int parseFractureOption(fractureOptions* opts, char* opt)
 {
-    if (x <= 0)
+    if (strncmp("precision=", opt, 10) == 0)
     {
-        ERR("argument <= 0", "");
+        char* value = opt + 10;
+        if      (strcmp("fp32", value) == 0) opts->precision = PRECISION_FP32;
+        else if (strcmp("fp16", value) == 0) opts->precision = PRECISION_FP16;
+        else if (strcmp("fp16check", value) == 0) opts->precision = PRECISION_FP16_CHECK;
+        else ERR("bad precision", value);
     }
-    
-    int i = 0;
-    while ((x >> i) != 1)
+    else if (strncmp("backend=", opt, 8) == 0)
     {
-        i++;
+        opts->backend = opt + 8;
     }
-    
-    if (x != (1 << i))
+    else if (strncmp("cull=", opt, 5) == 0)
     {
-        i++;
+        opts->cullRMS = atof(opt + 5);
+        if (opts->cullRMS < 0.0) ERR("bad cull", opt + 5);
     }
-    
-    return i;
-}
-
-void loadGLResources(CGLContextObj cgl_ctx)
-{
-    /* global state */
-    glEnable(GL_TEXTURE_RECTANGLE_ARB);
-    CHK_OGL;
-    
-    /* framebuffer, except for color attachments */
-    GLuint fbo;
-    glGenFramebuffersEXT(1, &fbo);
-    glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, fbo);
-    
-    GLuint renderbuffer;
-    glGenRenderbuffersEXT(1, &renderbuffer);
-    glBindRenderbufferEXT(GL_RENDERBUFFER_EXT, renderbuffer);
-    glRenderbufferStorageEXT(GL_RENDERBUFFER_EXT, GL_DEPTH_COMPONENT24, fbW, fbH);
-    glFramebufferRenderbufferEXT(
-        GL_FRAMEBUFFER_EXT, GL_DEPTH_ATTACHMENT_EXT,
-        GL_RENDERBUFFER_EXT, renderbuffer);
-    CHK_OGL;
-    
-    /* scratch FBO color attachments */
-    size_t i;
-    for (i = 0; i < 2; i++)
+    else if (strncmp("coarse=", opt, 7) == 0)
     {
-        texInfo* t = createEmptyTexture(cgl_ctx, GL_RGBA32F_ARB, fbW, fbH);
-        fboTex[i] = t->tex;
-        free(t);
-        glFramebufferTexture2DEXT(
-            GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT0_EXT + i,
-            GL_TEXTURE_RECTANGLE_ARB, fboTex[i], 0);
+        if (atoi(opt + 7) < 0) ERR("bad coarse", opt + 7);
+        opts->coarseCandidates = atoi(opt + 7);
     }
-    
-    /* buffers for full screen quad */
-    // T2F_V3F: texture coordinates, then vertex position
-    GLfloat vertexData[] = {
-        0.0, 0.0,
-        0.0, 0.0, 0.0,
-        
-        0.0, 1.0,
-        0.0, 1.0, 0.0,
-        
-        1.0, 1.0,
-        1.0, 1.0, 0.0,
-        
-        1.0, 0.0,
-        1.0, 0.0, 0.0
-    };
-    GLuint vbo;
-	glGenBuffers(1, &vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, 4 * 5 * sizeof(GLfloat), vertexData, GL_STATIC_DRAW);
-    CHK_OGL;
-    
-    GLuint indexData[] = {0, 1, 2, 3};
-    GLuint ibo;
-	glGenBuffers(1, &ibo);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, 4 * sizeof(GLuint), indexData, GL_STATIC_DRAW);
-    CHK_OGL;
-    
-    glInterleavedArrays(GL_T2F_V3F, 0, 0);
-    CHK_OGL;
-    
-    /* paint shader */
-    paintShader = loadProgram(cgl_ctx, "../src/common.vert", "../src/paint.frag");
-    paintShader_w = glGetUniformLocation(paintShader, "w");
-    paintShader_h = glGetUniformLocation(paintShader, "h");
-    paintShader_tex = glGetUniformLocation(paintShader, "tex");
-    CHK_OGL;
-    
-    /* sum reduction shader */
-    sumReductionShader = loadProgram(cgl_ctx, "../src/common.vert", "../src/sumReduction.frag");
-    sumReductionShader_w = glGetUniformLocation(sumReductionShader, "w");
-    sumReductionShader_h = glGetUniformLocation(sumReductionShader, "h");
-    sumReductionShader_tex = glGetUniformLocation(sumReductionShader, "tex");
-    CHK_OGL;
-    
-    /* square shader */
-    squareShader = loadProgram(cgl_ctx, "../src/common.vert", "../src/square.frag");
-    squareShader_w = glGetUniformLocation(squareShader, "w");
-    squareShader_h = glGetUniformLocation(squareShader, "h");
-    squareShader_tex = glGetUniformLocation(squareShader, "tex");
-    CHK_OGL;
-    
-    /* zipper shader */
-    zipperShader = loadProgram(cgl_ctx, "../src/common.vert", "../src/zipper.frag");
-    zipperShader_w = glGetUniformLocation(zipperShader, "w");
-    zipperShader_h = glGetUniformLocation(zipperShader, "h");
-    zipperShader_RG_tex = glGetUniformLocation(zipperShader, "RG_tex");
-    zipperShader_BA_tex = glGetUniformLocation(zipperShader, "BA_tex");
-    CHK_OGL;
-    
-    /* multiply a repeated range block with each domain block */
-    multiplyTiledShader = loadProgram(cgl_ctx, "../src/common.vert", "../src/multiplyTiled.frag");
-    multiplyTiledShader_w = glGetUniformLocation(multiplyTiledShader, "w");
-    multiplyTiledShader_h = glGetUniformLocation(multiplyTiledShader, "h");
-    multiplyTiledShader_D_tex = glGetUniformLocation(multiplyTiledShader, "D_tex");
-    multiplyTiledShader_R_tex = glGetUniformLocation(multiplyTiledShader, "R_tex");
-    multiplyTiledShader_r_size = glGetUniformLocation(multiplyTiledShader, "r_size");
-    multiplyTiledShader_r_x = glGetUniformLocation(multiplyTiledShader, "r_x");
-    multiplyTiledShader_r_y = glGetUniformLocation(multiplyTiledShader, "r_y");
-    CHK_OGL;
-    
-    /* shader to calculate scale and offset */
-    calcSOShader = loadProgram(cgl_ctx, "../src/common.vert", "../src/calcSO.frag");
-    calcSOShader_originXMult = glGetUniformLocation(calcSOShader, "originXMult");
-    calcSOShader_w = glGetUniformLocation(calcSOShader, "w");
-    calcSOShader_h = glGetUniformLocation(calcSOShader, "h");
-    calcSOShader_sumD_sumD2_sumDr_tex = glGetUniformLocation(calcSOShader, "sumD_sumD2_sumDr_tex");
-    calcSOShader_sumR_sumR2_tex = glGetUniformLocation(calcSOShader, "sumR_sumR2_tex");
-    calcSOShader_n = glGetUniformLocation(calcSOShader, "n");
-    calcSOShader_r_i = glGetUniformLocation(calcSOShader, "r_i");
-    calcSOShader_r_j = glGetUniformLocation(calcSOShader, "r_j");
-    CHK_OGL;
-    
-    /* search reduction shader */
-    searchReductionShader = loadProgram(cgl_ctx, "../src/common.vert", "../src/searchReduction.frag");
-    searchReductionShader_w = glGetUniformLocation(searchReductionShader, "w");
-    searchReductionShader_h = glGetUniformLocation(searchReductionShader, "h");
-    searchReductionShader_tex = glGetUniformLocation(searchReductionShader, "tex");
-    CHK_OGL;
-}
-
-int main(int argc, char** argv)
-{   
-    /* get a CGL context */
-    CGLContextObj cgl_ctx;
-    CGLPixelFormatAttribute attribs[] = {
-        kCGLPFAAccelerated,
-        kCGLPFAPBuffer, // bypasses default of window drawable. use kCGLPFARemotePBuffer if this fails on remote session
-        kCGLPFANoRecovery, // disables software fallback
-        0
-    };
-    CGLPixelFormatObj pxlFmt;
-    GLint numPxlFmts;
-    CHK_CGL(CGLChoosePixelFormat(attribs, &pxlFmt, &numPxlFmts));
-    //dumpPixFmt(cgl_ctx, pxlFmt);
-    CHK_CGL(CGLCreateContext(pxlFmt, NULL, &cgl_ctx));
-    CHK_CGL(CGLSetCurrentContext(cgl_ctx));
-    
-    size_t d_size;
-    size_t r_size;
-    char* trnOutPath;
-    char* srcBase;
-    char* quality;
-    if (argc < 3)
+    else if (strcmp("coarsecheck=1", opt) == 0)
     {
-        ERR("not enough arguments", "");
+        opts->coarseCheck = 1;
     }
-    else
+    else if (strncmp("spiral=", opt, 7) == 0)
     {
-        srcBase = argv[1];
-        quality = argv[2];
-        
-        if      (strncmp("SD", quality, 3) == 0)
-        {        
-            d_size = 8;
-            r_size = 4;
-            asprintf(&trnOutPath, "OpenGL-%s.trn", srcBase);
-        }
-        else if (strncmp("HD", quality, 3) == 0)
-        {        
-            d_size = 4;
-            r_size = 2;
-            asprintf(&trnOutPath, "OpenGL-%s-HD.trn", srcBase);
-        }
-        else
-        {
-            ERR("bad quality argument", quality);
-        }
+        if (atoi(opt + 7) < 0) ERR("bad spiral", opt + 7);
+        opts->spiral = 1;
+        opts->spiralMaxDomains = atoi(opt + 7);
     }
-    
-    /* load image to process */
-    char* srcPath;
-    asprintf(&srcPath, "../data/%s.png", srcBase);
-    texInfo* srcImgT = createTextureFromPath(cgl_ctx, srcPath);
-    srcImgT->aC = 1;
-    fbW = srcImgT->w;
-    fbH = srcImgT->h;
-    
-    FILE* trnOutFile = fopen(trnOutPath, "w");
-    CHK_NULL(trnOutFile, "fopen() failed", trnOutPath);
-    
-    fprintf(trnOutFile, "# orig_w = %d\n", fbW);
-    fprintf(trnOutFile, "# orig_h = %d\n", fbH);
-    fprintf(trnOutFile, "# d_size = %d\n", d_size);
-    fprintf(trnOutFile, "# r_size = %d\n", r_size);
-    
-    loadGLResources(cgl_ctx);
-    
-    /* range data */
-    
-    texInfo* R_T = paint(cgl_ctx,
-        srcImgT,
-        srcImgT->w, srcImgT->h);
-    
-    texInfo* R_R2_T = square(cgl_ctx,
-        R_T);
-    
-    texInfo* sumR_sumR2_T = sumReduce(cgl_ctx,
-        R_R2_T,
-        log2int(r_size));
-    
-    /* domain data */
-    
-    int m = log2int(d_size) - log2int(r_size);
-    
-    texInfo* D_T = paint(cgl_ctx,
-        srcImgT,
-        srcImgT->w >> m, srcImgT->h >> m);
-    
-    texInfo* D_D2_T = square(cgl_ctx,
-        D_T);
-    
-    texInfo* sumD_sumD2_T = sumReduce(cgl_ctx,
-        D_D2_T,
-        log2int(r_size));
-    
-    releaseTexture(cgl_ctx, R_R2_T);
-    releaseTexture(cgl_ctx, D_D2_T);
-    
-    /* for each range... */
-    size_t r_i, r_j;
-    for (r_j = 0; r_j < R_T->aH / r_size; r_j++)
+    else if (strncmp("stoprms=", opt, 8) == 0)
     {
-        for (r_i = 0; r_i < R_T->aW / r_size; r_i++)
-        {
-            texInfo* Dr_T = multiplyTiled(cgl_ctx, D_T, R_T,
-                r_size, r_i * r_size, r_j * r_size);
-            
-            texInfo* sumDr_T = sumReduce(cgl_ctx,
-                Dr_T,
-                log2int(r_size));
-            
-            texInfo* sumD_sumD2_sumDr_T = zipper(cgl_ctx,
-                sumD_sumD2_T, sumDr_T);
-            
-            texInfo* rangeCandidates_T = calcSO(cgl_ctx,
-                sumD_sumD2_sumDr_T, sumR_sumR2_T,
-                r_size * r_size, r_i, r_j,
-                originXMult);
-            
-            texInfo* rangeTransform_T = searchReduce(cgl_ctx,
-                rangeCandidates_T,
-                log2int(rangeCandidates_T->aW));
-            
-            GLfloat* transform = createTupleFromPointTexture(cgl_ctx, rangeTransform_T);
-            
-            releaseTexture(cgl_ctx, Dr_T);
-            releaseTexture(cgl_ctx, sumDr_T);
-            releaseTexture(cgl_ctx, sumD_sumD2_sumDr_T);
-            releaseTexture(cgl_ctx, rangeCandidates_T);
-            releaseTexture(cgl_ctx, rangeTransform_T);
-            
-            GLfloat MSE = transform[0];
-            GLfloat s = transform[1];
-            GLfloat o = transform[2];
-            GLfloat packedOrigin = transform[3];
-            
-            size_t d_i = (size_t)    (transform[3] / originXMult) / 2;
-            size_t d_j = (size_t)fmod(transform[3],  originXMult) / 2;
-            
-            fprintf(trnOutFile, "[%03d : %03d, %03d : %03d] = % f + % f * [%03d : %03d, %03d : %03d]\n",
-                r_i * r_size, (r_i + 1) * r_size,
-                r_j * r_size, (r_j + 1) * r_size,
-                o, s,
-                d_i * d_size, (d_i + 1) * d_size,
-                d_j * d_size, (d_j + 1) * d_size);
-            
-            free(transform);
-        }
-        
-        printf("row %d / %d\n", 1 + r_j, R_T->aH / r_size);
+        double rms = atof(opt + 8) / 255.0;
+        if (rms < 0.0) ERR("bad stoprms", opt + 8);
+        opts->spiralStopMSE = rms * rms;
+    }
+    else if (strncmp("stoprel=", opt, 8) == 0)
+    {
+        opts->spiralStopRelative = atof(opt + 8);
+        if (opts->spiralStopRelative < 0.0) ERR("bad stoprel", opt + 8);
+    }
+    else if (strcmp("isometries=1", opt) == 0)
+    {
+        opts->isometries = 1;
+    }
+    else if (strncmp("rangecache=", opt, 11) == 0)
+    {
+        opts->cacheLevels = atoi(opt + 11);
+        if (opts->cacheLevels < 0) ERR("bad rangecache", opt + 11);
+    }
+    else if (strncmp("parents=", opt, 8) == 0)
+    {
+        if (atoi(opt + 8) < 0) ERR("bad parents", opt + 8);
+        opts->fixedParents = 1;
+        opts->parentRadius = atoi(opt + 8);
+    }
+    else if (strncmp("step=", opt, 5) == 0)
+    {
+        if (atoi(opt + 5) <= 0) ERR("bad step", opt + 5);
+        opts->domainStep = atoi(opt + 5);
+    }
+    else if (strncmp("budget=", opt, 7) == 0)
+    {
+        opts->budgetSeconds = atof(opt + 7);
+        if (opts->budgetSeconds < 0.0) ERR("bad budget", opt + 7);
+    }
+    else if (strncmp("searches=", opt, 9) == 0)
+    {
+        if (atoi(opt + 9) < 0) ERR("bad searches", opt + 9);
+        opts->budgetSearches = atoi(opt + 9);
+    }
+    else if (strncmp("engine=", opt, 7) == 0)
+    {
+        char* value = opt + 7;
+        if      (strcmp("gl", value) == 0) opts->engine = ENGINE_GL;
+        else if (strcmp("int", value) == 0) opts->engine = ENGINE_INT;
+        else if (strcmp("gemm", value) == 0) opts->engine = ENGINE_GEMM;
+        else if (strcmp("compute", value) == 0) opts->engine = ENGINE_COMPUTE;
+        else ERR("bad engine", value);
+    }
+    else
+    {
+        return 0;
     }
     
-    fclose(trnOutFile);
-    
-    free(srcPath);
-    free(trnOutPath);
-    
-    return EXIT_SUCCESS;
-}
-
-/* TODO: astoundingly inefficient, use glGetPixels maybe? */
-GLfloat* createTupleFromPointTexture(CGLContextObj cgl_ctx,
-    texInfo* t)
-{
-    void* texDataBase = malloc(sizeof(GLfloat) * 4 * t->w * t->h);
-    glBindTexture(GL_TEXTURE_RECTANGLE_ARB, t->tex);
-    glGetTexImage(
-        GL_TEXTURE_RECTANGLE_ARB, 0, GL_RGBA,
-        GL_FLOAT, texDataBase);
-    CHK_OGL;
-    
-    void* tuple = malloc(sizeof(GLfloat) * t->aC);
-    memcpy(tuple, texDataBase, sizeof(GLfloat) * t->aC);
-    
-    free(texDataBase);
-    
-    return (GLfloat*)tuple;
+    return 1;
 }
 
-texInfo* calcSO(CGLContextObj cgl_ctx,
-    texInfo* sumD_sumD2_sumDr_T, texInfo* sumR_sumR2_T,
-    size_t n, size_t r_i, size_t r_j,
-    GLfloat originXMult)
+/* zlib=<0-9> and pngthreads=<n> for written PNGs */
+static int parseImageWriteOption(imageWriteOptions* wo, char* opt)
 {
-    glUseProgram(calcSOShader);
-    glUniform1i(calcSOShader_sumD_sumD2_sumDr_tex, 0 /* GL_TEXTURE0 */);
-    glUniform1i(calcSOShader_sumR_sumR2_tex, 1 /* GL_TEXTURE1 */);
-    glUniform1f(calcSOShader_n, n);
-    glUniform1f(calcSOShader_r_i, r_i);
-    glUniform1f(calcSOShader_r_j, r_j);
-    glUniform1i(calcSOShader_originXMult, originXMult);
-    CHK_OGL;
-    
-    texInfo* dstT = createEmptyTexture(cgl_ctx, GL_RGBA32F_ARB, fbW, fbH);
-    dstT->aW = sumD_sumD2_sumDr_T->aW;
-    dstT->aH = sumD_sumD2_sumDr_T->aH;
-    dstT->aC = 4;
-    
-    glFramebufferTexture2DEXT(
-        GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT2_EXT,
-        GL_TEXTURE_RECTANGLE_ARB, dstT->tex, 0);
-    glDrawBuffer(GL_COLOR_ATTACHMENT2_EXT);
-    CHK_OGL;
-    CHK_FBO;
-    
-    glUniform1f(calcSOShader_w, sumD_sumD2_sumDr_T->w);
-    glUniform1f(calcSOShader_h, sumD_sumD2_sumDr_T->h);
-    CHK_OGL;
-    
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_RECTANGLE_ARB, sumD_sumD2_sumDr_T->tex);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_RECTANGLE_ARB, sumR_sumR2_T->tex);
-    CHK_OGL;
-    
-    glViewport(0, 0, dstT->w, dstT->h);
-    glClear(GL_COLOR_BUFFER_BIT);
-    glDrawArrays(GL_QUADS, 0, 4);
-    glFlush();
-    CHK_OGL;
-    
-    glFramebufferTexture2DEXT(
-        GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT2_EXT,
-        GL_TEXTURE_RECTANGLE_ARB, 0, 0);
+    if (strncmp("zlib=", opt, 5) == 0)
+    {
+        wo->zlibLevel = atoi(opt + 5);
+        if (wo->zlibLevel < 0 || wo->zlibLevel > 9) ERR("bad zlib level", opt + 5);
+    }
+    else if (strncmp("pngthreads=", opt, 11) == 0)
+    {
+        if (atoi(opt + 11) < 1) ERR("bad pngthreads", opt + 11);
+        wo->numThreads = atoi(opt + 11);
+    }
+    else
+    {
+        return 0;
+    }
     
-    return dstT;
+    return 1;
 }
 
-texInfo* multiplyTiled(CGLContextObj cgl_ctx,
-    texInfo* D_T, texInfo* R_T,
-    size_t r_size, size_t r_x, size_t r_y)
+/* mag=<log2 of the magnification> and iterations=<n> for decoding */
+static int parseDecodeOption(size_t* magExp, size_t* iterations, char* opt)
 {
-    glUseProgram(multiplyTiledShader);
-    glUniform1i(multiplyTiledShader_D_tex, 0 /* GL_TEXTURE0 */);
-    glUniform1i(multiplyTiledShader_R_tex, 1 /* GL_TEXTURE1 */);
-    glUniform1f(multiplyTiledShader_r_size, r_size);
-    glUniform1f(multiplyTiledShader_r_x, r_x);
-    glUniform1f(multiplyTiledShader_r_y, r_y);
-    CHK_OGL;
-    
-    texInfo* dstT = createEmptyTexture(cgl_ctx, GL_RGBA32F_ARB, fbW, fbH);
-    dstT->aW = D_T->aW;
-    dstT->aH = D_T->aH;
-    dstT->aC = D_T->aC;
-    
-    glFramebufferTexture2DEXT(
-        GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT2_EXT,
-        GL_TEXTURE_RECTANGLE_ARB, dstT->tex, 0);
-    glDrawBuffer(GL_COLOR_ATTACHMENT2_EXT);
-    CHK_OGL;
-    CHK_FBO;
-    
-    glUniform1f(multiplyTiledShader_w, D_T->w);
-    glUniform1f(multiplyTiledShader_h, D_T->h);
-    CHK_OGL;
-    
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_RECTANGLE_ARB, D_T->tex);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_RECTANGLE_ARB, R_T->tex);
-    CHK_OGL;
-    
-    glViewport(0, 0, dstT->w, dstT->h);
-    glClear(GL_COLOR_BUFFER_BIT);
-    glDrawArrays(GL_QUADS, 0, 4);
-    glFlush();
-    CHK_OGL;
-    
-    glFramebufferTexture2DEXT(
-        GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT2_EXT,
-        GL_TEXTURE_RECTANGLE_ARB, 0, 0);
+    if (strncmp("mag=", opt, 4) == 0)
+    {
+        if (atoi(opt + 4) < 0 || atoi(opt + 4) > 8) ERR("bad mag", opt + 4);
+        *magExp = atoi(opt + 4);
+    }
+    else if (strncmp("iterations=", opt, 11) == 0)
+    {
+        if (atoi(opt + 11) < 1) ERR("bad iterations", opt + 11);
+        *iterations = atoi(opt + 11);
+    }
+    else
+    {
+        return 0;
+    }
     
-    return dstT;
+    return 1;
 }
 
-texInfo* paint(CGLContextObj cgl_ctx,
-    texInfo* srcT,
-    size_t dstW, size_t dstH)
+/* decodes on the GPU, or on the CPU with engine=int or engine=gemm */
+static void decode(int argc, char** argv)
 {
-    glUseProgram(paintShader);
-    glActiveTexture(GL_TEXTURE0);
-    glUniform1i(paintShader_tex, 0 /* GL_TEXTURE0 */);
-    CHK_OGL;
-    
-    texInfo* dstT = createEmptyTexture(cgl_ctx, GL_RGBA32F_ARB, fbW, fbH);
-    dstT->aW = dstW;
-    dstT->aH = dstH;
-    dstT->aC = srcT->aC;
-    
-    glFramebufferTexture2DEXT(
-        GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT2_EXT,
-        GL_TEXTURE_RECTANGLE_ARB, dstT->tex, 0);
-    glDrawBuffer(GL_COLOR_ATTACHMENT2_EXT);
-    CHK_OGL;
-    CHK_FBO;
-    
-    glUniform1f(paintShader_w, srcT->w);
-    glUniform1f(paintShader_h, srcT->h);
-    CHK_OGL;
-    
-    glBindTexture(GL_TEXTURE_RECTANGLE_ARB, srcT->tex);
-    CHK_OGL;
-    
-    glViewport(0, 0, dstW, dstH);
-    glClear(GL_COLOR_BUFFER_BIT);
-    glDrawArrays(GL_QUADS, 0, 4);
-    glFlush();
-    CHK_OGL;
-    
-    glFramebufferTexture2DEXT(
-        GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT2_EXT,
-        GL_TEXTURE_RECTANGLE_ARB, 0, 0);
+    size_t magExp = 0;
+    size_t iterations = 10;
+    fractureOptions opts;
+    initFractureOptions(&opts);
+    imageWriteOptions wo;
+    initImageWriteOptions(&wo);
+    int argi;
+    for (argi = 4; argi < argc; argi++)
+    {
+        char* opt = argv[argi];
+        if (!parseDecodeOption(&magExp, &iterations, opt) &&
+            !parseFractureOption(&opts, opt) &&
+            !parseImageWriteOption(&wo, opt))
+        {
+            ERR("unknown option", opt);
+        }
+    }
     
-    return dstT;
+    FILE* trnInFile = fopen(argv[2], "r");
+    CHK_NULL(trnInFile, "fopen() failed", argv[2]);
+    const char* failure;
+    fractureEncoding* enc = readFractureEncoding(trnInFile, &failure);
+    fclose(trnInFile);
+    CHK_NULL(enc, (char*)failure, argv[2]);
+    
+    fractureContext* fc = createFractureContext(&opts, &failure);
+    CHK_NULL(fc, (char*)failure, "");
+    uint8_t* pixels = fractureDecode(fc, enc, magExp, iterations);
+    size_t w = enc->w << magExp;
+    failure = writeGrayImage(argv[3], pixels, w, enc->h << magExp, w, &wo);
+    if (failure != NULL) ERR((char*)failure, argv[3]);
+    
+    free(pixels);
+    releaseFractureContext(fc);
+    releaseFractureEncoding(enc);
 }
 
-texInfo* square(CGLContextObj cgl_ctx,
-    texInfo* srcT)
+/* image in, enlarged image out, with no transform file in between */
+static void enlarge(int argc, char** argv)
 {
-    glUseProgram(squareShader);
-    glActiveTexture(GL_TEXTURE0);
-    glUniform1i(squareShader_tex, 0 /* GL_TEXTURE0 */);
-    CHK_OGL;
-    
-    texInfo* dstT = createEmptyTexture(cgl_ctx, GL_RGBA32F_ARB, fbW, fbH);
-    dstT->aW = srcT->aW;
-    dstT->aH = srcT->aH;
-    dstT->aC = 2;
-    
-    glFramebufferTexture2DEXT(
-        GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT2_EXT,
-        GL_TEXTURE_RECTANGLE_ARB, dstT->tex, 0);
-    glDrawBuffer(GL_COLOR_ATTACHMENT2_EXT);
-    CHK_OGL;
-    CHK_FBO;
-    
-    glUniform1f(squareShader_w, srcT->w);
-    glUniform1f(squareShader_h, srcT->h);
-    CHK_OGL;
-    
-    glBindTexture(GL_TEXTURE_RECTANGLE_ARB, srcT->tex);
-    CHK_OGL;
-    
-    glViewport(0, 0, dstT->w, dstT->h);
-    glClear(GL_COLOR_BUFFER_BIT);
-    glDrawArrays(GL_QUADS, 0, 4);
-    glFlush();
-    CHK_OGL;
+    size_t d_size;
+    size_t r_size;
+    if      (strncmp("SD", argv[4], 3) == 0)
+    {
+        d_size = 8;
+        r_size = 4;
+    }
+    else if (strncmp("HD", argv[4], 3) == 0)
+    {
+        d_size = 4;
+        r_size = 2;
+    }
+    else
+    {
+        ERR("bad quality argument", argv[4]);
+    }
     
-    glFramebufferTexture2DEXT(
-        GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT2_EXT,
-        GL_TEXTURE_RECTANGLE_ARB, 0, 0);
+    size_t magExp = 1;
+    size_t iterations = 10;
+    fractureOptions opts;
+    initFractureOptions(&opts);
+    imageWriteOptions wo;
+    initImageWriteOptions(&wo);
+    int argi;
+    for (argi = 5; argi < argc; argi++)
+    {
+        char* opt = argv[argi];
+        if (!parseDecodeOption(&magExp, &iterations, opt) &&
+            !parseFractureOption(&opts, opt) &&
+            !parseImageWriteOption(&wo, opt))
+        {
+            ERR("unknown option", opt);
+        }
+    }
     
-    return dstT;
+    const char* failure;
+    grayImage* img = loadGrayImage(argv[2], &failure);
+    CHK_NULL(img, (char*)failure, argv[2]);
+    fractureContext* fc = createFractureContext(&opts, &failure);
+    CHK_NULL(fc, (char*)failure, "");
+    uint8_t* pixels = fractureEnlarge(fc, img->data, img->w, img->h, img->stride,
+        d_size, r_size, magExp, iterations);
+    size_t w = img->w << magExp;
+    failure = writeGrayImage(argv[3], pixels, w, img->h << magExp, w, &wo);
+    if (failure != NULL) ERR((char*)failure, argv[3]);
+    
+    free(pixels);
+    releaseFractureContext(fc);
+    releaseGrayImage(img);
 }
 
-texInfo* zipper(CGLContextObj cgl_ctx,
-    texInfo* rgT, texInfo* baT)
+static void serve(int argc, char** argv)
 {
-    glUseProgram(zipperShader);
-    glUniform1i(zipperShader_RG_tex, 0 /* GL_TEXTURE0 */);
-    glUniform1i(zipperShader_BA_tex, 1 /* GL_TEXTURE1 */);
-    CHK_OGL;
-    
-    texInfo* dstT = createEmptyTexture(cgl_ctx, GL_RGBA32F_ARB, fbW, fbH);
-    dstT->aW = rgT->aW;
-    dstT->aH = rgT->aH;
-    dstT->aC = rgT->aC + baT->aC; /* works if rgT->aC == 2 and baT->aC == 1 or 2 */
-    
-    glFramebufferTexture2DEXT(
-        GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT2_EXT,
-        GL_TEXTURE_RECTANGLE_ARB, dstT->tex, 0);
-    glDrawBuffer(GL_COLOR_ATTACHMENT2_EXT);
-    CHK_OGL;
-    CHK_FBO;
-    
-    glUniform1f(zipperShader_w, rgT->w);
-    glUniform1f(zipperShader_h, rgT->h);
-    CHK_OGL;
-    
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_RECTANGLE_ARB, rgT->tex);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_RECTANGLE_ARB, baT->tex);
-    CHK_OGL;
-    
-    glViewport(0, 0, dstT->w, dstT->h);
-    glClear(GL_COLOR_BUFFER_BIT);
-    glDrawArrays(GL_QUADS, 0, 4);
-    glFlush();
-    CHK_OGL;
-    
-    glFramebufferTexture2DEXT(
-        GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT2_EXT,
-        GL_TEXTURE_RECTANGLE_ARB, 0, 0);
+    serverOptions so;
+    initFractureOptions(&so.encoder);
+    so.numWorkers = 1;
+    so.queueLength = 64;
+    so.cacheEntries = 16;
+    initImageWriteOptions(&so.output);
+    int argi;
+    for (argi = 3; argi < argc; argi++)
+    {
+        char* opt = argv[argi];
+        if (parseFractureOption(&so.encoder, opt))
+        {
+            continue;
+        }
+        else if (strncmp("workers=", opt, 8) == 0)
+        {
+            if (atoi(opt + 8) < 1) ERR("bad workers", opt + 8);
+            so.numWorkers = atoi(opt + 8);
+        }
+        else if (strncmp("queue=", opt, 6) == 0)
+        {
+            if (atoi(opt + 6) < 1) ERR("bad queue", opt + 6);
+            so.queueLength = atoi(opt + 6);
+        }
+        else if (strncmp("cache=", opt, 6) == 0)
+        {
+            if (atoi(opt + 6) < 0) ERR("bad cache", opt + 6);
+            so.cacheEntries = atoi(opt + 6);
+        }
+        else if (parseImageWriteOption(&so.output, opt))
+        {
+            continue;
+        }
+        else
+        {
+            ERR("unknown option", opt);
+        }
+    }
     
-    return dstT;
+    runServer(argv[2], &so);
 }
 
-texInfo* sumReduce(CGLContextObj cgl_ctx,
-    texInfo* srcT,
-    size_t times)
-{
-    if (times == 0)
+int main(int argc, char** argv)
+{   
+    if (argc > 2 && strcmp("serve", argv[1]) == 0)
     {
-        ERR("degenerate reduction", "did you do something wrong?");
+        serve(argc, argv);
+        return EXIT_SUCCESS;
+    }
+    if (argc > 2 && strcmp("client", argv[1]) == 0)
+    {
+        return runClient(argv[2], argc - 3, argv + 3);
+    }
+    if (argc > 3 && strcmp("decode", argv[1]) == 0)
+    {
+        decode(argc, argv);
+        return EXIT_SUCCESS;
+    }
+    if (argc > 4 && strcmp("enlarge", argv[1]) == 0)
+    {
+        enlarge(argc, argv);
+        return EXIT_SUCCESS;
     }
     
-    size_t w = srcT->aW;
-    size_t h = srcT->aH;
-    
-    texInfo* dstT = createEmptyTexture(cgl_ctx, GL_RGBA32F_ARB, fbW, fbH);
-    dstT->aW = w >> times;
-    dstT->aH = h >> times;
-    dstT->aC = srcT->aC;
-    
-    glFramebufferTexture2DEXT(
-        GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT2_EXT,
-        GL_TEXTURE_RECTANGLE_ARB, dstT->tex, 0);
-    
-    glUseProgram(sumReductionShader);
-    glActiveTexture(GL_TEXTURE0);
-    glUniform1i(sumReductionShader_tex, 0 /* GL_TEXTURE0 */);
-    CHK_OGL;
-    
-    if (times == 1)
+    size_t numLevels = 0;
+    size_t d_sizes[MAX_LEVELS];
+    size_t r_sizes[MAX_LEVELS];
+    char* outSuffixes[MAX_LEVELS];
+    char* srcBase;
+    char* quality;
+    int batch = argc > 1 && strcmp("batch", argv[1]) == 0;
+    int firstOpt = batch ? 4 : 3;
+    if (argc < firstOpt)
     {
-        glBindTexture(GL_TEXTURE_RECTANGLE_ARB, srcT->tex);
-        glDrawBuffer(GL_COLOR_ATTACHMENT2_EXT);
-        CHK_OGL;
-        CHK_FBO;
-        
-        glUniform1f(sumReductionShader_w, w);
-        glUniform1f(sumReductionShader_h, h);
-        CHK_OGL;
-        
-        glViewport(0, 0, w / 2, h / 2);
-        glClear(GL_COLOR_BUFFER_BIT);
-        glDrawArrays(GL_QUADS, 0, 4);
-        glFlush();
-        CHK_OGL;
+        ERR("not enough arguments", "");
     }
     else
     {
-        glBindTexture(GL_TEXTURE_RECTANGLE_ARB, srcT->tex);
-        glDrawBuffer(GL_COLOR_ATTACHMENT0_EXT);
-        CHK_OGL;
-        CHK_FBO;
-        
-        glUniform1f(sumReductionShader_w, w);
-        glUniform1f(sumReductionShader_h, h);
-        CHK_OGL;
+        srcBase = argv[firstOpt - 2];
+        quality = argv[firstOpt - 1];
         
-        glViewport(0, 0, w / 2, h / 2);
-        glClear(GL_COLOR_BUFFER_BIT);
-        glDrawArrays(GL_QUADS, 0, 4);
-        glFlush();
-        CHK_OGL;
-        
-        GLuint ping = 0;
-        GLuint pong = 1;
-        
-        size_t i;
-        for (i = 0; i < times - 2; i++)
+        /* SD, HD, or both joined by + to encode them in one pass */
+        char* levels = strdup(quality);
+        char* saveptr;
+        char* level;
+        for (level = strtok_r(levels, "+", &saveptr); level != NULL; level = strtok_r(NULL, "+", &saveptr))
         {
-            w /= 2;
-            h /= 2;
-            
-            glUniform1f(sumReductionShader_w, w);
-            glUniform1f(sumReductionShader_h, h);
-            CHK_OGL;
-            
-            glBindTexture(GL_TEXTURE_RECTANGLE_ARB, fboTex[ping]);
-            glDrawBuffer(GL_COLOR_ATTACHMENT0_EXT + pong);
-            CHK_OGL;
-            CHK_FBO;
+            size_t k = numLevels++;
+            if (k == MAX_LEVELS)
+            {
+                ERR("bad quality argument", quality);
+            }
             
-            glViewport(0, 0, w / 2, h / 2);
-            glClear(GL_COLOR_BUFFER_BIT);
-            glDrawArrays(GL_QUADS, 0, 4);
-            glFlush();
-            CHK_OGL;
-            
-            ping ^= 1;
-            pong ^= 1;
+            if      (strcmp("SD", level) == 0)
+            {
+                d_sizes[k] = 8;
+                r_sizes[k] = 4;
+                outSuffixes[k] = "";
+            }
+            else if (strcmp("HD", level) == 0)
+            {
+                d_sizes[k] = 4;
+                r_sizes[k] = 2;
+                outSuffixes[k] = "-HD";
+            }
+            else
+            {
+                ERR("bad quality argument", quality);
+            }
+            if (k > 0 && r_sizes[k] == r_sizes[0])
+            {
+                ERR("bad quality argument", quality);
+            }
+        }
+        free(levels);
+        if (numLevels == 0)
+        {
+            ERR("bad quality argument", quality);
+        }
+        if (batch && numLevels > 1)
+        {
+            ERR("several qualities need a single image", quality);
         }
-        
-        w /= 2;
-        h /= 2;
-        
-        glUniform1f(sumReductionShader_w, w);
-        glUniform1f(sumReductionShader_h, h);
-        CHK_OGL;
-        
-        glBindTexture(GL_TEXTURE_RECTANGLE_ARB, fboTex[ping]);
-        glDrawBuffer(GL_COLOR_ATTACHMENT2_EXT);
-        CHK_OGL;
-        CHK_FBO;
-        
-        glViewport(0, 0, w / 2, h / 2);
-        glClear(GL_COLOR_BUFFER_BIT);
-        glDrawArrays(GL_QUADS, 0, 4);
-        glFlush();
-        CHK_OGL;
     }
     
-    glFramebufferTexture2DEXT(
-        GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT2_EXT,
-        GL_TEXTURE_RECTANGLE_ARB, 0, 0);
-    
-    return dstT;
-}
-
-texInfo* searchReduce(CGLContextObj cgl_ctx,
-    texInfo* srcT,
-    size_t times)
-{
-    if (times == 0)
+    fractureOptions opts;
+    initFractureOptions(&opts);
+    opts.progress = batch ? NULL : printProgress;
+    batchOptions bo;
+    bo.d_size = d_sizes[0];
+    bo.r_size = r_sizes[0];
+    bo.outSuffix = outSuffixes[0];
+    bo.numReaders = 2;
+    bo.numWriters = 1;
+    bo.prefetch = 4;
+    bo.changeThreshold = -1.0;
+    int argi;
+    for (argi = firstOpt; argi < argc; argi++)
     {
-        ERR("degenerate reduction", "did you do something wrong?");
+        char* opt = argv[argi];
+        if (parseFractureOption(&opts, opt))
+        {
+            continue;
+        }
+        else if (batch && strncmp("readers=", opt, 8) == 0)
+        {
+            if (atoi(opt + 8) < 1) ERR("bad readers", opt + 8);
+            bo.numReaders = atoi(opt + 8);
+        }
+        else if (batch && strncmp("writers=", opt, 8) == 0)
+        {
+            if (atoi(opt + 8) < 1) ERR("bad writers", opt + 8);
+            bo.numWriters = atoi(opt + 8);
+        }
+        else if (batch && strncmp("prefetch=", opt, 9) == 0)
+        {
+            if (atoi(opt + 9) < 1) ERR("bad prefetch", opt + 9);
+            bo.prefetch = atoi(opt + 9);
+        }
+        else if (!batch && strncmp("snapshots=", opt, 10) == 0)
+        {
+            opts.snapshotInterval = atof(opt + 10);
+            if (opts.snapshotInterval <= 0.0) ERR("bad snapshots", opt + 10);
+        }
+        else if (batch && strncmp("changed=", opt, 8) == 0)
+        {
+            bo.changeThreshold = atof(opt + 8);
+            if (bo.changeThreshold < 0.0) ERR("bad changed", opt + 8);
+        }
+        else
+        {
+            ERR("unknown option", opt);
+        }
     }
     
-    size_t w = srcT->aW;
-    size_t h = srcT->aH;
-    
-    texInfo* dstT = createEmptyTexture(cgl_ctx, GL_RGBA32F_ARB, fbW, fbH);
-    dstT->aW = w >> times;
-    dstT->aH = h >> times;
-    dstT->aC = 4;
-    
-    glFramebufferTexture2DEXT(
-        GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT2_EXT,
-        GL_TEXTURE_RECTANGLE_ARB, dstT->tex, 0);
+    char* trnOutPaths[MAX_LEVELS];
+    size_t k;
+    for (k = 0; k < numLevels; k++)
+    {
+        asprintf(&trnOutPaths[k], "OpenGL-%s%s.trn", srcBase, outSuffixes[k]);
+    }
+    if (opts.snapshotInterval > 0.0)
+    {
+        if (numLevels > 1) ERR("snapshots need a single quality", quality);
+        opts.snapshot = writeSnapshot;
+        opts.userData = trnOutPaths[0];
+    }
     
-    glUseProgram(searchReductionShader);
-    glActiveTexture(GL_TEXTURE0);
-    glUniform1i(searchReductionShader_tex, 0 /* GL_TEXTURE0 */);
-    CHK_OGL;
+    const char* failure;
+    fractureContext* fc = createFractureContext(&opts, &failure);
+    CHK_NULL(fc, (char*)failure, "");
     
-    if (times == 1)
+    if (batch)
     {
-        glBindTexture(GL_TEXTURE_RECTANGLE_ARB, srcT->tex);
-        glDrawBuffer(GL_COLOR_ATTACHMENT2_EXT);
-        CHK_OGL;
-        CHK_FBO;
-        
-        glUniform1f(searchReductionShader_w, w);
-        glUniform1f(searchReductionShader_h, h);
-        CHK_OGL;
+        size_t count;
+        char** inputs = createBatchInputList(srcBase, &count);
+        runBatch(fc, inputs, count, &bo);
+        releaseBatchInputList(inputs, count);
+        releaseFractureContext(fc);
+        free(trnOutPaths[0]);
         
-        glViewport(0, 0, w / 2, h / 2);
-        glClear(GL_COLOR_BUFFER_BIT);
-        glDrawArrays(GL_QUADS, 0, 4);
-        glFlush();
-        CHK_OGL;
+        return EXIT_SUCCESS;
     }
-    else
+    
+    /* load image to process */
+    char* srcPath;
+    asprintf(&srcPath, "../data/%s.png", srcBase);
+    grayImage* img = loadGrayImage(srcPath, &failure);
+    CHK_NULL(img, (char*)failure, srcPath);
+    
+    struct timeval start, end;
+    gettimeofday(&start, NULL);
+    fractureEncoding* encs[MAX_LEVELS];
+    fractureEncodeLevels(fc, img->data, img->w, img->h, img->stride, d_sizes, r_sizes, numLevels, encs);
+    gettimeofday(&end, NULL);
+    double seconds = (end.tv_sec - start.tv_sec) + 1e-6 * (end.tv_usec - start.tv_usec);
+    
+    for (k = 0; k < numLevels; k++)
     {
-        glBindTexture(GL_TEXTURE_RECTANGLE_ARB, srcT->tex);
-        glDrawBuffer(GL_COLOR_ATTACHMENT0_EXT);
-        CHK_OGL;
-        CHK_FBO;
+        fractureEncoding* enc = encs[k];
         
-        glUniform1f(searchReductionShader_w, w);
-        glUniform1f(searchReductionShader_h, h);
-        CHK_OGL;
-        
-        glViewport(0, 0, w / 2, h / 2);
-        glClear(GL_COLOR_BUFFER_BIT);
-        glDrawArrays(GL_QUADS, 0, 4);
-        glFlush();
-        CHK_OGL;
-        
-        GLuint ping = 0;
-        GLuint pong = 1;
-        
-        size_t i;
-        for (i = 0; i < times - 2; i++)
+        if (opts.snapshot != NULL)
         {
-            w /= 2;
-            h /= 2;
-            
-            glUniform1f(searchReductionShader_w, w);
-            glUniform1f(searchReductionShader_h, h);
-            CHK_OGL;
-            
-            glBindTexture(GL_TEXTURE_RECTANGLE_ARB, fboTex[ping]);
-            glDrawBuffer(GL_COLOR_ATTACHMENT0_EXT + pong);
-            CHK_OGL;
-            CHK_FBO;
-            
-            glViewport(0, 0, w / 2, h / 2);
-            glClear(GL_COLOR_BUFFER_BIT);
-            glDrawArrays(GL_QUADS, 0, 4);
-            glFlush();
-            CHK_OGL;
-            
-            ping ^= 1;
-            pong ^= 1;
+            writeSnapshot(trnOutPaths[k], enc);
+        }
+        else
+        {
+            FILE* trnOutFile = fopen(trnOutPaths[k], "w");
+            CHK_NULL(trnOutFile, "fopen() failed", trnOutPaths[k]);
+            writeFractureEncoding(trnOutFile, enc);
+            fclose(trnOutFile);
         }
         
-        w /= 2;
-        h /= 2;
+        if (opts.engine == ENGINE_GL && opts.cullRMS > 0.0)
+        {
+            printf("cull: %0.2f%% of domain blocks skipped\n", 100.0 * enc->culledFraction);
+        }
+        if (opts.engine == ENGINE_GL && opts.precision == PRECISION_FP16_CHECK)
+        {
+            size_t numRanges = enc->rangeCols * enc->rangeRows;
+            printf("fp16: %d / %d ranges (%0.2f%%) chose a different domain than fp32\n",
+                (int)enc->fp16Mismatches, (int)numRanges, 100.0 * enc->fp16Mismatches / numRanges);
+        }
         
-        glUniform1f(searchReductionShader_w, w);
-        glUniform1f(searchReductionShader_h, h);
-        CHK_OGL;
+        if (opts.cacheLevels > 0)
+        {
+            printf("cache: %d / %d ranges (%0.2f%%) refit to a cached domain\n",
+                (int)enc->cacheHits, (int)enc->rangesSearched, 100.0 * enc->cacheHits / enc->rangesSearched);
+        }
+        if (opts.spiral)
+        {
+            printf("spiral: %0.1f domains examined per range\n",
+                (double)enc->domainsExamined / enc->rangesSearched);
+        }
+        if (opts.budgetSeconds > 0.0 || opts.budgetSearches > 0)
+        {
+            size_t numRanges = enc->rangeCols * enc->rangeRows;
+            printf("anytime: %d / %d ranges (%0.2f%%) searched in full\n",
+                (int)enc->rangesSearched, (int)numRanges, 100.0 * enc->rangesSearched / numRanges);
+        }
         
-        glBindTexture(GL_TEXTURE_RECTANGLE_ARB, fboTex[ping]);
-        glDrawBuffer(GL_COLOR_ATTACHMENT2_EXT);
-        CHK_OGL;
-        CHK_FBO;
+        if (opts.coarseCandidates > 0 && opts.coarseCheck)
+        {
+            size_t numRanges = enc->rangeCols * enc->rangeRows;
+            printf("coarse: %d / %d ranges (%0.2f%%) missed the exhaustive search's domain\n",
+                (int)enc->coarseMisses, (int)numRanges, 100.0 * enc->coarseMisses / numRanges);
+            printf("coarse: mean MSE %g above the exhaustive search's\n", enc->coarseExcessMSE);
+        }
         
-        glViewport(0, 0, w / 2, h / 2);
-        glClear(GL_COLOR_BUFFER_BIT);
-        glDrawArrays(GL_QUADS, 0, 4);
-        glFlush();
-        CHK_OGL;
+        releaseFractureEncoding(enc);
     }
     
-    glFramebufferTexture2DEXT(
-        GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT2_EXT,
-        GL_TEXTURE_RECTANGLE_ARB, 0, 0);
+    if (opts.fixedParents)
+    {
+        printf("parents: %d x %d in %0.4f s (%0.1f megapixels/s)\n",
+            (int)img->w, (int)img->h, seconds, 1e-6 * numLevels * img->w * img->h / seconds);
+    }
+    if (numLevels > 1)
+    {
+        printf("levels: %s in %0.3f s\n", quality, seconds);
+    }
     
-    return dstT;
-}
\ No newline at end of file
+    releaseGrayImage(img);
+    free(srcPath);
+    for (k = 0; k < numLevels; k++)
+    {
+        free(trnOutPaths[k]);
+    }
+    
+    releaseFractureContext(fc);
+    
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,184 @@
+#ifndef FRACTURE_H
+#define FRACTURE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "transform.h"
+
+/*
+ * libfracture: fractal encoding of 8-bit grayscale images in memory
+ *
+ * A fractureContext owns everything an encoder needs, including its own GL
+ * context for the GL engines, so a process can keep several and reuse each
+ * for many images. A context must only be used by one thread at a time,
+ * but any thread may use it between calls.
+ */
+
+/*
+ * engines: GL fragment shader passes, integer SIMD kernels on the CPU,
+ * all ranges at once as a blocked matrix product on the CPU, or all ranges
+ * at once in a GL compute shader
+ */
+#define ENGINE_GL 0
+#define ENGINE_INT 1
+#define ENGINE_GEMM 2
+#define ENGINE_COMPUTE 3
+
+/* precision modes: fp32 everywhere, or fp16 image and product storage with fp32 sums */
+#define PRECISION_FP32 0
+#define PRECISION_FP16 1
+#define PRECISION_FP16_CHECK 2 /* fp16 output, compared against fp32 for every range */
+
+struct fractureEncoding;
+
+typedef struct fractureOptions {
+    const char* backend;        /* GL backend name, NULL for the platform default */
+    int engine;
+    int precision;              /* GL engine only */
+    float cullRMS;              /* GL engine only, see glEncoder */
+    size_t coarseCandidates;    /* int engine only: k for cpuSearchRangeCoarse, 0 searches exhaustively */
+    int coarseCheck;            /* also run the exhaustive search and count the coarse search's misses */
+    int spiral;                 /* int engine only: search outwards from each range, see cpuSearchRangeSpiral */
+    size_t spiralMaxDomains;    /* 0 for no limit */
+    double spiralStopMSE;
+    double spiralStopRelative;  /* of the range's variance */
+    int isometries;             /* int engine only: also match rotated and flipped domains */
+    size_t domainStep;          /* int and gemm engines: decimated pixels between domain origins, 0 to tile */
+    int cacheLevels;            /* gl and int engines: reuse domains of same-shaped ranges, see rangeCache; 0 for off */
+    int fixedParents;           /* no domain search, see fractureEncode */
+    size_t parentRadius;        /* with fixedParents, also try the parents this many blocks away */
+
+    /* anytime encoding when either budget is set, see fractureEncode; 0 for no limit */
+    double budgetSeconds;       /* wall clock */
+    size_t budgetSearches;      /* ranges searched in full */
+    double snapshotInterval;    /* seconds between snapshot calls */
+
+    /* called as rows of ranges are finished, may be NULL */
+    void (*progress)(void* userData, size_t rowsDone, size_t rows);
+    /* called with the complete, partly refined transforms of an anytime encode, may be NULL */
+    void (*snapshot)(void* userData, const struct fractureEncoding* enc);
+    void* userData;
+} fractureOptions;
+
+void initFractureOptions(fractureOptions* opts);
+
+typedef struct fractureContext fractureContext;
+
+/* NULL with a message in *failure for conflicting options or no usable GL */
+fractureContext* createFractureContext(const fractureOptions* opts, const char** failure);
+void releaseFractureContext(fractureContext* fc);
+
+/*
+ * an encoded image: one transform per range block, row by row
+ */
+typedef struct fractureEncoding {
+    size_t w;
+    size_t h;
+    size_t d_size;
+    size_t r_size;
+    size_t d_step;              /* decimated pixels between domain origins, r_size when they tile */
+    size_t rangeCols;
+    size_t rangeRows;
+    rangeTransform* transforms;
+
+    size_t rangesSearched;      /* given a full domain search, fewer for sequence frames */
+
+    /* diagnostics from the GL engine */
+    double culledFraction;      /* of domain blocks, over all ranges */
+    size_t fp16Mismatches;      /* ranges where fp16 and fp32 disagree */
+
+    /* from the int engine's coarse search, with coarseCheck */
+    size_t coarseMisses;        /* ranges where it missed the exhaustive search's domain */
+    double coarseExcessMSE;     /* its mean MSE over the exhaustive search's, per range */
+
+    size_t cacheHits;           /* ranges refit to a cached domain rather than searched */
+
+    /* from the int engine's spiral search */
+    size_t domainsExamined;     /* over all ranges searched */
+} fractureEncoding;
+
+/*
+ * NULL for block sizes fc can encode a w x h image with, or what is wrong
+ * with them; the encoders stop with that message otherwise
+ */
+const char* checkFractureBlockSizes(const fractureContext* fc,
+    size_t w, size_t h, size_t d_size, size_t r_size);
+
+/*
+ * With fixedParents, each range takes the domain block enclosing it, or
+ * the best of its neighbours within parentRadius, and only s and o are
+ * fitted, so encoding is linear in the number of pixels.
+ *
+ * With a budget, encoding is anytime: every range first gets the best
+ * domain near its own position, then ranges are searched in full, worst
+ * fit first, until the budget is spent. The gl engine searches on the
+ * GPU and the others with the int kernels.
+ */
+fractureEncoding* fractureEncode(fractureContext* fc,
+    const uint8_t* pixels, size_t w, size_t h, size_t stride,
+    size_t d_size, size_t r_size);
+
+/*
+ * Encodes one image at several block sizes, such as SD and HD, into
+ * encs[k] for d_sizes[k] and r_sizes[k], exactly as fractureEncode would.
+ * With the gl engine the image is uploaded, painted and squared once and
+ * every level's block sums are reduced from the same pyramid, so the
+ * levels need the same d_size / r_size. Other engines, fixed parents and
+ * budgets encode the levels one after another.
+ */
+void fractureEncodeLevels(fractureContext* fc,
+    const uint8_t* pixels, size_t w, size_t h, size_t stride,
+    const size_t* d_sizes, const size_t* r_sizes, size_t count,
+    fractureEncoding** encs);
+void releaseFractureEncoding(fractureEncoding* enc);
+
+/*
+ * Frame sequences keep the previous frame and its transforms. A range
+ * block whose mean absolute difference from the previous frame is at most
+ * changeThreshold gray levels keeps its previous domain or a neighbour of
+ * it, refit to the new frame, and only the others get a full search, so
+ * the cost of a frame follows the motion in it. The first frame, and any
+ * frame of a different size, is searched in full. Needs block sizes the
+ * int engine supports, whatever the context's engine.
+ */
+typedef struct fractureSequence fractureSequence;
+
+fractureSequence* createFractureSequence(fractureContext* fc,
+    size_t d_size, size_t r_size,
+    float changeThreshold);
+void releaseFractureSequence(fractureSequence* seq);
+
+fractureEncoding* fractureEncodeFrame(fractureSequence* seq,
+    const uint8_t* pixels, size_t w, size_t h, size_t stride);
+
+/*
+ * Iterates the transforms from a flat gray image, enlarging by 2^magExp,
+ * and returns (w << magExp) x (h << magExp) 8-bit pixels. Contexts with a
+ * GL context (the gl and compute engines) decode on the GPU; fc may be
+ * NULL to decode on the CPU.
+ */
+uint8_t* fractureDecode(fractureContext* fc,
+    const fractureEncoding* enc,
+    size_t magExp, size_t iterations);
+
+/*
+ * fractureEncode then fractureDecode. With the gl engine the transforms
+ * are handed from the search to the decoder as a texture and never leave
+ * the GPU; the fp16 check is not run. With fixed parents, the range
+ * cache or a budget the transforms go through the CPU.
+ */
+uint8_t* fractureEnlarge(fractureContext* fc,
+    const uint8_t* pixels, size_t w, size_t h, size_t stride,
+    size_t d_size, size_t r_size,
+    size_t magExp, size_t iterations);
+
+/*
+ * the .trn text format shared with test/fpimage.py; a malformed file
+ * reads as NULL with a message in *failure
+ */
+void writeFractureEncoding(FILE* f, const fractureEncoding* enc);
+fractureEncoding* readFractureEncoding(FILE* f, const char** failure);
+
+#endif
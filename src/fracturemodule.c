@@ -0,0 +1,578 @@
+#include <Python.h>
+#include <pthread.h>
+#include <string.h>
+
+#include "imageio.h"
+#include "fracture.h"
+
+/*
+ * Python bindings for libfracture, a drop-in for encode and decode in
+ * test/fpimage.py:
+ *
+ *   ctx = fracture.Context(engine='gl', precision='fp32', cull=0.0, backend=None)
+ *   transformList = ctx.encode(image, d_size, r_size)
+ *   pixels = ctx.decode(transformList, magExp=0, iterations=10)
+ *
+ * or fracture.encode and fracture.decode on a shared default context.
+ * image is a .png, .pgm or .raw path (see imageio.h) or any 2D buffer (numpy array) of 8-bit samples, read
+ * in place when its rows are contiguous, or of floats in [0, 1], or a
+ * 3D [y, x, channel] buffer whose first channel is used, like fpimage.
+ * transformList is fpimage's (orig_w, orig_h, d_size, r_size, transforms)
+ * and decode returns a Pixels buffer that numpy.asarray wraps without a
+ * copy. The GIL is released while a context works.
+ */
+
+#if PY_MAJOR_VERSION >= 3
+#define NEWBUFFER_FLAGS 0
+#else
+#define NEWBUFFER_FLAGS Py_TPFLAGS_HAVE_NEWBUFFER
+#endif
+
+/* decoded pixels, owned here and exported as a [y, x] uint8 buffer */
+typedef struct {
+    PyObject_HEAD
+    uint8_t* data;
+    Py_ssize_t shape[2];
+    Py_ssize_t strides[2];
+} PixelsObject;
+
+static void Pixels_dealloc(PixelsObject* self)
+{
+    free(self->data);
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static int Pixels_getbuffer(PixelsObject* self, Py_buffer* view, int flags)
+{
+    view->buf = self->data;
+    view->obj = (PyObject*)self;
+    Py_INCREF(self);
+    view->len = self->shape[0] * self->shape[1];
+    view->readonly = 0;
+    view->itemsize = 1;
+    view->format = (flags & PyBUF_FORMAT) ? "B" : NULL;
+    view->ndim = 2;
+    view->shape = (flags & PyBUF_ND) ? self->shape : NULL;
+    view->strides = (flags & PyBUF_STRIDES) ? self->strides : NULL;
+    view->suboffsets = NULL;
+    view->internal = NULL;
+    
+    return 0;
+}
+
+static PyBufferProcs Pixels_as_buffer = {
+#if PY_MAJOR_VERSION < 3
+    0, 0, 0, 0,
+#endif
+    (getbufferproc)Pixels_getbuffer,
+    0
+};
+
+static PyTypeObject PixelsType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "fracture.Pixels",
+    sizeof(PixelsObject),
+};
+
+static PyObject* createPixels(uint8_t* data, size_t w, size_t h)
+{
+    PixelsObject* p = PyObject_New(PixelsObject, &PixelsType);
+    if (p == NULL)
+    {
+        free(data);
+        return NULL;
+    }
+    p->data = data;
+    p->shape[0] = h;
+    p->shape[1] = w;
+    p->strides[0] = w;
+    p->strides[1] = 1;
+    
+    return (PyObject*)p;
+}
+
+typedef struct {
+    PyObject_HEAD
+    fractureContext* fc;
+    pthread_mutex_t lock;       /* the GIL is released while fc works */
+} ContextObject;
+
+static int parseChoice(const char* name, const char* value, const char** choices, int numChoices)
+{
+    int i;
+    for (i = 0; i < numChoices; i++)
+    {
+        if (strcmp(choices[i], value) == 0)
+        {
+            return i;
+        }
+    }
+    PyErr_Format(PyExc_ValueError, "bad %s: %s", name, value);
+    
+    return -1;
+}
+
+static int Context_init(ContextObject* self, PyObject* args, PyObject* kwds)
+{
+    static char* kwlist[] = { "engine", "precision", "cull", "backend", NULL };
+    static const char* engines[] = { "gl", "int", "gemm", "compute" };
+    static const char* precisions[] = { "fp32", "fp16", "fp16check" };
+    const char* engine = "gl";
+    const char* precision = "fp32";
+    float cull = 0.0f;
+    const char* backend = NULL;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|ssfz", kwlist, &engine, &precision, &cull, &backend))
+    {
+        return -1;
+    }
+    
+    fractureOptions opts;
+    initFractureOptions(&opts);
+    /* engine and precision numbers are the indices above */
+    opts.engine = parseChoice("engine", engine, engines, 4);
+    opts.precision = parseChoice("precision", precision, precisions, 3);
+    if (opts.engine < 0 || opts.precision < 0)
+    {
+        return -1;
+    }
+    if (cull < 0.0f)
+    {
+        PyErr_SetString(PyExc_ValueError, "cull must not be negative");
+        return -1;
+    }
+    opts.cullRMS = cull;
+    opts.backend = backend;            /* only read while creating the context */
+    
+    if (self->fc != NULL)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "Context already initialized");
+        return -1;
+    }
+    const char* failure;
+    Py_BEGIN_ALLOW_THREADS
+    self->fc = createFractureContext(&opts, &failure);
+    Py_END_ALLOW_THREADS
+    if (self->fc == NULL)
+    {
+        PyErr_SetString(PyExc_RuntimeError, failure);
+        return -1;
+    }
+    pthread_mutex_init(&self->lock, NULL);
+    
+    return 0;
+}
+
+static void Context_dealloc(ContextObject* self)
+{
+    if (self->fc != NULL)
+    {
+        releaseFractureContext(self->fc);
+        pthread_mutex_destroy(&self->lock);
+    }
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+/*
+ * 8-bit samples of an image argument: a file loaded into *file, the
+ * buffer itself when it already is 8-bit with contiguous rows, or else
+ * a converted copy in *copy
+ */
+static const uint8_t* getImageBytes(PyObject* image, grayImage** file, Py_buffer* view, uint8_t** copy,
+    size_t* w, size_t* h, size_t* stride)
+{
+    *file = NULL;
+    *copy = NULL;
+    view->obj = NULL;
+    
+    if (PyUnicode_Check(image) || PyBytes_Check(image))
+    {
+        PyObject* pathBytes = PyUnicode_Check(image) ? PyUnicode_AsUTF8String(image) : (Py_INCREF(image), image);
+        if (pathBytes == NULL)
+        {
+            return NULL;
+        }
+        FILE* f = fopen(PyBytes_AsString(pathBytes), "rb");
+        if (f == NULL)
+        {
+            PyErr_SetFromErrnoWithFilenameObject(PyExc_IOError, image);
+            Py_DECREF(pathBytes);
+            return NULL;
+        }
+        fclose(f);
+        
+        /* the file opens, so what is left to fail is its contents */
+        const char* failure;
+        *file = loadGrayImage(PyBytes_AsString(pathBytes), &failure);
+        if (*file == NULL)
+        {
+            PyErr_Format(PyExc_ValueError, "%s: %s", failure, PyBytes_AsString(pathBytes));
+            Py_DECREF(pathBytes);
+            return NULL;
+        }
+        *w = (*file)->w;
+        *h = (*file)->h;
+        *stride = (*file)->stride;
+        Py_DECREF(pathBytes);
+        return (*file)->data;
+    }
+    
+    if (PyObject_GetBuffer(image, view, PyBUF_STRIDES | PyBUF_FORMAT) == -1)
+    {
+        return NULL;
+    }
+    const char* format = view->format != NULL ? view->format : "B";
+    if (format[0] == '<' || format[0] == '=' || format[0] == '@')
+    {
+        format++;
+    }
+    if ((view->ndim != 2 && view->ndim != 3) ||
+        (strcmp("B", format) != 0 && strcmp("f", format) != 0 && strcmp("d", format) != 0))
+    {
+        PyErr_SetString(PyExc_TypeError, "image must be a 2D or 3D buffer of uint8, float32 or float64");
+        PyBuffer_Release(view);
+        return NULL;
+    }
+    *h = view->shape[0];
+    *w = view->shape[1];
+    
+    if (view->ndim == 2 && format[0] == 'B' && view->strides[1] == 1 && view->strides[0] > 0)
+    {
+        *stride = view->strides[0];
+        return view->buf;
+    }
+    
+    *copy = malloc(*w * *h);
+    *stride = *w;
+    size_t x, y;
+    for (y = 0; y < *h; y++)
+    {
+        for (x = 0; x < *w; x++)
+        {
+            const char* sample = (const char*)view->buf + y * view->strides[0] + x * view->strides[1];
+            double v;
+            if      (format[0] == 'B') v = *(const uint8_t*)sample / 255.0;
+            else if (format[0] == 'f') v = *(const float*)sample;
+            else                       v = *(const double*)sample;
+            v = v < 0.0 ? 0.0 : (v > 1.0 ? 1.0 : v);
+            (*copy)[y * *w + x] = (uint8_t)(v * 255.0 + 0.5);
+        }
+    }
+    
+    return *copy;
+}
+
+static PyObject* createTransformList(const fractureEncoding* enc)
+{
+    PyObject* transforms = PyList_New(enc->rangeCols * enc->rangeRows);
+    if (transforms == NULL)
+    {
+        return NULL;
+    }
+    size_t originStep = enc->d_step * (enc->d_size / enc->r_size);
+    size_t r_i, r_j;
+    for (r_j = 0; r_j < enc->rangeRows; r_j++)
+    {
+        for (r_i = 0; r_i < enc->rangeCols; r_i++)
+        {
+            size_t r = r_j * enc->rangeCols + r_i;
+            const rangeTransform* t = &enc->transforms[r];
+            /* a fifth element, the isometry, only where it is not the identity, as in .trn files */
+            PyObject* item = Py_BuildValue(t->iso != 0 ? "((nnnn)dd(nnnn)i)" : "((nnnn)dd(nnnn))",
+                (Py_ssize_t)(r_i * enc->r_size), (Py_ssize_t)((r_i + 1) * enc->r_size),
+                (Py_ssize_t)(r_j * enc->r_size), (Py_ssize_t)((r_j + 1) * enc->r_size),
+                (double)t->o, (double)t->s,
+                (Py_ssize_t)(t->d_i * originStep), (Py_ssize_t)(t->d_i * originStep + enc->d_size),
+                (Py_ssize_t)(t->d_j * originStep), (Py_ssize_t)(t->d_j * originStep + enc->d_size),
+                t->iso);
+            if (item == NULL)
+            {
+                Py_DECREF(transforms);
+                return NULL;
+            }
+            PyList_SET_ITEM(transforms, r, item);
+        }
+    }
+    
+    return Py_BuildValue("(nnnnN)",
+        (Py_ssize_t)enc->w, (Py_ssize_t)enc->h,
+        (Py_ssize_t)enc->d_size, (Py_ssize_t)enc->r_size, transforms);
+}
+
+/* the inverse, checking everything the decoder would otherwise trust */
+static fractureEncoding* createEncodingFromTransformList(PyObject* transformList)
+{
+    Py_ssize_t w, h, d_size, r_size;
+    PyObject* transforms;
+    if (!PyArg_ParseTuple(transformList, "nnnnO;transform list must be (orig_w, orig_h, d_size, r_size, transforms)",
+        &w, &h, &d_size, &r_size, &transforms))
+    {
+        return NULL;
+    }
+    if (r_size <= 0 || d_size < r_size || d_size % r_size != 0 || ((d_size / r_size) & (d_size / r_size - 1)) != 0 ||
+        w < d_size || h < d_size)
+    {
+        PyErr_SetString(PyExc_ValueError, "bad sizes in transform list");
+        return NULL;
+    }
+    PyObject* seq = PySequence_Fast(transforms, "transforms must be a sequence");
+    if (seq == NULL)
+    {
+        return NULL;
+    }
+    
+    fractureEncoding* enc = calloc(1, sizeof(fractureEncoding));
+    enc->w = w;
+    enc->h = h;
+    enc->d_size = d_size;
+    enc->r_size = r_size;
+    enc->d_step = 1; /* domains at any decimated pixel, as readFractureEncoding */
+    enc->rangeCols = w / r_size;
+    enc->rangeRows = h / r_size;
+    enc->transforms = calloc(enc->rangeCols * enc->rangeRows, sizeof(rangeTransform));
+    
+    Py_ssize_t k;
+    for (k = 0; k < PySequence_Fast_GET_SIZE(seq); k++)
+    {
+        Py_ssize_t rx1, rx2, ry1, ry2, dx1, dx2, dy1, dy2;
+        double o, s;
+        int iso = 0;
+        if (!PyArg_ParseTuple(PySequence_Fast_GET_ITEM(seq, k), "(nnnn)dd(nnnn)|i;transform must be (rs, o, s, ds[, iso])",
+            &rx1, &rx2, &ry1, &ry2, &o, &s, &dx1, &dx2, &dy1, &dy2, &iso))
+        {
+            break;
+        }
+        size_t r_i = rx1 / r_size;
+        size_t r_j = ry1 / r_size;
+        Py_ssize_t scale = d_size / r_size;
+        size_t d_i = dx1 / scale;
+        size_t d_j = dy1 / scale;
+        if (rx1 < 0 || ry1 < 0 || dx1 < 0 || dy1 < 0 ||
+            r_i >= enc->rangeCols || r_j >= enc->rangeRows ||
+            dx1 % scale != 0 || dy1 % scale != 0 ||
+            dx1 + d_size > w || dy1 + d_size > h)
+        {
+            PyErr_SetString(PyExc_ValueError, "transform outside the image");
+            break;
+        }
+        if (iso < 0 || iso >= NUM_ISOMETRIES)
+        {
+            PyErr_SetString(PyExc_ValueError, "bad isometry");
+            break;
+        }
+        rangeTransform* t = &enc->transforms[r_j * enc->rangeCols + r_i];
+        t->o = o;
+        t->s = s;
+        t->d_i = d_i;
+        t->d_j = d_j;
+        t->iso = iso;
+    }
+    Py_DECREF(seq);
+    
+    if (PyErr_Occurred())
+    {
+        releaseFractureEncoding(enc);
+        return NULL;
+    }
+    
+    return enc;
+}
+
+static PyObject* Context_encode(ContextObject* self, PyObject* args)
+{
+    if (self->fc == NULL)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "Context not initialized");
+        return NULL;
+    }
+    PyObject* image;
+    Py_ssize_t d_size, r_size;
+    if (!PyArg_ParseTuple(args, "Onn", &image, &d_size, &r_size))
+    {
+        return NULL;
+    }
+    if (d_size <= 0 || r_size <= 0)
+    {
+        PyErr_SetString(PyExc_ValueError, "d_size must be r_size times a power of two");
+        return NULL;
+    }
+    
+    grayImage* file;
+    Py_buffer view;
+    uint8_t* copy;
+    size_t w, h, stride;
+    const uint8_t* pixels = getImageBytes(image, &file, &view, &copy, &w, &h, &stride);
+    if (pixels == NULL)
+    {
+        return NULL;
+    }
+    
+    fractureEncoding* enc = NULL;
+    const char* failure = checkFractureBlockSizes(self->fc, w, h, d_size, r_size);
+    if (failure != NULL)
+    {
+        PyErr_SetString(PyExc_ValueError, failure);
+    }
+    else
+    {
+        Py_BEGIN_ALLOW_THREADS
+        pthread_mutex_lock(&self->lock);
+        enc = fractureEncode(self->fc, pixels, w, h, stride, d_size, r_size);
+        pthread_mutex_unlock(&self->lock);
+        Py_END_ALLOW_THREADS
+    }
+    
+    free(copy);
+    if (file != NULL)
+    {
+        releaseGrayImage(file);
+    }
+    if (view.obj != NULL)
+    {
+        PyBuffer_Release(&view);
+    }
+    if (enc == NULL)
+    {
+        return NULL;
+    }
+    
+    PyObject* transformList = createTransformList(enc);
+    releaseFractureEncoding(enc);
+    
+    return transformList;
+}
+
+static PyObject* Context_decode(ContextObject* self, PyObject* args, PyObject* kwds)
+{
+    if (self->fc == NULL)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "Context not initialized");
+        return NULL;
+    }
+    static char* kwlist[] = { "transformList", "magExp", "iterations", NULL };
+    PyObject* transformList;
+    Py_ssize_t magExp = 0;
+    Py_ssize_t iterations = 10;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|nn", kwlist, &transformList, &magExp, &iterations))
+    {
+        return NULL;
+    }
+    if (magExp < 0 || magExp > 8 || iterations < 0)
+    {
+        PyErr_SetString(PyExc_ValueError, "bad magExp or iterations");
+        return NULL;
+    }
+    
+    fractureEncoding* enc = createEncodingFromTransformList(transformList);
+    if (enc == NULL)
+    {
+        return NULL;
+    }
+    
+    uint8_t* pixels;
+    Py_BEGIN_ALLOW_THREADS
+    pthread_mutex_lock(&self->lock);
+    pixels = fractureDecode(self->fc, enc, magExp, iterations);
+    pthread_mutex_unlock(&self->lock);
+    Py_END_ALLOW_THREADS
+    
+    PyObject* result = createPixels(pixels, enc->w << magExp, enc->h << magExp);
+    releaseFractureEncoding(enc);
+    
+    return result;
+}
+
+static PyMethodDef Context_methods[] = {
+    { "encode", (PyCFunction)Context_encode, METH_VARARGS,
+      "encode(image, d_size, r_size) -> (orig_w, orig_h, d_size, r_size, transforms)" },
+    { "decode", (PyCFunction)Context_decode, METH_VARARGS | METH_KEYWORDS,
+      "decode(transformList, magExp=0, iterations=10) -> Pixels" },
+    { NULL }
+};
+
+static PyTypeObject ContextType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "fracture.Context",
+    sizeof(ContextObject),
+};
+
+static PyObject* defaultContext = NULL;
+
+static PyObject* getDefaultContext(void)
+{
+    if (defaultContext == NULL)
+    {
+        defaultContext = PyObject_CallObject((PyObject*)&ContextType, NULL);
+    }
+    return defaultContext;
+}
+
+static PyObject* fracture_encode(PyObject* module, PyObject* args)
+{
+    PyObject* ctx = getDefaultContext();
+    return ctx != NULL ? Context_encode((ContextObject*)ctx, args) : NULL;
+}
+
+static PyObject* fracture_decode(PyObject* module, PyObject* args, PyObject* kwds)
+{
+    PyObject* ctx = getDefaultContext();
+    return ctx != NULL ? Context_decode((ContextObject*)ctx, args, kwds) : NULL;
+}
+
+static PyMethodDef fracture_methods[] = {
+    { "encode", (PyCFunction)fracture_encode, METH_VARARGS,
+      "encode(image, d_size, r_size) on the default GL context" },
+    { "decode", (PyCFunction)fracture_decode, METH_VARARGS | METH_KEYWORDS,
+      "decode(transformList, magExp=0, iterations=10) on the default GL context" },
+    { NULL }
+};
+
+static PyObject* initModule(void)
+{
+    PixelsType.tp_dealloc = (destructor)Pixels_dealloc;
+    PixelsType.tp_as_buffer = &Pixels_as_buffer;
+    PixelsType.tp_flags = Py_TPFLAGS_DEFAULT | NEWBUFFER_FLAGS;
+    PixelsType.tp_doc = "decoded 8-bit pixels, a [y, x] buffer";
+    
+    ContextType.tp_dealloc = (destructor)Context_dealloc;
+    ContextType.tp_flags = Py_TPFLAGS_DEFAULT;
+    ContextType.tp_doc = "Context(engine='gl', precision='fp32', cull=0.0, backend=None)";
+    ContextType.tp_methods = Context_methods;
+    ContextType.tp_init = (initproc)Context_init;
+    ContextType.tp_new = PyType_GenericNew;
+    
+    if (PyType_Ready(&PixelsType) < 0 || PyType_Ready(&ContextType) < 0)
+    {
+        return NULL;
+    }
+    
+#if PY_MAJOR_VERSION >= 3
+    static struct PyModuleDef moduleDef = {
+        PyModuleDef_HEAD_INIT, "fracture", "native fractal image encoder", -1, fracture_methods
+    };
+    PyObject* module = PyModule_Create(&moduleDef);
+#else
+    PyObject* module = Py_InitModule3("fracture", fracture_methods, "native fractal image encoder");
+#endif
+    if (module == NULL)
+    {
+        return NULL;
+    }
+    Py_INCREF(&PixelsType);
+    PyModule_AddObject(module, "Pixels", (PyObject*)&PixelsType);
+    Py_INCREF(&ContextType);
+    PyModule_AddObject(module, "Context", (PyObject*)&ContextType);
+    
+    return module;
+}
+
+#if PY_MAJOR_VERSION >= 3
+PyMODINIT_FUNC PyInit_fracture(void)
+{
+    return initModule();
+}
+#else
+PyMODINIT_FUNC initfracture(void)
+{
+    initModule();
+}
+#endif
@@ -0,0 +1,206 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+/* the FMA micro-kernel is built whatever the compiler flags and chosen at run time */
+#define GEMMENC_FMA
+#endif
+
+#include "errors.h"
+
+#include "gemmenc.h"
+
+static float* allocPanels(size_t count)
+{
+    void* p;
+    if (posix_memalign(&p, 64, count * sizeof(float)) != 0)
+    {
+        ERR("posix_memalign() failed", "");
+    }
+    memset(p, 0, count * sizeof(float));
+    return (float*)p;
+}
+
+gemmEncodeData* createGEMMEncodeData(cpuEncodeData* ced)
+{
+    gemmEncodeData* ged = calloc(1, sizeof(gemmEncodeData));
+    size_t n = ced->n;
+    ged->n = n;
+    ged->rangeCols = ced->rangeCols;
+    ged->domainCols = ced->domainCols;
+    ged->numRanges = ced->rangeCols * ced->rangeRows;
+    ged->numDomains = ced->domainCols * ced->domainRows;
+    ged->rangePanels = (ged->numRanges + GEMM_MR - 1) / GEMM_MR;
+    ged->domainPanels = (ged->numDomains + GEMM_NR - 1) / GEMM_NR;
+    
+    ged->rangePanel = allocPanels(ged->rangePanels * GEMM_MR * n);
+    ged->domainPanel = allocPanels(ged->domainPanels * GEMM_NR * n);
+    ged->sumR = allocPanels(ged->rangePanels * GEMM_MR);
+    ged->sumR2 = allocPanels(ged->rangePanels * GEMM_MR);
+    ged->sumD = allocPanels(ged->domainPanels * GEMM_NR);
+    ged->sumD2 = allocPanels(ged->domainPanels * GEMM_NR);
+    
+    size_t b, k;
+    for (b = 0; b < ged->numRanges; b++)
+    {
+        const int16_t* block = ced->rangeBlocks + b * ced->nPad;
+        float* panel = ged->rangePanel + (b / GEMM_MR) * GEMM_MR * n;
+        for (k = 0; k < n; k++)
+        {
+            panel[k * GEMM_MR + b % GEMM_MR] = block[k] * ced->rScale;
+        }
+        ged->sumR[b] = ced->sumR[b] * ced->rScale;
+        ged->sumR2[b] = ced->sumR2[b] * ced->rScale * ced->rScale;
+    }
+    for (b = 0; b < ged->numDomains; b++)
+    {
+        const int16_t* block = ced->domainBlocks + b * ced->nPad;
+        float* panel = ged->domainPanel + (b / GEMM_NR) * GEMM_NR * n;
+        for (k = 0; k < n; k++)
+        {
+            panel[k * GEMM_NR + b % GEMM_NR] = block[k] * ced->dScale;
+        }
+        ged->sumD[b] = ced->sumD[b] * ced->dScale;
+        ged->sumD2[b] = ced->sumD2[b] * ced->dScale * ced->dScale;
+    }
+    
+    return ged;
+}
+
+void releaseGEMMEncodeData(gemmEncodeData* ged)
+{
+    free(ged->rangePanel);
+    free(ged->domainPanel);
+    free(ged->sumR);
+    free(ged->sumR2);
+    free(ged->sumD);
+    free(ged->sumD2);
+    free(ged);
+}
+
+typedef void (*gemmKernel)(size_t n,
+    const float* A, const float* B,
+    float C[GEMM_MR][GEMM_NR]);
+
+#if defined(GEMMENC_FMA)
+/* C[MR][NR] = A^T B for one range panel and one domain panel */
+__attribute__((target("avx2,fma")))
+static void gemmMicroKernelFMA(size_t n,
+    const float* A, const float* B,
+    float C[GEMM_MR][GEMM_NR])
+{
+    size_t k;
+    __m256 c00 = _mm256_setzero_ps(), c01 = _mm256_setzero_ps();
+    __m256 c10 = _mm256_setzero_ps(), c11 = _mm256_setzero_ps();
+    __m256 c20 = _mm256_setzero_ps(), c21 = _mm256_setzero_ps();
+    __m256 c30 = _mm256_setzero_ps(), c31 = _mm256_setzero_ps();
+    for (k = 0; k < n; k++)
+    {
+        __m256 b0 = _mm256_load_ps(B + k * GEMM_NR);
+        __m256 b1 = _mm256_load_ps(B + k * GEMM_NR + 8);
+        __m256 a;
+        a = _mm256_broadcast_ss(A + k * GEMM_MR + 0);
+        c00 = _mm256_fmadd_ps(a, b0, c00);
+        c01 = _mm256_fmadd_ps(a, b1, c01);
+        a = _mm256_broadcast_ss(A + k * GEMM_MR + 1);
+        c10 = _mm256_fmadd_ps(a, b0, c10);
+        c11 = _mm256_fmadd_ps(a, b1, c11);
+        a = _mm256_broadcast_ss(A + k * GEMM_MR + 2);
+        c20 = _mm256_fmadd_ps(a, b0, c20);
+        c21 = _mm256_fmadd_ps(a, b1, c21);
+        a = _mm256_broadcast_ss(A + k * GEMM_MR + 3);
+        c30 = _mm256_fmadd_ps(a, b0, c30);
+        c31 = _mm256_fmadd_ps(a, b1, c31);
+    }
+    _mm256_storeu_ps(C[0], c00);
+    _mm256_storeu_ps(C[0] + 8, c01);
+    _mm256_storeu_ps(C[1], c10);
+    _mm256_storeu_ps(C[1] + 8, c11);
+    _mm256_storeu_ps(C[2], c20);
+    _mm256_storeu_ps(C[2] + 8, c21);
+    _mm256_storeu_ps(C[3], c30);
+    _mm256_storeu_ps(C[3] + 8, c31);
+}
+#endif
+
+/* the same in plain C, which the compiler vectorizes for the baseline ISA */
+static void gemmMicroKernel(size_t n,
+    const float* A, const float* B,
+    float C[GEMM_MR][GEMM_NR])
+{
+    size_t i, j, k;
+    float acc[GEMM_MR][GEMM_NR];
+    memset(acc, 0, sizeof(acc));
+    for (k = 0; k < n; k++)
+    {
+        for (i = 0; i < GEMM_MR; i++)
+        {
+            float a = A[k * GEMM_MR + i];
+            for (j = 0; j < GEMM_NR; j++)
+            {
+                acc[i][j] += a * B[k * GEMM_NR + j];
+            }
+        }
+    }
+    memcpy(C, acc, sizeof(acc));
+}
+
+void gemmSearchAll(gemmEncodeData* ged, rangeTransform* transforms)
+{
+    size_t n = ged->n;
+    size_t panelsPerBlock = GEMM_NC / GEMM_NR;
+    float C[GEMM_MR][GEMM_NR];
+    rangeTransform t;
+    size_t db, rp, dp, i, j;
+    
+    gemmKernel kernel = gemmMicroKernel;
+#if defined(GEMMENC_FMA)
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    {
+        kernel = gemmMicroKernelFMA;
+    }
+#endif
+    
+    for (db = 0; db < ged->domainPanels; db += panelsPerBlock)
+    {
+        size_t dpEnd = db + panelsPerBlock < ged->domainPanels ? db + panelsPerBlock : ged->domainPanels;
+        for (rp = 0; rp < ged->rangePanels; rp++)
+        {
+            const float* A = ged->rangePanel + rp * GEMM_MR * n;
+            for (dp = db; dp < dpEnd; dp++)
+            {
+                kernel(n, A, ged->domainPanel + dp * GEMM_NR * n, C);
+                
+                for (i = 0; i < GEMM_MR; i++)
+                {
+                    size_t r = rp * GEMM_MR + i;
+                    if (r >= ged->numRanges)
+                    {
+                        break;
+                    }
+                    for (j = 0; j < GEMM_NR; j++)
+                    {
+                        size_t d = dp * GEMM_NR + j;
+                        if (d >= ged->numDomains)
+                        {
+                            break;
+                        }
+                        fitSO(n,
+                            ged->sumD[d], ged->sumD2[d], C[i][j],
+                            ged->sumR[r], ged->sumR2[r],
+                            &t);
+                        t.d_i = d % ged->domainCols;
+                        t.d_j = d / ged->domainCols;
+                        t.iso = 0;
+                        if (d == 0 || betterTransform(&t, &transforms[r]))
+                        {
+                            transforms[r] = t;
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,45 @@
+#ifndef GEMMENC_H
+#define GEMMENC_H
+
+#include <stdlib.h>
+
+#include "transform.h"
+#include "cpuenc.h"
+
+/*
+ * all-pairs CPU encoder
+ *
+ * sumDr for every range against every domain is the product of a
+ * (ranges x n) matrix with an (n x domains) matrix. Range blocks are packed
+ * into panels of GEMM_MR, domain blocks into panels of GEMM_NR, both stored
+ * k-major, and a register-tiled micro-kernel produces one GEMM_MR x GEMM_NR
+ * tile of inner products at a time. Each tile is fitted and folded into the
+ * per-range argmin immediately, so the score matrix never exists in memory.
+ */
+
+#define GEMM_MR 4
+#define GEMM_NR 16
+#define GEMM_NC 512 /* domains per cache block */
+
+typedef struct gemmEncodeData {
+    size_t n;
+    size_t numRanges;
+    size_t numDomains;
+    size_t rangeCols;
+    size_t domainCols;
+    size_t rangePanels;
+    size_t domainPanels;
+    float* rangePanel;  /* [panel][k][GEMM_MR] */
+    float* domainPanel; /* [panel][k][GEMM_NR] */
+    float* sumR;
+    float* sumR2;
+    float* sumD;
+    float* sumD2;
+} gemmEncodeData;
+
+gemmEncodeData* createGEMMEncodeData(cpuEncodeData* ced);
+void releaseGEMMEncodeData(gemmEncodeData* ged);
+
+void gemmSearchAll(gemmEncodeData* ged, rangeTransform* transforms);
+
+#endif
@@ -0,0 +1,74 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "errors.h"
+#include "glcontext.h"
+
+static glContextObj createCGLContext(const char** failure)
+{
+    CGLContextObj cgl_ctx;
+    CGLPixelFormatAttribute attribs[] = {
+        kCGLPFAAccelerated,
+        kCGLPFAPBuffer, // bypasses default of window drawable. use kCGLPFARemotePBuffer if this fails on remote session
+        kCGLPFANoRecovery, // disables software fallback
+        0
+    };
+    CGLPixelFormatObj pxlFmt;
+    GLint numPxlFmts;
+    if (CGLChoosePixelFormat(attribs, &pxlFmt, &numPxlFmts) != kCGLNoError || pxlFmt == NULL)
+    {
+        *failure = "no accelerated pixel format";
+        return NULL;
+    }
+    //dumpPixFmt(cgl_ctx, pxlFmt);
+    CGLError error = CGLCreateContext(pxlFmt, NULL, &cgl_ctx);
+    CGLDestroyPixelFormat(pxlFmt);
+    if (error != kCGLNoError)
+    {
+        *failure = CGLErrorString(error);
+        return NULL;
+    }
+    CHK_CGL(CGLSetCurrentContext(cgl_ctx));
+    
+    return cgl_ctx;
+}
+
+static void makeCGLContextCurrent(glContextObj cgl_ctx)
+{
+    CHK_CGL(CGLSetCurrentContext(cgl_ctx));
+}
+
+static void clearCGLContextCurrent(glContextObj cgl_ctx)
+{
+    CHK_CGL(CGLSetCurrentContext(NULL));
+}
+
+static void releaseCGLContext(glContextObj cgl_ctx)
+{
+    CHK_CGL(CGLSetCurrentContext(NULL));
+    CHK_CGL(CGLDestroyContext(cgl_ctx));
+}
+
+void expectGLErrors(glContextObj cgl_ctx, GLboolean expect)
+{
+    /* no debug callback under CGL, errors only surface through glGetError */
+}
+
+glBackend cglBackend = {
+    "cgl",
+    createCGLContext,
+    makeCGLContextCurrent,
+    clearCGLContextCurrent,
+    releaseCGLContext
+};
+
+glBackend* findGLBackend(const char* name)
+{
+    if (name == NULL || strcmp(name, cglBackend.name) == 0)
+    {
+        return &cglBackend;
+    }
+    
+    return NULL;
+}
@@ -0,0 +1,178 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include "errors.h"
+#include "glcontext.h"
+
+/*
+ * headless EGL: Mesa's surfaceless platform, or the first EGL device when
+ * that is unavailable. No window system or pbuffer is needed, since every
+ * pass renders into FBOs. Under Mesa, LIBGL_ALWAYS_SOFTWARE=1 selects the
+ * llvmpipe software rasterizer.
+ */
+
+struct glBackendContext {
+    EGLDisplay display;
+    EGLContext context;
+    GLboolean expectGLErrors;   /* read by the debug callback, from any thread */
+};
+
+static void checkEGLError(char* file, const char* func, unsigned long line, EGLBoolean success)
+{
+    if (!success)
+    {
+        char* detail;
+        asprintf(&detail, "0x%04x", eglGetError());
+        reportGenericError(file, func, line, "EGL error", detail);
+    }
+}
+#define CHK_EGL(fn) (checkEGLError(__FILE__, __func__, __LINE__, (fn)))
+
+/* every context shares the one display, which is terminated with the last of them */
+static pthread_mutex_t displayLock = PTHREAD_MUTEX_INITIALIZER;
+static int numDisplayContexts = 0;
+
+static EGLDisplay getHeadlessDisplay(const char** failure)
+{
+    PFNEGLGETPLATFORMDISPLAYEXTPROC eglGetPlatformDisplayEXT =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (eglGetPlatformDisplayEXT == NULL)
+    {
+        *failure = "EGL_EXT_platform_base not supported";
+        return EGL_NO_DISPLAY;
+    }
+    
+    EGLDisplay display = eglGetPlatformDisplayEXT(
+        EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    if (display != EGL_NO_DISPLAY)
+    {
+        return display;
+    }
+    
+    PFNEGLQUERYDEVICESEXTPROC eglQueryDevicesEXT =
+        (PFNEGLQUERYDEVICESEXTPROC)eglGetProcAddress("eglQueryDevicesEXT");
+    if (eglQueryDevicesEXT == NULL)
+    {
+        *failure = "no surfaceless platform and no EGL_EXT_device_enumeration";
+        return EGL_NO_DISPLAY;
+    }
+    EGLDeviceEXT device;
+    EGLint numDevices;
+    if (!eglQueryDevicesEXT(1, &device, &numDevices) || numDevices == 0)
+    {
+        *failure = "no EGL devices";
+        return EGL_NO_DISPLAY;
+    }
+    
+    display = eglGetPlatformDisplayEXT(EGL_PLATFORM_DEVICE_EXT, device, NULL);
+    if (display == EGL_NO_DISPLAY)
+    {
+        *failure = "no headless EGL display";
+    }
+    
+    return display;
+}
+
+static void releaseEGLDisplay(EGLDisplay display)
+{
+    pthread_mutex_lock(&displayLock);
+    if (--numDisplayContexts == 0)
+    {
+        CHK_EGL(eglTerminate(display));
+    }
+    pthread_mutex_unlock(&displayLock);
+}
+
+static glContextObj createEGLContext(const char** failure)
+{
+    EGLDisplay display = getHeadlessDisplay(failure);
+    if (display == EGL_NO_DISPLAY)
+    {
+        return NULL;
+    }
+    pthread_mutex_lock(&displayLock);
+    EGLBoolean initialized = eglInitialize(display, NULL, NULL);
+    if (initialized)
+    {
+        numDisplayContexts++;
+    }
+    pthread_mutex_unlock(&displayLock);
+    if (!initialized)
+    {
+        *failure = "eglInitialize() failed";
+        return NULL;
+    }
+    if (!eglBindAPI(EGL_OPENGL_API))
+    {
+        *failure = "no desktop OpenGL under EGL";
+        releaseEGLDisplay(display);
+        return NULL;
+    }
+    
+    /* the shaders use the fixed-function builtins, so ask for a compatibility profile */
+    EGLint attribs[] = {
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT,
+        EGL_NONE
+    };
+    EGLContext context = eglCreateContext(display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, attribs);
+    if (context == EGL_NO_CONTEXT)
+    {
+        *failure = "eglCreateContext() failed";
+        releaseEGLDisplay(display);
+        return NULL;
+    }
+    
+    glContextObj cgl_ctx = calloc(1, sizeof(struct glBackendContext));
+    cgl_ctx->display = display;
+    cgl_ctx->context = context;
+    CHK_EGL(eglMakeCurrent(cgl_ctx->display, EGL_NO_SURFACE, EGL_NO_SURFACE, cgl_ctx->context));
+    installGLErrorCallback(cgl_ctx, &cgl_ctx->expectGLErrors);
+    
+    return cgl_ctx;
+}
+
+static void makeEGLContextCurrent(glContextObj cgl_ctx)
+{
+    CHK_EGL(eglMakeCurrent(cgl_ctx->display, EGL_NO_SURFACE, EGL_NO_SURFACE, cgl_ctx->context));
+}
+
+static void clearEGLContextCurrent(glContextObj cgl_ctx)
+{
+    CHK_EGL(eglMakeCurrent(cgl_ctx->display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT));
+}
+
+static void releaseEGLContext(glContextObj cgl_ctx)
+{
+    CHK_EGL(eglMakeCurrent(cgl_ctx->display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT));
+    CHK_EGL(eglDestroyContext(cgl_ctx->display, cgl_ctx->context));
+    releaseEGLDisplay(cgl_ctx->display);
+    free(cgl_ctx);
+}
+
+void expectGLErrors(glContextObj cgl_ctx, GLboolean expect)
+{
+    cgl_ctx->expectGLErrors = expect;
+}
+
+glBackend eglBackend = {
+    "egl",
+    createEGLContext,
+    makeEGLContextCurrent,
+    clearEGLContextCurrent,
+    releaseEGLContext
+};
+
+glBackend* findGLBackend(const char* name)
+{
+    if (name == NULL || strcmp(name, eglBackend.name) == 0)
+    {
+        return &eglBackend;
+    }
+    
+    return NULL;
+}
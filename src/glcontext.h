@@ -0,0 +1,46 @@
+#ifndef GLCONTEXT_H
+#define GLCONTEXT_H
+
+/*
+ * GL entry points and context creation for each platform
+ *
+ * Every function that issues GL calls takes a glContextObj named cgl_ctx.
+ * On Mac OS X that is a CGLContextObj and CGLMacro.h routes the calls
+ * through it; elsewhere GL calls go to the current context and cgl_ctx
+ * only carries the backend's own state.
+ */
+
+#ifdef __APPLE__
+#include <OpenGL/OpenGL.h>
+#include <OpenGL/CGLMacro.h>
+#include <OpenGL/glu.h>
+typedef CGLContextObj glContextObj;
+#else
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#include <GL/glext.h>
+#include <GL/glu.h>
+typedef struct glBackendContext* glContextObj;
+#endif
+
+typedef struct glBackend {
+    const char* name;
+    glContextObj (*createContext)(const char** failure);    /* NULL with a message when there is no GL */
+    void (*makeCurrent)(glContextObj cgl_ctx);     /* before using a context that may not be current */
+    void (*clearCurrent)(glContextObj cgl_ctx);    /* after, so another thread can make it current */
+    void (*releaseContext)(glContextObj cgl_ctx);
+} glBackend;
+
+#ifdef __APPLE__
+extern glBackend cglBackend;
+#else
+extern glBackend eglBackend;
+#endif
+
+/* set around calls that may fail on purpose, so the context's debug callback ignores them */
+void expectGLErrors(glContextObj cgl_ctx, GLboolean expect);
+
+/* the named backend, the platform's own for NULL, NULL for an unknown name */
+glBackend* findGLBackend(const char* name);
+
+#endif
@@ -0,0 +1,273 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "errors.h"
+#include "glio.h"
+#include "glenc.h"
+
+#include "gldec.h"
+
+#ifdef GL_ARB_draw_instanced
+
+glDecoder* createGLDecoder(glContextObj cgl_ctx)
+{
+    glDecoder* gd = calloc(1, sizeof(glDecoder));
+    gd->cgl_ctx = cgl_ctx;
+    gd->originXMult = 1;
+    
+    GLint maxSize;
+    glGetIntegerv(GL_MAX_RECTANGLE_TEXTURE_SIZE_ARB, &maxSize);
+    gd->maxSize = maxSize;
+    
+    glGenFramebuffersEXT(1, &gd->fbo);
+    CHK_OGL;
+    
+    /* the unit quad of every pass, T2F_V3F as in the encoder */
+    GLfloat vertexData[] = {
+        0.0, 0.0,
+        0.0, 0.0, 0.0,
+        
+        0.0, 1.0,
+        0.0, 1.0, 0.0,
+        
+        1.0, 1.0,
+        1.0, 1.0, 0.0,
+        
+        1.0, 0.0,
+        1.0, 0.0, 0.0
+    };
+    glGenBuffers(1, &gd->vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, gd->vbo);
+    glBufferData(GL_ARRAY_BUFFER, 4 * 5 * sizeof(GLfloat), vertexData, GL_STATIC_DRAW);
+    CHK_OGL;
+    
+    /* box filter for the decimated image */
+    gd->averageReductionShader.program = loadProgram(cgl_ctx, "common.vert", "averageReduction.frag");
+    GET_UNIFORM(gd->averageReductionShader, w);
+    GET_UNIFORM(gd->averageReductionShader, h);
+    GET_UNIFORM(gd->averageReductionShader, tex);
+    GET_UNIFORM(gd->averageReductionShader, blockSize);
+    CHK_OGL;
+    
+    /* instanced range quads */
+    gd->decodeShader.program = loadProgram(cgl_ctx, "decode.vert", "decode.frag");
+    GET_UNIFORM(gd->decodeShader, transform_tex);
+    GET_UNIFORM(gd->decodeShader, D_tex);
+    GET_UNIFORM(gd->decodeShader, rangeCols);
+    GET_UNIFORM(gd->decodeShader, originXMult);
+    GET_UNIFORM(gd->decodeShader, r_size);
+    GET_UNIFORM(gd->decodeShader, d_step);
+    GET_UNIFORM(gd->decodeShader, w);
+    GET_UNIFORM(gd->decodeShader, h);
+    CHK_OGL;
+    
+    return gd;
+}
+
+void releaseGLDecoder(glDecoder* gd)
+{
+    glContextObj cgl_ctx = gd->cgl_ctx;
+    
+    glDeleteFramebuffersEXT(1, &gd->fbo);
+    glDeleteBuffers(1, &gd->vbo);
+    glDeleteProgram(gd->averageReductionShader.program);
+    glDeleteProgram(gd->decodeShader.program);
+    CHK_OGL;
+    
+    free(gd);
+}
+
+texInfo* createTransformTexture(glDecoder* gd,
+    const rangeTransform* transforms,
+    size_t rangeCols, size_t rangeRows)
+{
+    glContextObj cgl_ctx = gd->cgl_ctx;
+    
+    size_t numRanges = rangeCols * rangeRows;
+    size_t r;
+    size_t maxD_i = 0;
+    size_t maxD_j = 0;
+    for (r = 0; r < numRanges; r++)
+    {
+        maxD_i = transforms[r].d_i > maxD_i ? transforms[r].d_i : maxD_i;
+        maxD_j = transforms[r].d_j > maxD_j ? transforms[r].d_j : maxD_j;
+    }
+    gd->originXMult = maxD_j + 1;
+    if ((double)(maxD_i + 1) * gd->originXMult > 16777216.0)
+    {
+        ERR("too many domains to pack their origins in a float", "");
+    }
+    
+    GLfloat* data = malloc(4 * numRanges * sizeof(GLfloat));
+    for (r = 0; r < numRanges; r++)
+    {
+        const rangeTransform* t = &transforms[r];
+        data[4 * r + 0] = t->iso;
+        data[4 * r + 1] = t->s;
+        data[4 * r + 2] = t->o;
+        data[4 * r + 3] = packOrigin(t->d_i, t->d_j, gd->originXMult);
+    }
+    
+    texInfo* transformsT = createEmptyTexture(cgl_ctx, floatTextureFormat(4), rangeCols, rangeRows);
+    glBindTexture(GL_TEXTURE_RECTANGLE_ARB, transformsT->tex);
+    glTexSubImage2D(
+        GL_TEXTURE_RECTANGLE_ARB, 0, 0, 0, rangeCols, rangeRows,
+        GL_RGBA, GL_FLOAT, data);
+    CHK_OGL;
+    transformsT->aW = rangeCols;
+    transformsT->aH = rangeRows;
+    transformsT->aC = 4;
+    
+    free(data);
+    
+    return transformsT;
+}
+
+static void attachTarget(glDecoder* gd,
+    texInfo* t)
+{
+    glContextObj cgl_ctx = gd->cgl_ctx;
+    
+    glFramebufferTexture2DEXT(
+        GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT0_EXT,
+        GL_TEXTURE_RECTANGLE_ARB, t->tex, 0);
+    glDrawBuffer(GL_COLOR_ATTACHMENT0_EXT);
+    framebufferConfig = t->format;
+    CHK_OGL;
+    CHK_FBO;
+    glViewport(0, 0, t->w, t->h);
+}
+
+GLfloat* decodeTransformTexture(glDecoder* gd,
+    texInfo* transformsT,
+    size_t w, size_t h, size_t d_size, size_t r_size, size_t d_step,
+    size_t magExp, size_t iterations)
+{
+    glContextObj cgl_ctx = gd->cgl_ctx;
+    
+    size_t W = w << magExp;
+    size_t H = h << magExp;
+    size_t blockSize = d_size / r_size;
+    if (W > gd->maxSize || H > gd->maxSize)
+    {
+        ERR("decoded image larger than the largest texture", "");
+    }
+    
+    /* the encoder's framebuffer and quad stay bound for its next pass */
+    GLint prevFBO, prevVBO;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING_EXT, &prevFBO);
+    glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &prevVBO);
+    glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, gd->fbo);
+    glBindBuffer(GL_ARRAY_BUFFER, gd->vbo);
+    glInterleavedArrays(GL_T2F_V3F, 0, 0);
+    CHK_OGL;
+    
+    /* uncovered edges are never drawn, so both keep the starting gray */
+    texInfo* R_T[2];
+    size_t i;
+    for (i = 0; i < 2; i++)
+    {
+        R_T[i] = createEmptyTexture(cgl_ctx, floatTextureFormat(1), W, H);
+        attachTarget(gd, R_T[i]);
+        glClearColor(0.5, 0.5, 0.5, 0.5);
+        glClear(GL_COLOR_BUFFER_BIT);
+    }
+    glClearColor(0.0, 0.0, 0.0, 0.0);
+    texInfo* D_T = createEmptyTexture(cgl_ctx, floatTextureFormat(1), W / blockSize, H / blockSize);
+    CHK_OGL;
+    
+    size_t iter;
+    for (iter = 0; iter < iterations; iter++)
+    {
+        texInfo* srcT = R_T[iter % 2];
+        texInfo* dstT = R_T[(iter + 1) % 2];
+        
+        glUseProgram(gd->averageReductionShader.program);
+        glUniform1i(gd->averageReductionShader.tex, 0 /* GL_TEXTURE0 */);
+        glUniform1f(gd->averageReductionShader.w, W);
+        glUniform1f(gd->averageReductionShader.h, H);
+        glUniform1f(gd->averageReductionShader.blockSize, blockSize);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_RECTANGLE_ARB, srcT->tex);
+        CHK_OGL;
+        
+        attachTarget(gd, D_T);
+        glDrawArrays(GL_QUADS, 0, 4);
+        CHK_OGL;
+        
+        glUseProgram(gd->decodeShader.program);
+        glUniform1i(gd->decodeShader.transform_tex, 0 /* GL_TEXTURE0 */);
+        glUniform1i(gd->decodeShader.D_tex, 1 /* GL_TEXTURE1 */);
+        glUniform1f(gd->decodeShader.rangeCols, transformsT->aW);
+        glUniform1f(gd->decodeShader.originXMult, gd->originXMult);
+        glUniform1f(gd->decodeShader.r_size, r_size << magExp);
+        glUniform1f(gd->decodeShader.d_step, d_step << magExp);
+        glUniform1f(gd->decodeShader.w, W);
+        glUniform1f(gd->decodeShader.h, H);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_RECTANGLE_ARB, transformsT->tex);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_RECTANGLE_ARB, D_T->tex);
+        CHK_OGL;
+        
+        attachTarget(gd, dstT);
+        glDrawArraysInstancedARB(GL_QUADS, 0, 4, transformsT->aW * transformsT->aH);
+        CHK_OGL;
+    }
+    
+    glFramebufferTexture2DEXT(
+        GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT0_EXT,
+        GL_TEXTURE_RECTANGLE_ARB, 0, 0);
+    
+    GLfloat* R = malloc(W * H * sizeof(GLfloat));
+    glBindTexture(GL_TEXTURE_RECTANGLE_ARB, R_T[iterations % 2]->tex);
+    glGetTexImage(
+        GL_TEXTURE_RECTANGLE_ARB, 0, GL_RED,
+        GL_FLOAT, R);
+    CHK_OGL;
+    
+    releaseTexture(cgl_ctx, R_T[0]);
+    releaseTexture(cgl_ctx, R_T[1]);
+    releaseTexture(cgl_ctx, D_T);
+    
+    glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, prevFBO);
+    glBindBuffer(GL_ARRAY_BUFFER, prevVBO);
+    if (prevVBO != 0)
+    {
+        glInterleavedArrays(GL_T2F_V3F, 0, 0);
+    }
+    CHK_OGL;
+    
+    return R;
+}
+
+#else
+
+glDecoder* createGLDecoder(glContextObj cgl_ctx)
+{
+    return NULL;
+}
+
+void releaseGLDecoder(glDecoder* gd)
+{
+}
+
+texInfo* createTransformTexture(glDecoder* gd,
+    const rangeTransform* transforms,
+    size_t rangeCols, size_t rangeRows)
+{
+    ERR("instanced drawing not supported by this OpenGL", "");
+    return NULL;
+}
+
+GLfloat* decodeTransformTexture(glDecoder* gd,
+    texInfo* transformsT,
+    size_t w, size_t h, size_t d_size, size_t r_size, size_t d_step,
+    size_t magExp, size_t iterations)
+{
+    ERR("instanced drawing not supported by this OpenGL", "");
+    return NULL;
+}
+
+#endif
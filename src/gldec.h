@@ -0,0 +1,75 @@
+#ifndef GLDEC_H
+#define GLDEC_H
+
+#include <stdlib.h>
+
+#include "glcontext.h"
+#include "glio.h"
+#include "transform.h"
+
+/*
+ * GL decoder
+ *
+ * Each iteration box-filters the previous one into a decimated image and
+ * draws every range as one instance of a quad, s * domain + o. Transforms
+ * are read by the vertex shader from a rangeCols x rangeRows RGBA32F
+ * texture laid out as the encoder's search results, (MSE, s, o, packed
+ * origin), so the encoder can hand its results over without a readback.
+ * Uploaded transforms carry their isometry in place of the MSE.
+ * Only available where the GL headers define instanced drawing.
+ */
+
+typedef struct averageReductionProgram {
+    GLuint program;
+    GLint w;
+    GLint h;
+    GLint tex;
+    GLint blockSize;
+} averageReductionProgram;
+
+typedef struct decodeProgram {
+    GLuint program;
+    GLint transform_tex;
+    GLint D_tex;
+    GLint rangeCols;
+    GLint originXMult;
+    GLint r_size;
+    GLint d_step;
+    GLint w;
+    GLint h;
+} decodeProgram;
+
+typedef struct glDecoder {
+    glContextObj cgl_ctx;
+    
+    /* packs domain origins as the encoder's calcSO does, see packOrigin */
+    int originXMult;
+    
+    /* largest decoded image side */
+    size_t maxSize;
+    
+    GLuint fbo;
+    GLuint vbo;
+    
+    averageReductionProgram averageReductionShader;
+    decodeProgram decodeShader;
+} glDecoder;
+
+glDecoder* createGLDecoder(glContextObj cgl_ctx);
+void releaseGLDecoder(glDecoder* gd);
+
+/* uploads transforms decoded on the CPU or read from a file */
+texInfo* createTransformTexture(glDecoder* gd,
+    const rangeTransform* transforms,
+    size_t rangeCols, size_t rangeRows);
+
+/*
+ * returns the decoded image, (w << magExp) x (h << magExp) floats; d_step
+ * is the encoding's, in decimated pixels between domain origins
+ */
+GLfloat* decodeTransformTexture(glDecoder* gd,
+    texInfo* transformsT,
+    size_t w, size_t h, size_t d_size, size_t r_size, size_t d_step,
+    size_t magExp, size_t iterations);
+
+#endif
@@ -0,0 +1,1219 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "glcontext.h"
+
+#include "errors.h"
+#include "glio.h"
+
+#include "glenc.h"
+
+GLenum scratchFormats[NUM_SCRATCH_FORMATS] = {
+    GL_R32F, GL_RG32F, GL_RGBA32F_ARB,
+    GL_R16F, GL_RG16F, GL_RGBA16F_ARB
+};
+
+/*
+ * function declarations
+ */
+
+int log2int(int x);
+
+GLenum storageTextureFormat(glEncoder* ge, size_t numChannels);
+
+void attachScratchTextures(glEncoder* ge,
+    GLenum format);
+
+void beginCulledPass(glEncoder* ge,
+    GLuint depthRenderbuffer);
+
+void endCulledPass(glEncoder* ge);
+
+texInfo* paint(glEncoder* ge,
+    texInfo* srcT,
+    size_t dstW, size_t dstH);
+
+texInfo* sumReduce(glEncoder* ge,
+    texInfo* srcT,
+    size_t times);
+
+texInfo* square(glEncoder* ge,
+    texInfo* srcT);
+
+texInfo* zipper(glEncoder* ge,
+    texInfo* rgT, texInfo* baT);
+
+texInfo* multiplyTiled(glEncoder* ge,
+    texInfo* D_T, texInfo* R_T,
+    size_t r_size, size_t r_x, size_t r_y);
+
+texInfo* calcSO(glEncoder* ge,
+    texInfo* sumD_sumD2_sumDr_T, texInfo* sumR_sumR2_T,
+    size_t n, size_t r_i, size_t r_j);
+
+texInfo* searchReduce(glEncoder* ge,
+    texInfo* srcT,
+    size_t times);
+
+GLfloat* createTupleFromPointTexture(glEncoder* ge,
+    texInfo* t);
+
+GLfloat* createRGBAFromTexture(glEncoder* ge,
+    texInfo* t);
+
+GLfloat* createCullDepths(glEncoder* ge,
+    encodeData* ed,
+    size_t r_size);
+
+/*
+ * function implementations
+ */
+
+int log2int(int x)
+{
+    if (x <= 0)
+    {
+        ERR("argument <= 0", "");
+    }
+    
+    int i = 0;
+    while ((x >> i) != 1)
+    {
+        i++;
+    }
+    
+    if (x != (1 << i))
+    {
+        i++;
+    }
+    
+    return i;
+}
+
+glEncoder* createGLEncoder(glContextObj cgl_ctx)
+{
+    glEncoder* ge = calloc(1, sizeof(glEncoder));
+    ge->cgl_ctx = cgl_ctx;
+    ge->originXMult = 1;
+    
+    /* context state */
+    glEnable(GL_TEXTURE_RECTANGLE_ARB);
+    CHK_OGL;
+    
+    /* framebuffer; attachments are sized per image by resizeGLEncoder */
+    glGenFramebuffersEXT(1, &ge->fbo);
+    glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, ge->fbo);
+    CHK_OGL;
+    
+    /* buffers for full screen quad */
+    // T2F_V3F: texture coordinates, then vertex position
+    GLfloat vertexData[] = {
+        0.0, 0.0,
+        0.0, 0.0, 0.0,
+        
+        0.0, 1.0,
+        0.0, 1.0, 0.0,
+        
+        1.0, 1.0,
+        1.0, 1.0, 0.0,
+        
+        1.0, 0.0,
+        1.0, 0.0, 0.0
+    };
+	glGenBuffers(1, &ge->vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, ge->vbo);
+    glBufferData(GL_ARRAY_BUFFER, 4 * 5 * sizeof(GLfloat), vertexData, GL_STATIC_DRAW);
+    CHK_OGL;
+    
+    GLuint indexData[] = {0, 1, 2, 3};
+	glGenBuffers(1, &ge->ibo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ge->ibo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, 4 * sizeof(GLuint), indexData, GL_STATIC_DRAW);
+    CHK_OGL;
+    
+    glInterleavedArrays(GL_T2F_V3F, 0, 0);
+    CHK_OGL;
+    
+    /* paint shader */
+    ge->paintShader.program = loadProgram(cgl_ctx, "common.vert", "paint.frag");
+    GET_UNIFORM(ge->paintShader, w);
+    GET_UNIFORM(ge->paintShader, h);
+    GET_UNIFORM(ge->paintShader, tex);
+    CHK_OGL;
+    
+    /* sum reduction shader */
+    ge->sumReductionShader.program = loadProgram(cgl_ctx, "common.vert", "sumReduction.frag");
+    GET_UNIFORM(ge->sumReductionShader, w);
+    GET_UNIFORM(ge->sumReductionShader, h);
+    GET_UNIFORM(ge->sumReductionShader, tex);
+    CHK_OGL;
+    
+    /* square shader */
+    ge->squareShader.program = loadProgram(cgl_ctx, "common.vert", "square.frag");
+    GET_UNIFORM(ge->squareShader, w);
+    GET_UNIFORM(ge->squareShader, h);
+    GET_UNIFORM(ge->squareShader, tex);
+    CHK_OGL;
+    
+    /* zipper shader */
+    ge->zipperShader.program = loadProgram(cgl_ctx, "common.vert", "zipper.frag");
+    GET_UNIFORM(ge->zipperShader, w);
+    GET_UNIFORM(ge->zipperShader, h);
+    GET_UNIFORM(ge->zipperShader, RG_tex);
+    GET_UNIFORM(ge->zipperShader, BA_tex);
+    CHK_OGL;
+    
+    /* multiply a repeated range block with each domain block */
+    ge->multiplyTiledShader.program = loadProgram(cgl_ctx, "common.vert", "multiplyTiled.frag");
+    GET_UNIFORM(ge->multiplyTiledShader, w);
+    GET_UNIFORM(ge->multiplyTiledShader, h);
+    GET_UNIFORM(ge->multiplyTiledShader, D_tex);
+    GET_UNIFORM(ge->multiplyTiledShader, R_tex);
+    GET_UNIFORM(ge->multiplyTiledShader, r_size);
+    GET_UNIFORM(ge->multiplyTiledShader, r_x);
+    GET_UNIFORM(ge->multiplyTiledShader, r_y);
+    CHK_OGL;
+    
+    /* shader to calculate scale and offset */
+    ge->calcSOShader.program = loadProgram(cgl_ctx, "common.vert", "calcSO.frag");
+    GET_UNIFORM(ge->calcSOShader, originXMult);
+    GET_UNIFORM(ge->calcSOShader, w);
+    GET_UNIFORM(ge->calcSOShader, h);
+    GET_UNIFORM(ge->calcSOShader, sumD_sumD2_sumDr_tex);
+    GET_UNIFORM(ge->calcSOShader, sumR_sumR2_tex);
+    GET_UNIFORM(ge->calcSOShader, n);
+    GET_UNIFORM(ge->calcSOShader, r_i);
+    GET_UNIFORM(ge->calcSOShader, r_j);
+    CHK_OGL;
+    
+    /* search reduction shader */
+    ge->searchReductionShader.program = loadProgram(cgl_ctx, "common.vert", "searchReduction.frag");
+    GET_UNIFORM(ge->searchReductionShader, w);
+    GET_UNIFORM(ge->searchReductionShader, h);
+    GET_UNIFORM(ge->searchReductionShader, tex);
+    CHK_OGL;
+    
+    /* domain standard deviation to depth, for culling */
+    ge->cullKeyShader.program = loadProgram(cgl_ctx, "common.vert", "cullKey.frag");
+    GET_UNIFORM(ge->cullKeyShader, w);
+    GET_UNIFORM(ge->cullKeyShader, h);
+    GET_UNIFORM(ge->cullKeyShader, sumD_sumD2_tex);
+    GET_UNIFORM(ge->cullKeyShader, n);
+    GET_UNIFORM(ge->cullKeyShader, blockSize);
+    CHK_OGL;
+    
+    return ge;
+}
+
+static void releaseFramebufferStorage(glEncoder* ge)
+{
+    glContextObj cgl_ctx = ge->cgl_ctx;
+    
+    glFramebufferRenderbufferEXT(
+        GL_FRAMEBUFFER_EXT, GL_DEPTH_ATTACHMENT_EXT,
+        GL_RENDERBUFFER_EXT, 0);
+    size_t i;
+    for (i = 0; i < 2; i++)
+    {
+        glFramebufferTexture2DEXT(
+            GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT0_EXT + i,
+            GL_TEXTURE_RECTANGLE_ARB, 0, 0);
+    }
+    
+    glDeleteRenderbuffersEXT(1, &ge->pixelDepthRenderbuffer);
+    glDeleteRenderbuffersEXT(1, &ge->blockDepthRenderbuffer);
+    glDeleteTextures(2 * NUM_SCRATCH_FORMATS, &ge->fboTex[0][0]);
+    memset(ge->fboTex, 0, sizeof(ge->fboTex));
+    ge->pixelDepthRenderbuffer = 0;
+    ge->blockDepthRenderbuffer = 0;
+    ge->scratchFormat = 0;
+    ge->scratchTex = NULL;
+    CHK_OGL;
+}
+
+/*
+ * Every attachment has to match the image size, so depth renderbuffers and
+ * scratch textures are reallocated whenever it changes.
+ */
+void resizeGLEncoder(glEncoder* ge, size_t w, size_t h)
+{
+    glContextObj cgl_ctx = ge->cgl_ctx;
+    
+    if (w == ge->fbW && h == ge->fbH && (ge->cullRMS == 0.0 || ge->blockDepthRenderbuffer != 0))
+    {
+        return;
+    }
+    releaseFramebufferStorage(ge);
+    ge->fbW = w;
+    ge->fbH = h;
+    
+    glGenRenderbuffersEXT(1, &ge->pixelDepthRenderbuffer);
+    glBindRenderbufferEXT(GL_RENDERBUFFER_EXT, ge->pixelDepthRenderbuffer);
+    glRenderbufferStorageEXT(GL_RENDERBUFFER_EXT, GL_DEPTH_COMPONENT24, ge->fbW, ge->fbH);
+    glFramebufferRenderbufferEXT(
+        GL_FRAMEBUFFER_EXT, GL_DEPTH_ATTACHMENT_EXT,
+        GL_RENDERBUFFER_EXT, ge->pixelDepthRenderbuffer);
+    CHK_OGL;
+    
+    if (ge->cullRMS > 0.0)
+    {
+        glGenRenderbuffersEXT(1, &ge->blockDepthRenderbuffer);
+        glBindRenderbufferEXT(GL_RENDERBUFFER_EXT, ge->blockDepthRenderbuffer);
+        glRenderbufferStorageEXT(GL_RENDERBUFFER_EXT, GL_DEPTH_COMPONENT24, ge->fbW, ge->fbH);
+        CHK_OGL;
+    }
+    
+    /* scratch FBO color attachments */
+    attachScratchTextures(ge, GL_RGBA32F_ARB);
+}
+
+void releaseGLEncoder(glEncoder* ge)
+{
+    glContextObj cgl_ctx = ge->cgl_ctx;
+    
+    releaseFramebufferStorage(ge);
+    glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, 0);
+    glDeleteFramebuffersEXT(1, &ge->fbo);
+    glDeleteBuffers(1, &ge->vbo);
+    glDeleteBuffers(1, &ge->ibo);
+    glDeleteProgram(ge->paintShader.program);
+    glDeleteProgram(ge->sumReductionShader.program);
+    glDeleteProgram(ge->squareShader.program);
+    glDeleteProgram(ge->zipperShader.program);
+    glDeleteProgram(ge->multiplyTiledShader.program);
+    glDeleteProgram(ge->calcSOShader.program);
+    glDeleteProgram(ge->searchReductionShader.program);
+    glDeleteProgram(ge->cullKeyShader.program);
+    CHK_OGL;
+    
+    free(ge);
+}
+
+/* per-pixel images and products are stored at reduced precision on request, sums never are */
+GLenum storageTextureFormat(glEncoder* ge, size_t numChannels)
+{
+    return ge->halfStorage ? halfTextureFormat(numChannels) : floatTextureFormat(numChannels);
+}
+
+/*
+ * EXT_framebuffer_object requires every color attachment to have the same
+ * internal format, so the ping-pong pair on attachments 0 and 1 is swapped
+ * to match whatever is about to be attached to attachment 2.
+ */
+void attachScratchTextures(glEncoder* ge,
+    GLenum format)
+{
+    glContextObj cgl_ctx = ge->cgl_ctx;
+    
+    if (format == ge->scratchFormat)
+    {
+        return;
+    }
+    
+    size_t f;
+    for (f = 0; f < NUM_SCRATCH_FORMATS && scratchFormats[f] != format; f++);
+    if (f == NUM_SCRATCH_FORMATS)
+    {
+        ERR("no scratch textures for format", "");
+    }
+    
+    size_t i;
+    for (i = 0; i < 2; i++)
+    {
+        if (ge->fboTex[f][i] == 0)
+        {
+            texInfo* t = createEmptyTexture(cgl_ctx, format, ge->fbW, ge->fbH);
+            ge->fboTex[f][i] = t->tex;
+            free(t);
+        }
+        glFramebufferTexture2DEXT(
+            GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT0_EXT + i,
+            GL_TEXTURE_RECTANGLE_ARB, ge->fboTex[f][i], 0);
+    }
+    CHK_OGL;
+    
+    ge->scratchFormat = format;
+    ge->scratchTex = ge->fboTex[f];
+    framebufferConfig = format;
+}
+
+/*
+ * Draws the next quad at depth cullDepth against a depth key map without
+ * writing depth, so fragments of culled domains fail the depth test before
+ * their fragment shader runs. They keep the clear color.
+ */
+void beginCulledPass(glEncoder* ge,
+    GLuint depthRenderbuffer)
+{
+    glContextObj cgl_ctx = ge->cgl_ctx;
+    
+    glFramebufferRenderbufferEXT(
+        GL_FRAMEBUFFER_EXT, GL_DEPTH_ATTACHMENT_EXT,
+        GL_RENDERBUFFER_EXT, depthRenderbuffer);
+    glEnable(GL_DEPTH_TEST);
+    glDepthFunc(GL_LEQUAL);
+    glDepthMask(GL_FALSE);
+    glDepthRange(ge->cullDepth, ge->cullDepth);
+    CHK_OGL;
+    CHK_FBO;
+}
+
+void endCulledPass(glEncoder* ge)
+{
+    glContextObj cgl_ctx = ge->cgl_ctx;
+    
+    glDepthRange(0.0, 1.0);
+    glDepthMask(GL_TRUE);
+    glDepthFunc(GL_LESS);
+    glDisable(GL_DEPTH_TEST);
+    CHK_OGL;
+}
+
+encodeData* createEncodeData(glEncoder* ge,
+    texInfo* srcImgT,
+    size_t d_size, size_t r_size)
+{
+    encodeData* ed;
+    createEncodeDataLevels(ge, srcImgT, &d_size, &r_size, 1, &ed);
+    
+    return ed;
+}
+
+void createEncodeDataLevels(glEncoder* ge,
+    texInfo* srcImgT,
+    const size_t* d_sizes, const size_t* r_sizes, size_t count,
+    encodeData** eds)
+{
+    glContextObj cgl_ctx = ge->cgl_ctx;
+    
+    int m = log2int(d_sizes[0]) - log2int(r_sizes[0]);
+    size_t k, l;
+    for (k = 0; k < count; k++)
+    {
+        if (r_sizes[k] < 2)
+        {
+            ERR("degenerate reduction", "range blocks under 2x2 pixels");
+        }
+        if (log2int(d_sizes[k]) - log2int(r_sizes[k]) != m)
+        {
+            ERR("levels with different domain to range ratios", "");
+        }
+        for (l = 0; l < k; l++)
+        {
+            if (r_sizes[l] == r_sizes[k])
+            {
+                ERR("two levels with the same block sizes", "");
+            }
+        }
+    }
+    
+    /* range and domain images, painted and squared once for every level */
+    
+    texInfo* R_T = paint(ge,
+        srcImgT,
+        srcImgT->w, srcImgT->h);
+    
+    texInfo* R_R2_T = square(ge,
+        R_T);
+    
+    texInfo* D_T = paint(ge,
+        srcImgT,
+        srcImgT->w >> m, srcImgT->h >> m);
+    
+    texInfo* D_D2_T = square(ge,
+        D_T);
+    
+    /*
+     * levels by increasing r_size, each level's sums reduced from the last
+     * one's, so the pyramid is walked once whatever the number of levels
+     */
+    texInfo* prevSumR_T = R_R2_T;
+    texInfo* prevSumD_T = D_D2_T;
+    size_t prevR_size = 1;
+    for (l = 0; l < count; l++)
+    {
+        size_t next = count;
+        for (k = 0; k < count; k++)
+        {
+            if (r_sizes[k] > prevR_size && (next == count || r_sizes[k] < r_sizes[next]))
+            {
+                next = k;
+            }
+        }
+        size_t r_size = r_sizes[next];
+        
+        encodeData* ed = calloc(1, sizeof(encodeData));
+        ed->R_T = R_T;
+        ed->D_T = D_T;
+        ed->sharedImages = l > 0;
+        ed->sumR_sumR2_T = sumReduce(ge,
+            prevSumR_T,
+            log2int(r_size) - log2int(prevR_size));
+        ed->sumD_sumD2_T = sumReduce(ge,
+            prevSumD_T,
+            log2int(r_size) - log2int(prevR_size));
+        ge->originXMult = ed->sumD_sumD2_T->aH;
+        if ((double)ed->sumD_sumD2_T->aW * ed->sumD_sumD2_T->aH > 16777216.0)
+        {
+            ERR("too many domains to pack their origins in a float", "");
+        }
+        
+        if (ge->cullRMS > 0.0)
+        {
+            ed->cullDepths = createCullDepths(ge, ed, r_size);
+        }
+        
+        eds[next] = ed;
+        prevSumR_T = ed->sumR_sumR2_T;
+        prevSumD_T = ed->sumD_sumD2_T;
+        prevR_size = r_size;
+    }
+    
+    releaseTexture(cgl_ctx, R_R2_T);
+    releaseTexture(cgl_ctx, D_D2_T);
+}
+
+void releaseEncodeData(glEncoder* ge,
+    encodeData* ed)
+{
+    glContextObj cgl_ctx = ge->cgl_ctx;
+    
+    if (!ed->sharedImages)
+    {
+        releaseTexture(cgl_ctx, ed->R_T);
+        releaseTexture(cgl_ctx, ed->D_T);
+    }
+    releaseTexture(cgl_ctx, ed->sumR_sumR2_T);
+    releaseTexture(cgl_ctx, ed->sumD_sumD2_T);
+    free(ed->cullDepths);
+    free(ed);
+}
+
+/* the best domain for one range, as a 1x1 (MSE, s, o, packed origin) texture */
+static texInfo* createRangeTransformTexture(glEncoder* ge,
+    encodeData* ed,
+    size_t r_size, size_t r_i, size_t r_j)
+{
+    glContextObj cgl_ctx = ge->cgl_ctx;
+    
+    ge->cullDepth = 0.0;
+    if (ed->cullDepths != NULL)
+    {
+        ge->cullDepth = ed->cullDepths[r_j * (ed->R_T->aW / r_size) + r_i];
+    }
+    
+    texInfo* Dr_T = multiplyTiled(ge, ed->D_T, ed->R_T,
+        r_size, r_i * r_size, r_j * r_size);
+    
+    texInfo* sumDr_T = sumReduce(ge,
+        Dr_T,
+        log2int(r_size));
+    
+    texInfo* sumD_sumD2_sumDr_T = zipper(ge,
+        ed->sumD_sumD2_T, sumDr_T);
+    
+    texInfo* rangeCandidates_T = calcSO(ge,
+        sumD_sumD2_sumDr_T, ed->sumR_sumR2_T,
+        r_size * r_size, r_i, r_j);
+    
+    texInfo* rangeTransform_T = searchReduce(ge,
+        rangeCandidates_T,
+        log2int(rangeCandidates_T->aW));
+    
+    releaseTexture(cgl_ctx, Dr_T);
+    releaseTexture(cgl_ctx, sumDr_T);
+    releaseTexture(cgl_ctx, sumD_sumD2_sumDr_T);
+    releaseTexture(cgl_ctx, rangeCandidates_T);
+    
+    return rangeTransform_T;
+}
+
+/* finds the best domain for one range */
+void searchRange(glEncoder* ge,
+    encodeData* ed,
+    size_t r_size, size_t r_i, size_t r_j,
+    rangeTransform* t)
+{
+    glContextObj cgl_ctx = ge->cgl_ctx;
+    
+    texInfo* rangeTransform_T = createRangeTransformTexture(ge, ed, r_size, r_i, r_j);
+    GLfloat* transform = createTupleFromPointTexture(ge, rangeTransform_T);
+    releaseTexture(cgl_ctx, rangeTransform_T);
+    
+    t->MSE = transform[0];
+    t->s = transform[1];
+    t->o = transform[2];
+    unpackOrigin(transform[3], ge->originXMult, &t->d_i, &t->d_j);
+    t->iso = 0;
+    
+    free(transform);
+}
+
+/*
+ * finds the best domain for one range and copies its transform to (r_i, r_j)
+ * of transformsT, for the decoder, without waiting on a readback
+ */
+void searchRangeToTexture(glEncoder* ge,
+    encodeData* ed,
+    size_t r_size, size_t r_i, size_t r_j,
+    texInfo* transformsT)
+{
+    glContextObj cgl_ctx = ge->cgl_ctx;
+    
+    texInfo* rangeTransform_T = createRangeTransformTexture(ge, ed, r_size, r_i, r_j);
+    
+    glFramebufferTexture2DEXT(
+        GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT2_EXT,
+        GL_TEXTURE_RECTANGLE_ARB, rangeTransform_T->tex, 0);
+    glReadBuffer(GL_COLOR_ATTACHMENT2_EXT);
+    CHK_OGL;
+    CHK_FBO;
+    
+    glBindTexture(GL_TEXTURE_RECTANGLE_ARB, transformsT->tex);
+    glCopyTexSubImage2D(GL_TEXTURE_RECTANGLE_ARB, 0, r_i, r_j, 0, 0, 1, 1);
+    CHK_OGL;
+    
+    glFramebufferTexture2DEXT(
+        GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT2_EXT,
+        GL_TEXTURE_RECTANGLE_ARB, 0, 0);
+    releaseTexture(cgl_ctx, rangeTransform_T);
+}
+
+/* TODO: astoundingly inefficient, use glGetPixels maybe? */
+GLfloat* createTupleFromPointTexture(glEncoder* ge,
+    texInfo* t)
+{
+    glContextObj cgl_ctx = ge->cgl_ctx;
+    
+    void* texDataBase = malloc(sizeof(GLfloat) * 4 * t->w * t->h);
+    glBindTexture(GL_TEXTURE_RECTANGLE_ARB, t->tex);
+    glGetTexImage(
+        GL_TEXTURE_RECTANGLE_ARB, 0, GL_RGBA,
+        GL_FLOAT, texDataBase);
+    CHK_OGL;
+    
+    void* tuple = malloc(sizeof(GLfloat) * t->aC);
+    memcpy(tuple, texDataBase, sizeof(GLfloat) * t->aC);
+    
+    free(texDataBase);
+    
+    return (GLfloat*)tuple;
+}
+
+GLfloat* createRGBAFromTexture(glEncoder* ge,
+    texInfo* t)
+{
+    glContextObj cgl_ctx = ge->cgl_ctx;
+    
+    GLfloat* pixels = malloc(sizeof(GLfloat) * 4 * t->w * t->h);
+    glBindTexture(GL_TEXTURE_RECTANGLE_ARB, t->tex);
+    glGetTexImage(
+        GL_TEXTURE_RECTANGLE_ARB, 0, GL_RGBA,
+        GL_FLOAT, pixels);
+    CHK_OGL;
+    
+    return pixels;
+}
+
+static int compareFloats(const void* a, const void* b)
+{
+    GLfloat x = *(const GLfloat*)a;
+    GLfloat y = *(const GLfloat*)b;
+    return (x > y) - (x < y);
+}
+
+/* 0.5 + the standard deviation of a block, from its sum and sum of squares */
+static GLfloat cullKey(GLfloat sum, GLfloat sum2, size_t n)
+{
+    GLfloat mean = sum / n;
+    GLfloat variance = sum2 / n - mean * mean;
+    return 0.5 + sqrt(variance > 0.0 ? variance : 0.0);
+}
+
+/*
+ * Writes both depth key maps from the domain sums, once per image, and
+ * returns the depth each range's quads are drawn at. A range's depth is
+ * capped just below the largest domain key so it never culls every domain.
+ */
+GLfloat* createCullDepths(glEncoder* ge,
+    encodeData* ed,
+    size_t r_size)
+{
+    glContextObj cgl_ctx = ge->cgl_ctx;
+    
+    size_t n = r_size * r_size;
+    
+    glUseProgram(ge->cullKeyShader.program);
+    glUniform1i(ge->cullKeyShader.sumD_sumD2_tex, 0 /* GL_TEXTURE0 */);
+    glUniform1f(ge->cullKeyShader.n, n);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_RECTANGLE_ARB, ed->sumD_sumD2_T->tex);
+    glDrawBuffer(GL_NONE);
+    glEnable(GL_DEPTH_TEST);
+    glDepthFunc(GL_ALWAYS);
+    glClearDepth(0.0);
+    CHK_OGL;
+    
+    GLuint renderbuffers[2] = { ge->pixelDepthRenderbuffer, ge->blockDepthRenderbuffer };
+    GLfloat blockSizes[2] = { r_size, 1.0 };
+    size_t widths[2] = { ed->D_T->aW, ed->sumD_sumD2_T->aW };
+    size_t heights[2] = { ed->D_T->aH, ed->sumD_sumD2_T->aH };
+    size_t i;
+    for (i = 0; i < 2; i++)
+    {
+        glFramebufferRenderbufferEXT(
+            GL_FRAMEBUFFER_EXT, GL_DEPTH_ATTACHMENT_EXT,
+            GL_RENDERBUFFER_EXT, renderbuffers[i]);
+        CHK_OGL;
+        CHK_FBO;
+        
+        glUniform1f(ge->cullKeyShader.w, widths[i]);
+        glUniform1f(ge->cullKeyShader.h, heights[i]);
+        glUniform1f(ge->cullKeyShader.blockSize, blockSizes[i]);
+        CHK_OGL;
+        
+        glViewport(0, 0, widths[i], heights[i]);
+        glClear(GL_DEPTH_BUFFER_BIT);
+        glDrawArrays(GL_QUADS, 0, 4);
+        CHK_OGL;
+    }
+    
+    glClearDepth(1.0);
+    glDepthFunc(GL_LESS);
+    glDisable(GL_DEPTH_TEST);
+    glFramebufferRenderbufferEXT(
+        GL_FRAMEBUFFER_EXT, GL_DEPTH_ATTACHMENT_EXT,
+        GL_RENDERBUFFER_EXT, ge->pixelDepthRenderbuffer);
+    CHK_OGL;
+    
+    /* the same keys on the CPU, sorted, to cap the range depths and count culls */
+    size_t domainCols = ed->sumD_sumD2_T->aW;
+    size_t domainRows = ed->sumD_sumD2_T->aH;
+    size_t numDomains = domainCols * domainRows;
+    GLfloat* sumD_sumD2 = createRGBAFromTexture(ge, ed->sumD_sumD2_T);
+    GLfloat* domainKeys = malloc(numDomains * sizeof(GLfloat));
+    size_t d_i, d_j;
+    for (d_j = 0; d_j < domainRows; d_j++)
+    {
+        for (d_i = 0; d_i < domainCols; d_i++)
+        {
+            GLfloat* P = sumD_sumD2 + 4 * (d_j * ed->sumD_sumD2_T->w + d_i);
+            domainKeys[d_j * domainCols + d_i] = cullKey(P[0], P[1], n);
+        }
+    }
+    qsort(domainKeys, numDomains, sizeof(GLfloat), compareFloats);
+    GLfloat maxDepth = domainKeys[numDomains - 1] - 1.0e-5;
+    
+    size_t rangeCols = ed->sumR_sumR2_T->aW;
+    size_t rangeRows = ed->sumR_sumR2_T->aH;
+    GLfloat* sumR_sumR2 = createRGBAFromTexture(ge, ed->sumR_sumR2_T);
+    GLfloat* cullDepths = malloc(rangeCols * rangeRows * sizeof(GLfloat));
+    size_t r_i, r_j;
+    for (r_j = 0; r_j < rangeRows; r_j++)
+    {
+        for (r_i = 0; r_i < rangeCols; r_i++)
+        {
+            GLfloat* P = sumR_sumR2 + 4 * (r_j * ed->sumR_sumR2_T->w + r_i);
+            GLfloat depth = cullKey(P[0], P[1], n) - ge->cullRMS;
+            if (depth < 0.5) depth = 0.5;
+            if (depth > maxDepth) depth = maxDepth;
+            cullDepths[r_j * rangeCols + r_i] = depth;
+            
+            size_t lo = 0;
+            size_t hi = numDomains;
+            while (lo < hi)
+            {
+                size_t mid = (lo + hi) / 2;
+                if (domainKeys[mid] < depth) lo = mid + 1;
+                else hi = mid;
+            }
+            ed->numCulled += lo;
+        }
+    }
+    
+    free(sumD_sumD2);
+    free(sumR_sumR2);
+    free(domainKeys);
+    
+    return cullDepths;
+}
+
+texInfo* calcSO(glEncoder* ge,
+    texInfo* sumD_sumD2_sumDr_T, texInfo* sumR_sumR2_T,
+    size_t n, size_t r_i, size_t r_j)
+{
+    glContextObj cgl_ctx = ge->cgl_ctx;
+    
+    glUseProgram(ge->calcSOShader.program);
+    glUniform1i(ge->calcSOShader.sumD_sumD2_sumDr_tex, 0 /* GL_TEXTURE0 */);
+    glUniform1i(ge->calcSOShader.sumR_sumR2_tex, 1 /* GL_TEXTURE1 */);
+    glUniform1f(ge->calcSOShader.n, n);
+    glUniform1f(ge->calcSOShader.r_i, r_i);
+    glUniform1f(ge->calcSOShader.r_j, r_j);
+    glUniform1i(ge->calcSOShader.originXMult, ge->originXMult);
+    CHK_OGL;
+    
+    texInfo* dstT = createEmptyTexture(cgl_ctx, floatTextureFormat(4), ge->fbW, ge->fbH);
+    dstT->aW = sumD_sumD2_sumDr_T->aW;
+    dstT->aH = sumD_sumD2_sumDr_T->aH;
+    dstT->aC = 4;
+    
+    attachScratchTextures(ge, dstT->format);
+    glFramebufferTexture2DEXT(
+        GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT2_EXT,
+        GL_TEXTURE_RECTANGLE_ARB, dstT->tex, 0);
+    glDrawBuffer(GL_COLOR_ATTACHMENT2_EXT);
+    CHK_OGL;
+    CHK_FBO;
+    
+    glUniform1f(ge->calcSOShader.w, sumD_sumD2_sumDr_T->w);
+    glUniform1f(ge->calcSOShader.h, sumD_sumD2_sumDr_T->h);
+    CHK_OGL;
+    
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_RECTANGLE_ARB, sumD_sumD2_sumDr_T->tex);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_RECTANGLE_ARB, sumR_sumR2_T->tex);
+    CHK_OGL;
+    
+    /* culled domains keep an MSE of 1, worse than any fit of [0, 1] data */
+    if (ge->cullDepth > 0.0)
+    {
+        beginCulledPass(ge, ge->blockDepthRenderbuffer);
+        glClearColor(1.0, 0.0, 0.0, 0.0);
+    }
+    
+    glViewport(0, 0, dstT->w, dstT->h);
+    glClear(GL_COLOR_BUFFER_BIT);
+    glDrawArrays(GL_QUADS, 0, 4);
+    CHK_OGL;
+    
+    if (ge->cullDepth > 0.0)
+    {
+        glClearColor(0.0, 0.0, 0.0, 0.0);
+        endCulledPass(ge);
+    }
+    
+    glFramebufferTexture2DEXT(
+        GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT2_EXT,
+        GL_TEXTURE_RECTANGLE_ARB, 0, 0);
+    
+    return dstT;
+}
+
+texInfo* multiplyTiled(glEncoder* ge,
+    texInfo* D_T, texInfo* R_T,
+    size_t r_size, size_t r_x, size_t r_y)
+{
+    glContextObj cgl_ctx = ge->cgl_ctx;
+    
+    glUseProgram(ge->multiplyTiledShader.program);
+    glUniform1i(ge->multiplyTiledShader.D_tex, 0 /* GL_TEXTURE0 */);
+    glUniform1i(ge->multiplyTiledShader.R_tex, 1 /* GL_TEXTURE1 */);
+    glUniform1f(ge->multiplyTiledShader.r_size, r_size);
+    glUniform1f(ge->multiplyTiledShader.r_x, r_x);
+    glUniform1f(ge->multiplyTiledShader.r_y, r_y);
+    CHK_OGL;
+    
+    texInfo* dstT = createEmptyTexture(cgl_ctx, storageTextureFormat(ge, D_T->aC), ge->fbW, ge->fbH);
+    dstT->aW = D_T->aW;
+    dstT->aH = D_T->aH;
+    dstT->aC = D_T->aC;
+    
+    attachScratchTextures(ge, dstT->format);
+    glFramebufferTexture2DEXT(
+        GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT2_EXT,
+        GL_TEXTURE_RECTANGLE_ARB, dstT->tex, 0);
+    glDrawBuffer(GL_COLOR_ATTACHMENT2_EXT);
+    CHK_OGL;
+    CHK_FBO;
+    
+    glUniform1f(ge->multiplyTiledShader.w, D_T->w);
+    glUniform1f(ge->multiplyTiledShader.h, D_T->h);
+    CHK_OGL;
+    
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_RECTANGLE_ARB, D_T->tex);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_RECTANGLE_ARB, R_T->tex);
+    CHK_OGL;
+    
+    if (ge->cullDepth > 0.0)
+    {
+        beginCulledPass(ge, ge->pixelDepthRenderbuffer);
+    }
+    
+    glViewport(0, 0, dstT->w, dstT->h);
+    glClear(GL_COLOR_BUFFER_BIT);
+    glDrawArrays(GL_QUADS, 0, 4);
+    CHK_OGL;
+    
+    if (ge->cullDepth > 0.0)
+    {
+        endCulledPass(ge);
+    }
+    
+    glFramebufferTexture2DEXT(
+        GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT2_EXT,
+        GL_TEXTURE_RECTANGLE_ARB, 0, 0);
+    
+    return dstT;
+}
+
+texInfo* paint(glEncoder* ge,
+    texInfo* srcT,
+    size_t dstW, size_t dstH)
+{
+    glContextObj cgl_ctx = ge->cgl_ctx;
+    
+    glUseProgram(ge->paintShader.program);
+    glActiveTexture(GL_TEXTURE0);
+    glUniform1i(ge->paintShader.tex, 0 /* GL_TEXTURE0 */);
+    CHK_OGL;
+    
+    texInfo* dstT = createEmptyTexture(cgl_ctx, storageTextureFormat(ge, srcT->aC), ge->fbW, ge->fbH);
+    dstT->aW = dstW;
+    dstT->aH = dstH;
+    dstT->aC = srcT->aC;
+    
+    attachScratchTextures(ge, dstT->format);
+    glFramebufferTexture2DEXT(
+        GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT2_EXT,
+        GL_TEXTURE_RECTANGLE_ARB, dstT->tex, 0);
+    glDrawBuffer(GL_COLOR_ATTACHMENT2_EXT);
+    CHK_OGL;
+    CHK_FBO;
+    
+    glUniform1f(ge->paintShader.w, srcT->w);
+    glUniform1f(ge->paintShader.h, srcT->h);
+    CHK_OGL;
+    
+    glBindTexture(GL_TEXTURE_RECTANGLE_ARB, srcT->tex);
+    CHK_OGL;
+    
+    glViewport(0, 0, dstW, dstH);
+    glClear(GL_COLOR_BUFFER_BIT);
+    glDrawArrays(GL_QUADS, 0, 4);
+    CHK_OGL;
+    
+    glFramebufferTexture2DEXT(
+        GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT2_EXT,
+        GL_TEXTURE_RECTANGLE_ARB, 0, 0);
+    
+    return dstT;
+}
+
+texInfo* square(glEncoder* ge,
+    texInfo* srcT)
+{
+    glContextObj cgl_ctx = ge->cgl_ctx;
+    
+    glUseProgram(ge->squareShader.program);
+    glActiveTexture(GL_TEXTURE0);
+    glUniform1i(ge->squareShader.tex, 0 /* GL_TEXTURE0 */);
+    CHK_OGL;
+    
+    texInfo* dstT = createEmptyTexture(cgl_ctx, storageTextureFormat(ge, 2), ge->fbW, ge->fbH);
+    dstT->aW = srcT->aW;
+    dstT->aH = srcT->aH;
+    dstT->aC = 2;
+    
+    attachScratchTextures(ge, dstT->format);
+    glFramebufferTexture2DEXT(
+        GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT2_EXT,
+        GL_TEXTURE_RECTANGLE_ARB, dstT->tex, 0);
+    glDrawBuffer(GL_COLOR_ATTACHMENT2_EXT);
+    CHK_OGL;
+    CHK_FBO;
+    
+    glUniform1f(ge->squareShader.w, srcT->w);
+    glUniform1f(ge->squareShader.h, srcT->h);
+    CHK_OGL;
+    
+    glBindTexture(GL_TEXTURE_RECTANGLE_ARB, srcT->tex);
+    CHK_OGL;
+    
+    glViewport(0, 0, dstT->w, dstT->h);
+    glClear(GL_COLOR_BUFFER_BIT);
+    glDrawArrays(GL_QUADS, 0, 4);
+    CHK_OGL;
+    
+    glFramebufferTexture2DEXT(
+        GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT2_EXT,
+        GL_TEXTURE_RECTANGLE_ARB, 0, 0);
+    
+    return dstT;
+}
+
+texInfo* zipper(glEncoder* ge,
+    texInfo* rgT, texInfo* baT)
+{
+    glContextObj cgl_ctx = ge->cgl_ctx;
+    
+    glUseProgram(ge->zipperShader.program);
+    glUniform1i(ge->zipperShader.RG_tex, 0 /* GL_TEXTURE0 */);
+    glUniform1i(ge->zipperShader.BA_tex, 1 /* GL_TEXTURE1 */);
+    CHK_OGL;
+    
+    texInfo* dstT = createEmptyTexture(cgl_ctx, floatTextureFormat(rgT->aC + baT->aC), ge->fbW, ge->fbH);
+    dstT->aW = rgT->aW;
+    dstT->aH = rgT->aH;
+    dstT->aC = rgT->aC + baT->aC; /* works if rgT->aC == 2 and baT->aC == 1 */
+    
+    attachScratchTextures(ge, dstT->format);
+    glFramebufferTexture2DEXT(
+        GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT2_EXT,
+        GL_TEXTURE_RECTANGLE_ARB, dstT->tex, 0);
+    glDrawBuffer(GL_COLOR_ATTACHMENT2_EXT);
+    CHK_OGL;
+    CHK_FBO;
+    
+    glUniform1f(ge->zipperShader.w, rgT->w);
+    glUniform1f(ge->zipperShader.h, rgT->h);
+    CHK_OGL;
+    
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_RECTANGLE_ARB, rgT->tex);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_RECTANGLE_ARB, baT->tex);
+    CHK_OGL;
+    
+    glViewport(0, 0, dstT->w, dstT->h);
+    glClear(GL_COLOR_BUFFER_BIT);
+    glDrawArrays(GL_QUADS, 0, 4);
+    CHK_OGL;
+    
+    glFramebufferTexture2DEXT(
+        GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT2_EXT,
+        GL_TEXTURE_RECTANGLE_ARB, 0, 0);
+    
+    return dstT;
+}
+
+texInfo* sumReduce(glEncoder* ge,
+    texInfo* srcT,
+    size_t times)
+{
+    glContextObj cgl_ctx = ge->cgl_ctx;
+    
+    if (times == 0)
+    {
+        ERR("degenerate reduction", "did you do something wrong?");
+    }
+    
+    size_t w = srcT->aW;
+    size_t h = srcT->aH;
+    
+    texInfo* dstT = createEmptyTexture(cgl_ctx, floatTextureFormat(srcT->aC), ge->fbW, ge->fbH);
+    dstT->aW = w >> times;
+    dstT->aH = h >> times;
+    dstT->aC = srcT->aC;
+    
+    attachScratchTextures(ge, dstT->format);
+    glFramebufferTexture2DEXT(
+        GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT2_EXT,
+        GL_TEXTURE_RECTANGLE_ARB, dstT->tex, 0);
+    
+    glUseProgram(ge->sumReductionShader.program);
+    glActiveTexture(GL_TEXTURE0);
+    glUniform1i(ge->sumReductionShader.tex, 0 /* GL_TEXTURE0 */);
+    CHK_OGL;
+    
+    if (times == 1)
+    {
+        glBindTexture(GL_TEXTURE_RECTANGLE_ARB, srcT->tex);
+        glDrawBuffer(GL_COLOR_ATTACHMENT2_EXT);
+        CHK_OGL;
+        CHK_FBO;
+        
+        glUniform1f(ge->sumReductionShader.w, w);
+        glUniform1f(ge->sumReductionShader.h, h);
+        CHK_OGL;
+        
+        glViewport(0, 0, w / 2, h / 2);
+        glClear(GL_COLOR_BUFFER_BIT);
+        glDrawArrays(GL_QUADS, 0, 4);
+        CHK_OGL;
+    }
+    else
+    {
+        glBindTexture(GL_TEXTURE_RECTANGLE_ARB, srcT->tex);
+        glDrawBuffer(GL_COLOR_ATTACHMENT0_EXT);
+        CHK_OGL;
+        CHK_FBO;
+        
+        glUniform1f(ge->sumReductionShader.w, w);
+        glUniform1f(ge->sumReductionShader.h, h);
+        CHK_OGL;
+        
+        glViewport(0, 0, w / 2, h / 2);
+        glClear(GL_COLOR_BUFFER_BIT);
+        glDrawArrays(GL_QUADS, 0, 4);
+        CHK_OGL;
+        
+        GLuint ping = 0;
+        GLuint pong = 1;
+        
+        size_t i;
+        for (i = 0; i < times - 2; i++)
+        {
+            w /= 2;
+            h /= 2;
+            
+            glUniform1f(ge->sumReductionShader.w, w);
+            glUniform1f(ge->sumReductionShader.h, h);
+            CHK_OGL;
+            
+            glBindTexture(GL_TEXTURE_RECTANGLE_ARB, ge->scratchTex[ping]);
+            glDrawBuffer(GL_COLOR_ATTACHMENT0_EXT + pong);
+            CHK_OGL;
+            CHK_FBO;
+            
+            glViewport(0, 0, w / 2, h / 2);
+            glClear(GL_COLOR_BUFFER_BIT);
+            glDrawArrays(GL_QUADS, 0, 4);
+            CHK_OGL;
+            
+            ping ^= 1;
+            pong ^= 1;
+        }
+        
+        w /= 2;
+        h /= 2;
+        
+        glUniform1f(ge->sumReductionShader.w, w);
+        glUniform1f(ge->sumReductionShader.h, h);
+        CHK_OGL;
+        
+        glBindTexture(GL_TEXTURE_RECTANGLE_ARB, ge->scratchTex[ping]);
+        glDrawBuffer(GL_COLOR_ATTACHMENT2_EXT);
+        CHK_OGL;
+        CHK_FBO;
+        
+        glViewport(0, 0, w / 2, h / 2);
+        glClear(GL_COLOR_BUFFER_BIT);
+        glDrawArrays(GL_QUADS, 0, 4);
+        CHK_OGL;
+    }
+    
+    glFramebufferTexture2DEXT(
+        GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT2_EXT,
+        GL_TEXTURE_RECTANGLE_ARB, 0, 0);
+    
+    return dstT;
+}
+
+texInfo* searchReduce(glEncoder* ge,
+    texInfo* srcT,
+    size_t times)
+{
+    glContextObj cgl_ctx = ge->cgl_ctx;
+    
+    if (times == 0)
+    {
+        ERR("degenerate reduction", "did you do something wrong?");
+    }
+    
+    size_t w = srcT->aW;
+    size_t h = srcT->aH;
+    
+    texInfo* dstT = createEmptyTexture(cgl_ctx, floatTextureFormat(4), ge->fbW, ge->fbH);
+    dstT->aW = w >> times;
+    dstT->aH = h >> times;
+    dstT->aC = 4;
+    
+    attachScratchTextures(ge, dstT->format);
+    glFramebufferTexture2DEXT(
+        GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT2_EXT,
+        GL_TEXTURE_RECTANGLE_ARB, dstT->tex, 0);
+    
+    glUseProgram(ge->searchReductionShader.program);
+    glActiveTexture(GL_TEXTURE0);
+    glUniform1i(ge->searchReductionShader.tex, 0 /* GL_TEXTURE0 */);
+    CHK_OGL;
+    
+    if (times == 1)
+    {
+        glBindTexture(GL_TEXTURE_RECTANGLE_ARB, srcT->tex);
+        glDrawBuffer(GL_COLOR_ATTACHMENT2_EXT);
+        CHK_OGL;
+        CHK_FBO;
+        
+        glUniform1f(ge->searchReductionShader.w, w);
+        glUniform1f(ge->searchReductionShader.h, h);
+        CHK_OGL;
+        
+        glViewport(0, 0, w / 2, h / 2);
+        glClear(GL_COLOR_BUFFER_BIT);
+        glDrawArrays(GL_QUADS, 0, 4);
+        CHK_OGL;
+    }
+    else
+    {
+        glBindTexture(GL_TEXTURE_RECTANGLE_ARB, srcT->tex);
+        glDrawBuffer(GL_COLOR_ATTACHMENT0_EXT);
+        CHK_OGL;
+        CHK_FBO;
+        
+        glUniform1f(ge->searchReductionShader.w, w);
+        glUniform1f(ge->searchReductionShader.h, h);
+        CHK_OGL;
+        
+        glViewport(0, 0, w / 2, h / 2);
+        glClear(GL_COLOR_BUFFER_BIT);
+        glDrawArrays(GL_QUADS, 0, 4);
+        CHK_OGL;
+        
+        GLuint ping = 0;
+        GLuint pong = 1;
+        
+        size_t i;
+        for (i = 0; i < times - 2; i++)
+        {
+            w /= 2;
+            h /= 2;
+            
+            glUniform1f(ge->searchReductionShader.w, w);
+            glUniform1f(ge->searchReductionShader.h, h);
+            CHK_OGL;
+            
+            glBindTexture(GL_TEXTURE_RECTANGLE_ARB, ge->scratchTex[ping]);
+            glDrawBuffer(GL_COLOR_ATTACHMENT0_EXT + pong);
+            CHK_OGL;
+            CHK_FBO;
+            
+            glViewport(0, 0, w / 2, h / 2);
+            glClear(GL_COLOR_BUFFER_BIT);
+            glDrawArrays(GL_QUADS, 0, 4);
+            CHK_OGL;
+            
+            ping ^= 1;
+            pong ^= 1;
+        }
+        
+        w /= 2;
+        h /= 2;
+        
+        glUniform1f(ge->searchReductionShader.w, w);
+        glUniform1f(ge->searchReductionShader.h, h);
+        CHK_OGL;
+        
+        glBindTexture(GL_TEXTURE_RECTANGLE_ARB, ge->scratchTex[ping]);
+        glDrawBuffer(GL_COLOR_ATTACHMENT2_EXT);
+        CHK_OGL;
+        CHK_FBO;
+        
+        glViewport(0, 0, w / 2, h / 2);
+        glClear(GL_COLOR_BUFFER_BIT);
+        glDrawArrays(GL_QUADS, 0, 4);
+        CHK_OGL;
+    }
+    
+    glFramebufferTexture2DEXT(
+        GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT2_EXT,
+        GL_TEXTURE_RECTANGLE_ARB, 0, 0);
+    
+    return dstT;
+}
\ No newline at end of file
@@ -0,0 +1,209 @@
+#ifndef GLENC_H
+#define GLENC_H
+
+#include <stdlib.h>
+
+#include "glcontext.h"
+#include "glio.h"
+#include "transform.h"
+
+/*
+ * GL fragment shader encoder
+ *
+ * All of its state lives in a glEncoder bound to one GL context, so
+ * several can coexist in a process, one per context.
+ */
+
+/*
+ * programs, each with its uniform locations, resolved once in
+ * createGLEncoder by GET_UNIFORM from the field names
+ */
+
+#define GET_UNIFORM(shader, name) \
+    ((shader).name = glGetUniformLocation((shader).program, #name))
+
+typedef struct paintProgram {
+    GLuint program;
+    GLint w;
+    GLint h;
+    GLint tex;
+} paintProgram;
+
+typedef struct sumReductionProgram {
+    GLuint program;
+    GLint w;
+    GLint h;
+    GLint tex;
+} sumReductionProgram;
+
+typedef struct squareProgram {
+    GLuint program;
+    GLint w;
+    GLint h;
+    GLint tex;
+} squareProgram;
+
+typedef struct zipperProgram {
+    GLuint program;
+    GLint w;
+    GLint h;
+    GLint RG_tex;
+    GLint BA_tex;
+} zipperProgram;
+
+typedef struct multiplyTiledProgram {
+    GLuint program;
+    GLint w;
+    GLint h;
+    GLint D_tex;
+    GLint R_tex;
+    GLint r_size;
+    GLint r_x;
+    GLint r_y;
+} multiplyTiledProgram;
+
+typedef struct calcSOProgram {
+    GLuint program;
+    GLint originXMult;
+    GLint w;
+    GLint h;
+    GLint sumD_sumD2_sumDr_tex;
+    GLint sumR_sumR2_tex;
+    GLint n;
+    GLint r_i;
+    GLint r_j;
+} calcSOProgram;
+
+typedef struct searchReductionProgram {
+    GLuint program;
+    GLint w;
+    GLint h;
+    GLint tex;
+} searchReductionProgram;
+
+typedef struct cullKeyProgram {
+    GLuint program;
+    GLint w;
+    GLint h;
+    GLint sumD_sumD2_tex;
+    GLint n;
+    GLint blockSize;
+} cullKeyProgram;
+
+/* ping-pong scratch textures, one pair per storage format, created on first use */
+#define NUM_SCRATCH_FORMATS 6
+
+typedef struct glEncoder {
+    glContextObj cgl_ctx;
+    
+    /*
+     * calcSO packs a domain's origin into one float as
+     * d_i * originXMult + d_j, the domain rows of the encodeData last
+     * created or about to be searched, exact while there are at most 2^24
+     * domains
+     */
+    int originXMult;
+    
+    /*
+     * early-Z domain culling: a domain block whose standard deviation is
+     * more than cullRMS below the range's cannot fit it with an RMS error
+     * under cullRMS, since |s| < 1. 0 disables culling.
+     */
+    GLfloat cullRMS;
+    
+    /* set while building the fp16 side of the pipeline */
+    GLboolean halfStorage;
+    
+    /* size of every attachment, the size of the image being encoded */
+    size_t fbW, fbH;
+    
+    GLuint fbo;
+    GLuint vbo;
+    GLuint ibo;
+    
+    GLuint fboTex[NUM_SCRATCH_FORMATS][2];
+    GLenum scratchFormat;
+    GLuint* scratchTex;
+    
+    /*
+     * depth keys for culling: one per domain pixel for multiplyTiled, one
+     * per domain block for calcSO. Keys are 0.5 + the block's standard
+     * deviation, and everything outside the domain image stays 0.
+     */
+    GLuint pixelDepthRenderbuffer;
+    GLuint blockDepthRenderbuffer;
+    
+    /* depth of the current range's quads, 0 when not culling */
+    GLfloat cullDepth;
+    
+    paintProgram paintShader;
+    sumReductionProgram sumReductionShader;
+    squareProgram squareShader;
+    zipperProgram zipperShader;
+    multiplyTiledProgram multiplyTiledShader;
+    calcSOProgram calcSOShader;
+    searchReductionProgram searchReductionShader;
+    cullKeyProgram cullKeyShader;
+} glEncoder;
+
+/*
+ * range and domain images and their per-block sums, shared by every range
+ */
+
+typedef struct encodeData {
+    texInfo* R_T;
+    texInfo* D_T;
+    texInfo* sumR_sumR2_T;
+    texInfo* sumD_sumD2_T;
+    GLfloat* cullDepths;      /* per range, NULL unless culling */
+    size_t numCulled;         /* domain blocks culled, over all ranges */
+    int sharedImages;         /* R_T and D_T belong to another level, see createEncodeDataLevels */
+} encodeData;
+
+/* calcSO.frag's packing of domain origins, exact for integers up to 2^24 */
+static inline GLfloat packOrigin(size_t d_i, size_t d_j, int originXMult)
+{
+    return (GLfloat)(d_i * originXMult + d_j);
+}
+
+static inline void unpackOrigin(double packed, int originXMult, size_t* d_i, size_t* d_j)
+{
+    *d_i = (size_t)floor((packed + 0.5) / originXMult);
+    *d_j = (size_t)(packed - (double)*d_i * originXMult);
+}
+
+glEncoder* createGLEncoder(glContextObj cgl_ctx);
+void resizeGLEncoder(glEncoder* ge, size_t w, size_t h);
+void releaseGLEncoder(glEncoder* ge);
+
+encodeData* createEncodeData(glEncoder* ge,
+    texInfo* srcImgT,
+    size_t d_size, size_t r_size);
+
+/*
+ * encodeData for several block sizes of one image at once, into eds[k]
+ * for d_sizes[k] and r_sizes[k]. Every level must have the same
+ * d_size / r_size, so all share one range image and one domain image,
+ * and each level's block sums are reduced from the next smaller level's.
+ * The level with the smallest r_size owns the shared images, so release
+ * it last.
+ */
+void createEncodeDataLevels(glEncoder* ge,
+    texInfo* srcImgT,
+    const size_t* d_sizes, const size_t* r_sizes, size_t count,
+    encodeData** eds);
+
+void releaseEncodeData(glEncoder* ge,
+    encodeData* ed);
+
+void searchRange(glEncoder* ge,
+    encodeData* ed,
+    size_t r_size, size_t r_i, size_t r_j,
+    rangeTransform* t);
+
+void searchRangeToTexture(glEncoder* ge,
+    encodeData* ed,
+    size_t r_size, size_t r_i, size_t r_j,
+    texInfo* transformsT);
+
+#endif
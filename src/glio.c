@@ -1,37 +1,24 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include <fcntl.h>
-#include <sys/mman.h>
 #include <sys/stat.h>
 
-#include <CoreFoundation/CoreFoundation.h>
-#include <ApplicationServices/ApplicationServices.h>
-#include <OpenGL/OpenGL.h>
-#include <OpenGL/CGLMacro.h>
+#include "glcontext.h"
 
 #include "errors.h"
 #include "fpimage.h"
+#include "imageio.h"
 
 #include "glio.h"
+#include "shaders.h"
 
-texInfo* createTextureFromPath(CGLContextObj cgl_ctx, char* pathBytes)
+texInfo* createTextureFromPath(glContextObj cgl_ctx, char* pathBytes)
 {
     texInfo* t = calloc(1, sizeof(texInfo));
     
-    CFURLRef url = CFURLCreateFromFileSystemRepresentation(
-        NULL, (unsigned char*)pathBytes, strlen(pathBytes), false);
-    CGImageSourceRef imgSrc = CGImageSourceCreateWithURL(url, NULL);
-    CGImageRef img = CGImageSourceCreateImageAtIndex(imgSrc, 0, NULL);
-    t->w  = CGImageGetWidth(img);
-    t->h = CGImageGetHeight(img);
-    CGRect rect = {{0, 0}, {t->w, t->h}};
-    void* data = calloc(t->w * 4, t->h);
-    CGColorSpaceRef colorspace = CGColorSpaceCreateDeviceRGB();
-    CGContextRef cgCtx = CGBitmapContextCreate(
-        data, t->w, t->h, 8, t->w * 4, colorspace,
-        kCGBitmapByteOrder32Host | kCGImageAlphaPremultipliedFirst);
-    CGContextDrawImage(cgCtx, rect, img);
+    void* data = createBGRAFromFile(pathBytes, &t->w, &t->h);
     
     glGenTextures(1, &(t->tex));
     glBindTexture(GL_TEXTURE_RECTANGLE_ARB, t->tex);
@@ -46,13 +33,9 @@ texInfo* createTextureFromPath(CGLContextObj cgl_ctx, char* pathBytes)
         0, GL_BGRA_EXT, GL_UNSIGNED_INT_8_8_8_8_REV, data);
     CHK_OGL;
     
-    CFRelease(url);
-    CGImageRelease(img);
-    CFRelease(imgSrc);
-    CGColorSpaceRelease(colorspace);
-    CGContextRelease(cgCtx);
     free(data);
     
+    t->format = GL_RGBA8;
     t->aW = t->w;
     t->aH = t->h;
     t->aC = 4;
@@ -60,10 +43,52 @@ texInfo* createTextureFromPath(CGLContextObj cgl_ctx, char* pathBytes)
     return t;
 }
 
-texInfo* createEmptyTexture(CGLContextObj cgl_ctx, GLenum format, size_t w, size_t h)
+texInfo* createTextureFromGrayBytes(glContextObj cgl_ctx, const GLubyte* pixels, size_t w, size_t h, size_t stride)
 {
     texInfo* t = calloc(1, sizeof(texInfo));
+    t->w = w;
+    t->h = h;
+    
+    glGenTextures(1, &(t->tex));
+    glBindTexture(GL_TEXTURE_RECTANGLE_ARB, t->tex);
+    glTexParameterf(GL_TEXTURE_RECTANGLE_ARB, GL_TEXTURE_WRAP_S, GL_CLAMP);
+    glTexParameterf(GL_TEXTURE_RECTANGLE_ARB, GL_TEXTURE_WRAP_T, GL_CLAMP);
+    glTexParameterf(GL_TEXTURE_RECTANGLE_ARB, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameterf(GL_TEXTURE_RECTANGLE_ARB, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, stride);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(
+        GL_TEXTURE_RECTANGLE_ARB, 0, GL_LUMINANCE8, t->w, t->h,
+        0, GL_LUMINANCE, GL_UNSIGNED_BYTE, pixels);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    CHK_OGL;
+    
+    t->format = GL_LUMINANCE8;
+    t->aW = t->w;
+    t->aH = t->h;
+    t->aC = 1;
+    
+    return t;
+}
+
+GLubyte* createGrayBytesFromTexture(glContextObj cgl_ctx, texInfo* t)
+{
+    GLubyte* pixels = malloc(t->w * t->h);
+    glBindTexture(GL_TEXTURE_RECTANGLE_ARB, t->tex);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glGetTexImage(
+        GL_TEXTURE_RECTANGLE_ARB, 0, GL_RED,
+        GL_UNSIGNED_BYTE, pixels);
+    CHK_OGL;
     
+    return pixels;
+}
+
+texInfo* createEmptyTexture(glContextObj cgl_ctx, GLenum format, size_t w, size_t h)
+{
+    texInfo* t = calloc(1, sizeof(texInfo));
+    
+    t->format = format;
     t->w = w;
     t->h = h;
     
@@ -75,13 +100,75 @@ texInfo* createEmptyTexture(CGLContextObj cgl_ctx, GLenum format, size_t w, size
     glTexParameterf(GL_TEXTURE_RECTANGLE_ARB, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexImage2D(
         GL_TEXTURE_RECTANGLE_ARB, 0, format, t->w, t->h,
-        0, GL_BGRA_EXT, GL_UNSIGNED_INT_8_8_8_8_REV, NULL);
+        0, texturePixelFormat(format), texturePixelType(format), NULL);
     CHK_OGL;
     
     return t;
 }
 
-void saveTexture(CGLContextObj cgl_ctx, texInfo* t, char* pathBytes)
+GLenum floatTextureFormat(size_t numChannels)
+{
+    switch (numChannels)
+    {
+    case 1:
+        return GL_R32F;
+    case 2:
+        return GL_RG32F;
+    default:
+        /* no renderable RGB32F, so 3 channels are padded out to 4 */
+        return GL_RGBA32F_ARB;
+    }
+}
+
+GLenum halfTextureFormat(size_t numChannels)
+{
+    switch (numChannels)
+    {
+    case 1:
+        return GL_R16F;
+    case 2:
+        return GL_RG16F;
+    default:
+        return GL_RGBA16F_ARB;
+    }
+}
+
+GLenum texturePixelFormat(GLenum format)
+{
+    switch (format)
+    {
+    case GL_R32F:
+    case GL_R16F:
+        return GL_RED;
+    case GL_RG32F:
+    case GL_RG16F:
+        return GL_RG;
+    case GL_RGBA32F_ARB:
+    case GL_RGBA16F_ARB:
+        return GL_RGBA;
+    default:
+        return GL_BGRA_EXT;
+    }
+}
+
+GLenum texturePixelType(GLenum format)
+{
+    switch (format)
+    {
+    case GL_R32F:
+    case GL_RG32F:
+    case GL_RGBA32F_ARB:
+        return GL_FLOAT;
+    case GL_R16F:
+    case GL_RG16F:
+    case GL_RGBA16F_ARB:
+        return GL_HALF_FLOAT_ARB;
+    default:
+        return GL_UNSIGNED_INT_8_8_8_8_REV;
+    }
+}
+
+void saveTexture(glContextObj cgl_ctx, texInfo* t, char* pathBytes)
 {
     void* texDataBase = malloc(4 * t->w * t->h);
     glBindTexture(GL_TEXTURE_RECTANGLE_ARB, t->tex);
@@ -90,15 +177,13 @@ void saveTexture(CGLContextObj cgl_ctx, texInfo* t, char* pathBytes)
         GL_UNSIGNED_INT_8_8_8_8_REV, texDataBase);
     CHK_OGL;
     
-    CFMutableDataRef cfData = CFDataCreateMutable(NULL, t->w * t->h * 4);
-    CFDataSetLength(cfData, t->w * t->h * 4);
+    void* imgDataBase = malloc(t->aW * t->aH * t->aC);
     
     size_t texPixelLen = 4;
     size_t imgPixelLen = t->aC;
     
     size_t texRowSkip = texPixelLen * (t->w - t->aW);
     
-    void* imgDataBase = CFDataGetMutableBytePtr(cfData);
     void* imgDataPtr = imgDataBase;
     void* texDataPtr = texDataBase;
     size_t i, j;
@@ -113,46 +198,31 @@ void saveTexture(CGLContextObj cgl_ctx, texInfo* t, char* pathBytes)
         texDataPtr += texRowSkip;
     }
     
-    CGColorSpaceRef colorspace;
-    CGBitmapInfo bitmapInfo;
+    imageWriteOptions wo;
+    initImageWriteOptions(&wo);
     char* errorString;
+    const char* failure = NULL;
     switch (t->aC)
     {
     case 1:
-        colorspace = CGColorSpaceCreateDeviceGray();
-        bitmapInfo = kCGBitmapByteOrderDefault;
+        failure = writeGrayImage(pathBytes, imgDataBase, t->aW, t->aH, t->aW, &wo);
         break;
     case 4:
-        colorspace = CGColorSpaceCreateDeviceRGB();
-        bitmapInfo = kCGBitmapByteOrder32Host | kCGImageAlphaFirst;
+        writeBGRAImage(pathBytes, imgDataBase, t->aW, t->aH, &wo);
         break;
     default:
-        asprintf(&errorString, "%d", t->aC);
+        asprintf(&errorString, "%d", (int)t->aC);
         ERR("unsupported number of channels", errorString);
     }
-    
-    CGDataProviderRef dataProvider = CGDataProviderCreateWithCFData(cfData);
-    CGImageRef resultImg = CGImageCreate(
-        t->aW, t->aH, 8, t->aC * 8, t->aC * t->aW, colorspace, bitmapInfo,
-        dataProvider, NULL, false, kCGRenderingIntentDefault);
-    CFURLRef url = CFURLCreateFromFileSystemRepresentation(
-        NULL, (unsigned char*)pathBytes, strlen(pathBytes), false);
-    CGImageDestinationRef imgDst = CGImageDestinationCreateWithURL(url, kUTTypePNG, 1, NULL);
-    CGImageDestinationAddImage(imgDst, resultImg, NULL);
-    CGImageDestinationFinalize(imgDst);
+    if (failure != NULL) ERR((char*)failure, pathBytes);
     
     printf("wrote texture as PNG: %s (%d x %d, %d channels)\n", pathBytes, t->aW, t->aH, t->aC);
     
     free(texDataBase);
-    CFRelease(cfData);
-    CGDataProviderRelease(dataProvider);
-    CGColorSpaceRelease(colorspace);
-    CGImageRelease(resultImg);
-    CFRelease(url);
-    CFRelease(imgDst);
+    free(imgDataBase);
 }
 
-void saveFloatTexture(CGLContextObj cgl_ctx, texInfo* t, char* pathBytes)
+void saveFloatTexture(glContextObj cgl_ctx, texInfo* t, char* pathBytes, size_t tileSize)
 {
     void* texDataBase = malloc(sizeof(GLfloat) * 4 * t->w * t->h);
     glBindTexture(GL_TEXTURE_RECTANGLE_ARB, t->tex);
@@ -161,102 +231,319 @@ void saveFloatTexture(CGLContextObj cgl_ctx, texInfo* t, char* pathBytes)
         GL_FLOAT, texDataBase);
     CHK_OGL;
     
-    size_t cookedImgByteCount =
-          sizeof(struct floatImageHeader)
-        + t->aW * t->aH * t->aC * sizeof(GLfloat);
-    CFMutableDataRef cfData = CFDataCreateMutable(NULL, cookedImgByteCount);
-    CFDataSetLength(cfData, cookedImgByteCount);
-    void* imgBase = CFDataGetMutableBytePtr(cfData);
-    
-    struct floatImageHeader* imgHeaderBase = (struct floatImageHeader*)imgBase;
-    imgHeaderBase->sig[0] = '2'; /* little-endian signature */
-    imgHeaderBase->sig[1] = '3';
-    imgHeaderBase->sig[2] = 'l';
-    imgHeaderBase->sig[3] = 'f';
-    imgHeaderBase->numChannels = t->aC;
-    imgHeaderBase->w = t->aW;
-    imgHeaderBase->h = t->aH;
-    
-    size_t texPixelLen = sizeof(GLfloat) * 4;
-    size_t imgPixelLen = sizeof(GLfloat) * t->aC;
-    
-    size_t texRowSkip = texPixelLen * (t->w - t->aW);
-    
-    void* imgDataBase = imgBase + sizeof(struct floatImageHeader);
-    void* imgDataPtr = imgDataBase;
-    void* texDataPtr = texDataBase;
-    size_t i, j;
-    for (j = 0; j < t->aH; j++)
-    {
-        for (i = 0; i < t->aW; i++)
-        {
-            memcpy(imgDataPtr, texDataPtr, imgPixelLen);
-            imgDataPtr += imgPixelLen;
-            texDataPtr += texPixelLen;
-        }
-        texDataPtr += texRowSkip;
-    }
-    
-    CFURLRef url = CFURLCreateFromFileSystemRepresentation(
-        NULL, (unsigned char*)pathBytes, strlen(pathBytes), false);
-    Boolean success;
-    SInt32 errorCode;
-    success = CFURLWriteDataAndPropertiesToResource(url, cfData, NULL, &errorCode);
-    CHK_CFURL(success, errorCode);
+    writeFloatImage(pathBytes,
+        (GLfloat*)texDataBase, 4, 4 * t->w,
+        t->aC, t->aW, t->aH,
+        tileSize ? FL32_LAYOUT_TILED : FL32_LAYOUT_LINEAR, tileSize);
     
     printf("wrote texture as float dump: %s (%d x %d, %d channels)\n", pathBytes, t->aW, t->aH, t->aC);
     
     free(texDataBase);
-    CFRelease(cfData);
-    CFRelease(url);
 }
 
-void releaseTexture(CGLContextObj cgl_ctx, texInfo* t)
+void releaseTexture(glContextObj cgl_ctx, texInfo* t)
 {
     glDeleteTextures(1, &(t->tex));
     free(t);
 }
 
-GLuint loadProgram(CGLContextObj cgl_ctx, char* vertProgPath, char* fragProgPath)
-{
-    GLuint vertShader = loadShader(cgl_ctx, GL_VERTEX_SHADER, vertProgPath);
-    GLuint fragShader = loadShader(cgl_ctx, GL_FRAGMENT_SHADER, fragProgPath);
-    
-    GLuint program = glCreateProgram();
-    glAttachShader(program, vertShader);
-    glAttachShader(program, fragShader);
-    glLinkProgram(program);
-    printProgramInfoLog(cgl_ctx, program);
-    CHK_OGL;
-    return program;
-}
+/*
+ * shaders and programs
+ *
+ * Sources come from the copies embedded at build time, or from
+ * $FRACTURE_SHADER_DIR when set, for editing shaders without rebuilding.
+ * Linked programs are cached on disk with ARB_get_program_binary, keyed by
+ * a hash of the driver strings and the sources, in $FRACTURE_CACHE_DIR,
+ * else $XDG_CACHE_HOME/fracture, else ~/.cache/fracture. Anything that
+ * goes wrong with the cache just falls back to compiling.
+ */
 
-GLuint loadShader(CGLContextObj cgl_ctx, GLenum shaderType, char* filePath)
+static GLchar* createShaderSource(char* name, GLint* len)
 {
+    char* shaderDir = getenv("FRACTURE_SHADER_DIR");
+    if (shaderDir == NULL)
+    {
+        const embeddedShader* s;
+        for (s = embeddedShaders; s->name != NULL; s++)
+        {
+            if (strcmp(s->name, name) == 0)
+            {
+                GLchar* source = malloc(s->length);
+                memcpy(source, s->source, s->length);
+                *len = s->length;
+                return source;
+            }
+        }
+        ERR("no embedded shader", name);
+    }
+    
+    char* filePath;
+    asprintf(&filePath, "%s/%s", shaderDir, name);
     int fd;
     struct stat sb;
-    GLint len;
-    GLchar* base;
-    GLuint shader;
     
     fd = open(filePath, O_RDONLY);
     CHK_SYSCALL(fd, "open() failed", filePath);
     CHK_SYSCALL(fstat(fd, &sb), "fstat() failed", filePath);
     if (!S_ISREG(sb.st_mode)) ERR("not a regular file", filePath);
     if (sb.st_size == 0) ERR("file is empty", filePath);
-    base = (GLchar*)mmap(NULL, sb.st_size, PROT_READ, MAP_SHARED, fd, 0);
-    CHK_NULL(base, "mmap() failed", filePath);
-    len = sb.st_size;
+    GLchar* source = malloc(sb.st_size);
+    if (read(fd, source, sb.st_size) != sb.st_size) ERR("read() failed", filePath);
+    CHK_SYSCALL(close(fd), "close() failed", filePath);
+    *len = sb.st_size;
     
-    shader = glCreateShader(shaderType);
-    glShaderSource(shader, 1, (const GLchar**)&base, &len);
+    free(filePath);
+    return source;
+}
+
+static GLuint compileShader(glContextObj cgl_ctx, GLenum shaderType, GLchar* source, GLint len)
+{
+    GLuint shader = glCreateShader(shaderType);
+    glShaderSource(shader, 1, (const GLchar**)&source, &len);
     CHK_OGL;
     glCompileShader(shader);
     printShaderInfoLog(cgl_ctx, shader);
     CHK_OGL;
     
-    CHK_SYSCALL(munmap(base, len), "munmap() failed", filePath);
-    CHK_SYSCALL(close(fd), "close() failed", filePath);
+    return shader;
+}
+
+GLuint loadShader(glContextObj cgl_ctx, GLenum shaderType, char* name)
+{
+    GLint len;
+    GLchar* source = createShaderSource(name, &len);
+    GLuint shader = compileShader(cgl_ctx, shaderType, source, len);
+    free(source);
     
     return shader;
-}
\ No newline at end of file
+}
+
+#ifdef GL_ARB_get_program_binary
+/* 64-bit FNV-1a */
+static unsigned long long hashBytes(unsigned long long hash, const void* bytes, size_t len)
+{
+    const unsigned char* p = bytes;
+    size_t i;
+    for (i = 0; i < len; i++)
+    {
+        hash = (hash ^ p[i]) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static char* createProgramCachePath(glContextObj cgl_ctx,
+    size_t numShaders, GLenum* shaderTypes, GLchar** sources, GLint* lens)
+{
+    GLint numFormats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats);
+    CHK_OGL;
+    if (numFormats == 0)
+    {
+        return NULL;
+    }
+    
+    char* dir;
+    if (getenv("FRACTURE_CACHE_DIR") != NULL)
+    {
+        dir = strdup(getenv("FRACTURE_CACHE_DIR"));
+    }
+    else if (getenv("XDG_CACHE_HOME") != NULL)
+    {
+        asprintf(&dir, "%s/fracture", getenv("XDG_CACHE_HOME"));
+    }
+    else if (getenv("HOME") != NULL)
+    {
+        char* parent;
+        asprintf(&parent, "%s/.cache", getenv("HOME"));
+        mkdir(parent, 0755);
+        asprintf(&dir, "%s/fracture", parent);
+        free(parent);
+    }
+    else
+    {
+        return NULL;
+    }
+    mkdir(dir, 0755);
+    
+    GLenum strings[3] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+    unsigned long long hash = 0xcbf29ce484222325ULL;
+    size_t i;
+    for (i = 0; i < 3; i++)
+    {
+        const GLubyte* s = glGetString(strings[i]);
+        hash = hashBytes(hash, s, strlen((const char*)s) + 1);
+    }
+    for (i = 0; i < numShaders; i++)
+    {
+        hash = hashBytes(hash, &shaderTypes[i], sizeof(GLenum));
+        hash = hashBytes(hash, sources[i], lens[i]);
+    }
+    
+    char* path;
+    asprintf(&path, "%s/%016llx.bin", dir, hash);
+    free(dir);
+    return path;
+}
+
+/* returns GL_TRUE if program was linked from the cached binary */
+static GLboolean loadProgramBinary(glContextObj cgl_ctx, GLuint program, char* path)
+{
+    FILE* f = fopen(path, "rb");
+    if (f == NULL)
+    {
+        return GL_FALSE;
+    }
+    
+    GLboolean linked = GL_FALSE;
+    GLuint format;
+    long len;
+    if (fread(&format, sizeof(format), 1, f) == 1 &&
+        fseek(f, 0, SEEK_END) == 0 &&
+        (len = ftell(f) - (long)sizeof(format)) > 0 &&
+        fseek(f, sizeof(format), SEEK_SET) == 0)
+    {
+        void* binary = malloc(len);
+        if (fread(binary, 1, len, f) == (size_t)len)
+        {
+            expectGLErrors(cgl_ctx, GL_TRUE);
+            glProgramBinary(program, format, binary, len);
+            GLint status = GL_FALSE;
+            glGetProgramiv(program, GL_LINK_STATUS, &status);
+            linked = status == GL_TRUE;
+            expectGLErrors(cgl_ctx, GL_FALSE);
+        }
+        free(binary);
+    }
+    fclose(f);
+    
+    /* a format the driver no longer accepts is a GL error, not a failure */
+    while (glGetError() != GL_NO_ERROR);
+    
+    return linked;
+}
+
+/*
+ * written to a uniquely named temporary file and renamed, so concurrent
+ * encodes, in this process or another, never read or write a partial binary
+ */
+static void saveProgramBinary(glContextObj cgl_ctx, GLuint program, char* path)
+{
+    GLint len = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &len);
+    CHK_OGL;
+    if (len == 0)
+    {
+        return;
+    }
+    
+    void* binary = malloc(len);
+    GLenum format;
+    glGetProgramBinary(program, len, NULL, &format, binary);
+    CHK_OGL;
+    
+    char* tmpPath;
+    asprintf(&tmpPath, "%s.XXXXXX", path);
+    int fd = mkstemp(tmpPath);
+    FILE* f = fd >= 0 ? fdopen(fd, "wb") : NULL;
+    if (f == NULL && fd >= 0)
+    {
+        close(fd);
+        unlink(tmpPath);
+    }
+    if (f != NULL)
+    {
+        GLuint format32 = format;
+        GLboolean ok = fwrite(&format32, sizeof(format32), 1, f) == 1 &&
+            fwrite(binary, 1, len, f) == (size_t)len;
+        ok = fclose(f) == 0 && ok;
+        if (!ok || rename(tmpPath, path) != 0)
+        {
+            unlink(tmpPath);
+        }
+    }
+    
+    free(tmpPath);
+    free(binary);
+}
+#endif
+
+static GLuint buildProgram(glContextObj cgl_ctx,
+    size_t numShaders, GLenum* shaderTypes, char** names)
+{
+    GLchar* sources[2];
+    GLint lens[2];
+    size_t i;
+    for (i = 0; i < numShaders; i++)
+    {
+        sources[i] = createShaderSource(names[i], &lens[i]);
+    }
+    
+    GLuint program = glCreateProgram();
+    GLboolean linked = GL_FALSE;
+    
+#ifdef GL_ARB_get_program_binary
+    char* cachePath = createProgramCachePath(cgl_ctx, numShaders, shaderTypes, sources, lens);
+    if (cachePath != NULL)
+    {
+        linked = loadProgramBinary(cgl_ctx, program, cachePath);
+    }
+#endif
+    
+    if (!linked)
+    {
+        GLuint shaders[2];
+        for (i = 0; i < numShaders; i++)
+        {
+            shaders[i] = compileShader(cgl_ctx, shaderTypes[i], sources[i], lens[i]);
+            glAttachShader(program, shaders[i]);
+        }
+#ifdef GL_ARB_get_program_binary
+        if (cachePath != NULL)
+        {
+            glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        }
+#endif
+        glLinkProgram(program);
+        printProgramInfoLog(cgl_ctx, program);
+        CHK_OGL;
+        for (i = 0; i < numShaders; i++)
+        {
+            glDetachShader(program, shaders[i]);
+            glDeleteShader(shaders[i]);
+        }
+        CHK_OGL;
+        
+#ifdef GL_ARB_get_program_binary
+        if (cachePath != NULL)
+        {
+            saveProgramBinary(cgl_ctx, program, cachePath);
+        }
+#endif
+    }
+    
+#ifdef GL_ARB_get_program_binary
+    free(cachePath);
+#endif
+    for (i = 0; i < numShaders; i++)
+    {
+        free(sources[i]);
+    }
+    
+    return program;
+}
+
+GLuint loadProgram(glContextObj cgl_ctx, char* vertName, char* fragName)
+{
+    GLenum shaderTypes[2] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER };
+    char* names[2] = { vertName, fragName };
+    return buildProgram(cgl_ctx, 2, shaderTypes, names);
+}
+
+#ifdef GL_ARB_compute_shader
+GLuint loadComputeProgram(glContextObj cgl_ctx, char* compName)
+{
+    GLenum shaderTypes[1] = { GL_COMPUTE_SHADER };
+    char* names[1] = { compName };
+    return buildProgram(cgl_ctx, 1, shaderTypes, names);
+}
+#endif
@@ -3,10 +3,11 @@
 
 #include <stdlib.h>
 
-#include <OpenGL/OpenGL.h>
+#include "glcontext.h"
 
 typedef struct texInfo {
     GLuint tex;
+    GLenum format;
     size_t w;
     size_t h;
     size_t aW;
@@ -14,13 +15,22 @@ typedef struct texInfo {
     size_t aC;
 } texInfo;
 
-texInfo* createTextureFromPath(CGLContextObj cgl_ctx, char* pathBytes);
-texInfo* createEmptyTexture(CGLContextObj cgl_ctx, GLenum format, size_t w, size_t h);
-void saveTexture(CGLContextObj cgl_ctx, texInfo* t, char* pathBytes);
-void saveFloatTexture(CGLContextObj cgl_ctx, texInfo* t, char* pathBytes);
-void releaseTexture(CGLContextObj cgl_ctx, texInfo* t);
+texInfo* createTextureFromPath(glContextObj cgl_ctx, char* pathBytes);
+texInfo* createTextureFromGrayBytes(glContextObj cgl_ctx, const GLubyte* pixels, size_t w, size_t h, size_t stride);
+GLubyte* createGrayBytesFromTexture(glContextObj cgl_ctx, texInfo* t);
+texInfo* createEmptyTexture(glContextObj cgl_ctx, GLenum format, size_t w, size_t h);
+GLenum floatTextureFormat(size_t numChannels);
+GLenum halfTextureFormat(size_t numChannels);
+GLenum texturePixelFormat(GLenum format);
+GLenum texturePixelType(GLenum format);
+void saveTexture(glContextObj cgl_ctx, texInfo* t, char* pathBytes);
+void saveFloatTexture(glContextObj cgl_ctx, texInfo* t, char* pathBytes, size_t tileSize);
+void releaseTexture(glContextObj cgl_ctx, texInfo* t);
 
-GLuint loadProgram(CGLContextObj cgl_ctx, char* vertProgPath, char* fragProgPath);
-GLuint loadShader(CGLContextObj cgl_ctx, GLenum shaderType, char* filePath);
+GLuint loadProgram(glContextObj cgl_ctx, char* vertName, char* fragName);
+#ifdef GL_ARB_compute_shader
+GLuint loadComputeProgram(glContextObj cgl_ctx, char* compName);
+#endif
+GLuint loadShader(glContextObj cgl_ctx, GLenum shaderType, char* name);
 
 #endif
\ No newline at end of file
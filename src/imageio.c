@@ -0,0 +1,655 @@
+#include <stdio.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <png.h>
+#include <zlib.h>
+
+#include "errors.h"
+
+#include "imageio.h"
+
+static const char* fileExtension(const char* filePath)
+{
+    const char* dot = strrchr(filePath, '.');
+    const char* slash = strrchr(filePath, '/');
+    return dot != NULL && (slash == NULL || dot > slash) ? dot + 1 : "";
+}
+
+/*
+ * The loaders return NULL on success or a message naming what failed;
+ * loadGrayImage releases whatever a failed one left in img.
+ */
+
+static const char* mapGrayImageFile(grayImage* img, char* filePath)
+{
+    int fd;
+    struct stat sb;
+    
+    fd = open(filePath, O_RDONLY);
+    if (fd == -1) return "open() failed";
+    const char* failure = NULL;
+    if (fstat(fd, &sb) == -1) failure = "fstat() failed";
+    else if (!S_ISREG(sb.st_mode)) failure = "not a regular file";
+    else if (sb.st_size == 0) failure = "file is empty";
+    if (failure != NULL)
+    {
+        close(fd);
+        return failure;
+    }
+    void* base = mmap(NULL, sb.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) return "mmap() failed";
+    img->base = base;
+    img->len = sb.st_size;
+    img->mapped = 1;
+    
+    return NULL;
+}
+
+/* next decimal field of a PGM header, skipping whitespace and comments */
+static int parsePGMField(const char* base, size_t len, size_t* pos, size_t* value)
+{
+    while (*pos < len && (base[*pos] == '#' || base[*pos] == ' ' || base[*pos] == '\t' ||
+        base[*pos] == '\r' || base[*pos] == '\n'))
+    {
+        if (base[*pos] == '#')
+        {
+            while (*pos < len && base[*pos] != '\n')
+            {
+                (*pos)++;
+            }
+        }
+        else
+        {
+            (*pos)++;
+        }
+    }
+    if (*pos >= len || base[*pos] < '0' || base[*pos] > '9')
+    {
+        return 0;
+    }
+    *value = 0;
+    while (*pos < len && base[*pos] >= '0' && base[*pos] <= '9')
+    {
+        *value = 10 * *value + (base[(*pos)++] - '0');
+        if (*value > INT_MAX)
+        {
+            return 0;
+        }
+    }
+    
+    return 1;
+}
+
+static const char* mapPGM(grayImage* img, char* filePath)
+{
+    const char* failure = mapGrayImageFile(img, filePath);
+    if (failure != NULL) return failure;
+    const char* base = img->base;
+    if (img->len < 2 || base[0] != 'P' || base[1] != '5')
+    {
+        return "not a binary PGM";
+    }
+    size_t pos = 2;
+    size_t maxval;
+    if (!parsePGMField(base, img->len, &pos, &img->w) ||
+        !parsePGMField(base, img->len, &pos, &img->h) ||
+        !parsePGMField(base, img->len, &pos, &maxval))
+    {
+        return "bad PGM header";
+    }
+    if (maxval == 0 || maxval > 255) return "only 8-bit PGMs are supported";
+    
+    /* a single whitespace character separates the header from the samples */
+    pos++;
+    if (img->w == 0 || img->h == 0) return "bad PGM size";
+    if (pos > img->len || img->w > (img->len - pos) / img->h) return "truncated PGM";
+    img->data = (const uint8_t*)base + pos;
+    img->stride = img->w;
+    
+    return NULL;
+}
+
+static const char* mapRaw(grayImage* img, char* filePath)
+{
+    const char* suffix = strrchr(filePath, '_');
+    unsigned int w, h;
+    if (suffix == NULL || sscanf(suffix, "_%ux%u.", &w, &h) != 2)
+    {
+        return "raw image names must end in _<w>x<h>.raw";
+    }
+    const char* failure = mapGrayImageFile(img, filePath);
+    if (failure != NULL) return failure;
+    if (w == 0 || h == 0 || w > INT_MAX || h > INT_MAX) return "bad raw image size";
+    if (img->len != (size_t)w * h) return "raw image size does not match its name";
+    img->w = w;
+    img->h = h;
+    img->data = img->base;
+    img->stride = w;
+    
+    return NULL;
+}
+
+/* one channel straight from grayscale sources, the red channel from color ones */
+static const char* readPNG(grayImage* img, char* filePath)
+{
+    FILE* f = fopen(filePath, "rb");
+    if (f == NULL) return "fopen() failed";
+    png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    png_infop info = png != NULL ? png_create_info_struct(png) : NULL;
+    if (info == NULL)
+    {
+        png_destroy_read_struct(&png, NULL, NULL);
+        fclose(f);
+        return "png_create_read_struct() failed";
+    }
+    
+    /* everything allocated below is released here when libpng bails out */
+    uint8_t* volatile pixels = NULL;
+    uint8_t* volatile buffer = NULL;
+    png_bytep* volatile rows = NULL;
+    if (setjmp(png_jmpbuf(png)))
+    {
+        free(pixels);
+        free(buffer);
+        free(rows);
+        png_destroy_read_struct(&png, &info, NULL);
+        fclose(f);
+        return "PNG decode failed";
+    }
+    png_init_io(png, f);
+    png_read_info(png, info);
+    
+    int colorType = png_get_color_type(png, info);
+    int bitDepth = png_get_bit_depth(png, info);
+    if (bitDepth == 16) png_set_strip_16(png);
+    if (colorType == PNG_COLOR_TYPE_PALETTE) png_set_palette_to_rgb(png);
+    if (colorType == PNG_COLOR_TYPE_GRAY && bitDepth < 8) png_set_expand_gray_1_2_4_to_8(png);
+    if (colorType & PNG_COLOR_MASK_ALPHA) png_set_strip_alpha(png);
+    int numPasses = png_set_interlace_handling(png);
+    png_read_update_info(png, info);
+    
+    size_t w = png_get_image_width(png, info);
+    size_t h = png_get_image_height(png, info);
+    size_t numChannels = png_get_channels(png, info);
+    size_t rowBytes = png_get_rowbytes(png, info);
+    pixels = malloc(w * h);
+    
+    size_t x, y;
+    if (numChannels == 1)
+    {
+        rows = malloc(h * sizeof(png_bytep));
+        for (y = 0; y < h; y++)
+        {
+            rows[y] = pixels + y * w;
+        }
+        png_read_image(png, rows);
+    }
+    else if (numPasses > 1)
+    {
+        /* interlaced passes revisit every row, so read the whole image first */
+        buffer = malloc(h * rowBytes);
+        rows = malloc(h * sizeof(png_bytep));
+        for (y = 0; y < h; y++)
+        {
+            rows[y] = buffer + y * rowBytes;
+        }
+        png_read_image(png, rows);
+        for (y = 0; y < h; y++)
+        {
+            for (x = 0; x < w; x++)
+            {
+                pixels[y * w + x] = rows[y][x * numChannels];
+            }
+        }
+    }
+    else
+    {
+        buffer = malloc(rowBytes);
+        for (y = 0; y < h; y++)
+        {
+            png_read_row(png, buffer, NULL);
+            for (x = 0; x < w; x++)
+            {
+                pixels[y * w + x] = buffer[x * numChannels];
+            }
+        }
+    }
+    png_read_end(png, NULL);
+    png_destroy_read_struct(&png, &info, NULL);
+    fclose(f);
+    free(rows);
+    free(buffer);
+    
+    img->base = pixels;
+    img->len = w * h;
+    img->mapped = 0;
+    img->data = pixels;
+    img->w = w;
+    img->h = h;
+    img->stride = w;
+    
+    return NULL;
+}
+
+grayImage* loadGrayImage(char* filePath, const char** failure)
+{
+    grayImage* img = calloc(1, sizeof(grayImage));
+    const char* ext = fileExtension(filePath);
+    if      (strcasecmp("png", ext) == 0) *failure = readPNG(img, filePath);
+    else if (strcasecmp("pgm", ext) == 0) *failure = mapPGM(img, filePath);
+    else if (strcasecmp("raw", ext) == 0) *failure = mapRaw(img, filePath);
+    else *failure = "unknown image extension";
+    
+    if (*failure != NULL)
+    {
+        if (img->mapped)
+        {
+            munmap(img->base, img->len);
+        }
+        free(img);
+        return NULL;
+    }
+    
+    return img;
+}
+
+void releaseGrayImage(grayImage* img)
+{
+    if (img->mapped)
+    {
+        CHK_SYSCALL(munmap(img->base, img->len), "munmap() failed", "");
+    }
+    else
+    {
+        free(img->base);
+    }
+    free(img);
+}
+
+void initImageWriteOptions(imageWriteOptions* wo)
+{
+    wo->zlibLevel = Z_DEFAULT_COMPRESSION;
+    wo->numThreads = 1;
+}
+
+/*
+ * PNG encoder
+ */
+
+typedef struct pngBand {
+    const uint8_t* src;
+    size_t srcStride;
+    int bgra;           /* 4-channel sources are BGRA, PNG wants RGBA */
+    size_t numChannels;
+    size_t w;
+    size_t y0;
+    size_t y1;
+    int zlibLevel;
+    int last;           /* finishes the deflate stream */
+    
+    uint8_t* out;
+    size_t outLen;
+    uLong adler;
+    size_t filteredLen;
+} pngBand;
+
+static void copyPNGRow(const pngBand* b, size_t y, uint8_t* row)
+{
+    const uint8_t* src = b->src + y * b->srcStride;
+    if (!b->bgra)
+    {
+        memcpy(row, src, b->w * b->numChannels);
+        return;
+    }
+    size_t x;
+    for (x = 0; x < b->w; x++)
+    {
+        row[4 * x + 0] = src[4 * x + 2];
+        row[4 * x + 1] = src[4 * x + 1];
+        row[4 * x + 2] = src[4 * x + 0];
+        row[4 * x + 3] = src[4 * x + 3];
+    }
+}
+
+static uint8_t paethPredictor(int a, int b, int c)
+{
+    int p = a + b - c;
+    int pa = abs(p - a);
+    int pb = abs(p - b);
+    int pc = abs(p - c);
+    if (pa <= pb && pa <= pc) return a;
+    if (pb <= pc) return b;
+    return c;
+}
+
+/* filters cur into out, returning the sum of the filtered bytes as signed values */
+static size_t filterPNGRow(int type, const uint8_t* cur, const uint8_t* prev, size_t len, size_t bpp, uint8_t* out)
+{
+    size_t i;
+    switch (type)
+    {
+    case 0:
+        memcpy(out, cur, len);
+        break;
+    case 1:
+        for (i = 0; i < len; i++) out[i] = cur[i] - (i >= bpp ? cur[i - bpp] : 0);
+        break;
+    case 2:
+        for (i = 0; i < len; i++) out[i] = cur[i] - prev[i];
+        break;
+    case 3:
+        for (i = 0; i < len; i++) out[i] = cur[i] - (((i >= bpp ? cur[i - bpp] : 0) + prev[i]) >> 1);
+        break;
+    default:
+        for (i = 0; i < len; i++)
+        {
+            out[i] = cur[i] - (i >= bpp ?
+                paethPredictor(cur[i - bpp], prev[i], prev[i - bpp]) :
+                paethPredictor(0, prev[i], 0));
+        }
+        break;
+    }
+    
+    size_t cost = 0;
+    for (i = 0; i < len; i++)
+    {
+        cost += abs((int8_t)out[i]);
+    }
+    
+    return cost;
+}
+
+static void* compressPNGBand(void* arg)
+{
+    pngBand* b = arg;
+    size_t rowLen = b->w * b->numChannels;
+    uint8_t* prev = calloc(rowLen, 1);
+    uint8_t* cur = malloc(rowLen);
+    uint8_t* trial = malloc(rowLen);
+    b->filteredLen = (b->y1 - b->y0) * (1 + rowLen);
+    uint8_t* filtered = malloc(b->filteredLen);
+    
+    if (b->y0 > 0)
+    {
+        copyPNGRow(b, b->y0 - 1, prev);
+    }
+    
+    /* the usual heuristic: the filter with the smallest sum of absolute differences */
+    uint8_t* dst = filtered;
+    size_t y;
+    for (y = b->y0; y < b->y1; y++)
+    {
+        copyPNGRow(b, y, cur);
+        int bestType = 0;
+        size_t bestCost = filterPNGRow(0, cur, prev, rowLen, b->numChannels, dst + 1);
+        int type;
+        for (type = 1; type <= 4 && b->zlibLevel != 0; type++)
+        {
+            size_t cost = filterPNGRow(type, cur, prev, rowLen, b->numChannels, trial);
+            if (cost < bestCost)
+            {
+                bestCost = cost;
+                bestType = type;
+                memcpy(dst + 1, trial, rowLen);
+            }
+        }
+        dst[0] = bestType;
+        dst += 1 + rowLen;
+        
+        uint8_t* swap = prev;
+        prev = cur;
+        cur = swap;
+    }
+    
+    b->adler = adler32(adler32(0L, Z_NULL, 0), filtered, b->filteredLen);
+    
+    /* raw deflate, the caller adds the zlib header and checksum */
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if (deflateInit2(&zs, b->zlibLevel, Z_DEFLATED, -15, 8, Z_FILTERED) != Z_OK)
+    {
+        ERR("deflateInit2() failed", "");
+    }
+    size_t capacity = deflateBound(&zs, b->filteredLen) + 16;
+    b->out = malloc(capacity);
+    zs.next_in = filtered;
+    zs.avail_in = b->filteredLen;
+    zs.next_out = b->out;
+    zs.avail_out = capacity;
+    int status = deflate(&zs, b->last ? Z_FINISH : Z_SYNC_FLUSH);
+    if (status != (b->last ? Z_STREAM_END : Z_OK) || zs.avail_in != 0)
+    {
+        ERR("deflate() failed", "");
+    }
+    b->outLen = capacity - zs.avail_out;
+    deflateEnd(&zs);
+    
+    free(prev);
+    free(cur);
+    free(trial);
+    free(filtered);
+    
+    return NULL;
+}
+
+static void writeBigEndian32(uint8_t* dst, uint32_t v)
+{
+    dst[0] = v >> 24;
+    dst[1] = v >> 16;
+    dst[2] = v >> 8;
+    dst[3] = v;
+}
+
+static int writePNGChunk(FILE* f, const char* type, const uint8_t* data, size_t len)
+{
+    uint8_t header[8];
+    writeBigEndian32(header, len);
+    memcpy(header + 4, type, 4);
+    /* crc32() with a NULL buffer would return the initial value */
+    uLong typeCRC = crc32(crc32(0L, Z_NULL, 0), (const Bytef*)type, 4);
+    uint8_t crc[4];
+    writeBigEndian32(crc, len > 0 ? crc32(typeCRC, data, len) : typeCRC);
+    return fwrite(header, 1, 8, f) == 8 && fwrite(data, 1, len, f) == len && fwrite(crc, 1, 4, f) == 4;
+}
+
+static const char* writePNG(char* filePath,
+    const uint8_t* pixels, size_t w, size_t h, size_t stride, size_t numChannels,
+    const imageWriteOptions* wo)
+{
+    int level = wo->zlibLevel < 0 ? 6 : wo->zlibLevel;
+    size_t numBands = wo->numThreads < 1 ? 1 : (wo->numThreads > h ? h : wo->numThreads);
+    
+    pngBand* bands = calloc(numBands, sizeof(pngBand));
+    pthread_t* threads = malloc(numBands * sizeof(pthread_t));
+    size_t i;
+    for (i = 0; i < numBands; i++)
+    {
+        pngBand* b = &bands[i];
+        b->src = pixels;
+        b->srcStride = stride;
+        b->bgra = numChannels == 4;
+        b->numChannels = numChannels;
+        b->w = w;
+        b->y0 = h * i / numBands;
+        b->y1 = h * (i + 1) / numBands;
+        b->zlibLevel = level;
+        b->last = i == numBands - 1;
+        if (i > 0 && pthread_create(&threads[i], NULL, compressPNGBand, b) != 0)
+        {
+            ERR("pthread_create() failed", filePath);
+        }
+    }
+    compressPNGBand(&bands[0]);
+    for (i = 1; i < numBands; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+    
+    /* zlib header, the bands' deflate blocks in order, then the combined Adler-32 */
+    size_t idatLen = 2 + 4;
+    uLong adler = bands[0].adler;
+    for (i = 0; i < numBands; i++)
+    {
+        idatLen += bands[i].outLen;
+        if (i > 0)
+        {
+            adler = adler32_combine(adler, bands[i].adler, bands[i].filteredLen);
+        }
+    }
+    uint8_t* idat = malloc(idatLen);
+    int levelFlags = level < 2 ? 0 : (level < 6 ? 1 : (level == 6 ? 2 : 3));
+    idat[0] = 0x78;
+    idat[1] = levelFlags << 6;
+    idat[1] += 31 - (idat[0] * 256 + idat[1]) % 31;
+    size_t pos = 2;
+    for (i = 0; i < numBands; i++)
+    {
+        memcpy(idat + pos, bands[i].out, bands[i].outLen);
+        pos += bands[i].outLen;
+        free(bands[i].out);
+    }
+    writeBigEndian32(idat + pos, adler);
+    
+    uint8_t ihdr[13];
+    writeBigEndian32(ihdr, w);
+    writeBigEndian32(ihdr + 4, h);
+    ihdr[8] = 8;                                /* bit depth */
+    ihdr[9] = numChannels == 4 ? 6 : 0;         /* RGBA or gray */
+    ihdr[10] = 0;                               /* deflate */
+    ihdr[11] = 0;                               /* adaptive filtering */
+    ihdr[12] = 0;                               /* not interlaced */
+    
+    static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    const char* failure = NULL;
+    FILE* f = fopen(filePath, "wb");
+    if (f == NULL)
+    {
+        failure = "fopen() failed";
+    }
+    else
+    {
+        if (fwrite(signature, 1, 8, f) != 8 ||
+            !writePNGChunk(f, "IHDR", ihdr, sizeof(ihdr)) ||
+            !writePNGChunk(f, "IDAT", idat, idatLen) ||
+            !writePNGChunk(f, "IEND", NULL, 0))
+        {
+            failure = "fwrite() failed";
+        }
+        if (fclose(f) != 0 && failure == NULL)
+        {
+            failure = "fclose() failed";
+        }
+    }
+    
+    free(idat);
+    free(threads);
+    free(bands);
+    
+    return failure;
+}
+
+static int writeRows(FILE* f, const uint8_t* pixels, size_t rowLen, size_t h, size_t stride)
+{
+    size_t y;
+    for (y = 0; y < h; y++)
+    {
+        if (fwrite(pixels + y * stride, 1, rowLen, f) != rowLen) return 0;
+    }
+    
+    return 1;
+}
+
+const char* writeGrayImage(char* filePath,
+    const uint8_t* pixels, size_t w, size_t h, size_t stride,
+    const imageWriteOptions* wo)
+{
+    const char* ext = fileExtension(filePath);
+    if (strcasecmp("png", ext) == 0)
+    {
+        return writePNG(filePath, pixels, w, h, stride, 1, wo);
+    }
+    
+    if (strcasecmp("pgm", ext) != 0 && strcasecmp("raw", ext) != 0)
+    {
+        return "unknown image extension";
+    }
+    FILE* f = fopen(filePath, "wb");
+    if (f == NULL) return "fopen() failed";
+    const char* failure = NULL;
+    if ((strcasecmp("pgm", ext) == 0 && fprintf(f, "P5\n%d %d\n255\n", (int)w, (int)h) < 0) ||
+        !writeRows(f, pixels, w, h, stride))
+    {
+        failure = "fwrite() failed";
+    }
+    if (fclose(f) != 0 && failure == NULL)
+    {
+        failure = "fclose() failed";
+    }
+    
+    return failure;
+}
+
+uint8_t* createBGRAFromFile(char* filePath, size_t* w, size_t* h)
+{
+    if (strcasecmp("png", fileExtension(filePath)) != 0)
+    {
+        const char* failure;
+        grayImage* img = loadGrayImage(filePath, &failure);
+        CHK_NULL(img, (char*)failure, filePath);
+        *w = img->w;
+        *h = img->h;
+        uint8_t* data = malloc(4 * img->w * img->h);
+        size_t x, y;
+        for (y = 0; y < img->h; y++)
+        {
+            for (x = 0; x < img->w; x++)
+            {
+                uint8_t v = img->data[y * img->stride + x];
+                data[4 * (y * img->w + x) + 0] = v;
+                data[4 * (y * img->w + x) + 1] = v;
+                data[4 * (y * img->w + x) + 2] = v;
+                data[4 * (y * img->w + x) + 3] = 255;
+            }
+        }
+        releaseGrayImage(img);
+        
+        return data;
+    }
+    
+    png_image img;
+    memset(&img, 0, sizeof(img));
+    img.version = PNG_IMAGE_VERSION;
+    if (!png_image_begin_read_from_file(&img, filePath))
+    {
+        ERR(img.message, filePath);
+    }
+    img.format = PNG_FORMAT_BGRA;
+    *w = img.width;
+    *h = img.height;
+    void* data = malloc(PNG_IMAGE_SIZE(img));
+    if (!png_image_finish_read(&img, NULL, data, 0, NULL))
+    {
+        ERR(img.message, filePath);
+    }
+    
+    return data;
+}
+
+void writeBGRAImage(char* filePath, const uint8_t* pixels, size_t w, size_t h, const imageWriteOptions* wo)
+{
+    if (strcasecmp("png", fileExtension(filePath)) != 0)
+    {
+        ERR("BGRA images can only be written as PNG", filePath);
+    }
+    const char* failure = writePNG(filePath, pixels, w, h, 4 * w, 4, wo);
+    if (failure != NULL) ERR((char*)failure, filePath);
+}
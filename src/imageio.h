@@ -0,0 +1,51 @@
+#ifndef IMAGEIO_H
+#define IMAGEIO_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/*
+ * portable image files, chosen by extension
+ *
+ * .png   decoded by libpng, grayscale sources straight into one channel,
+ *        color sources reduced to their red channel row by row
+ * .pgm   binary (P5) 8-bit graymaps, memory-mapped
+ * .raw   headerless 8-bit samples, memory-mapped, with the size taken
+ *        from a "_<w>x<h>" name suffix as in data/lena_128x128
+ *
+ * PNGs are written by our own encoder: rows are filtered and deflated
+ * in bands, one thread per band, and the bands are joined with sync
+ * flushes into a single zlib stream.
+ */
+
+typedef struct grayImage {
+    void* base;         /* mapping or allocation holding the pixels */
+    size_t len;
+    int mapped;
+    const uint8_t* data;
+    size_t w;
+    size_t h;
+    size_t stride;      /* bytes between rows */
+} grayImage;
+
+/* NULL with a message in *failure when the file cannot be read */
+grayImage* loadGrayImage(char* filePath, const char** failure);
+void releaseGrayImage(grayImage* img);
+
+typedef struct imageWriteOptions {
+    int zlibLevel;      /* 0 to 9, or -1 for zlib's default */
+    size_t numThreads;  /* PNG bands filtered and compressed at once */
+} imageWriteOptions;
+
+void initImageWriteOptions(imageWriteOptions* wo);
+
+/* returns NULL on success, or a message */
+const char* writeGrayImage(char* filePath,
+    const uint8_t* pixels, size_t w, size_t h, size_t stride,
+    const imageWriteOptions* wo);
+
+/* 8-bit BGRA, as textures are read back */
+uint8_t* createBGRAFromFile(char* filePath, size_t* w, size_t* h);
+void writeBGRAImage(char* filePath, const uint8_t* pixels, size_t w, size_t h, const imageWriteOptions* wo);
+
+#endif
@@ -0,0 +1,1197 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "glcontext.h"
+
+#include "errors.h"
+#include "glio.h"
+#include "transform.h"
+#include "cpuenc.h"
+#include "gemmenc.h"
+#include "rangecache.h"
+#include "computeenc.h"
+#include "glenc.h"
+#include "gldec.h"
+
+#include "fracture.h"
+
+struct fractureContext {
+    fractureOptions options;
+    glBackend* backend;
+    glContextObj cgl_ctx;       /* NULL for the CPU engines */
+    glEncoder* ge;              /* GL engine only */
+    computeEncoder* ce;         /* compute engine only */
+    glDecoder* gd;              /* created by the first GPU decode */
+};
+
+void initFractureOptions(fractureOptions* opts)
+{
+    memset(opts, 0, sizeof(fractureOptions));
+    opts->backend = NULL;
+    opts->engine = ENGINE_GL;
+    opts->precision = PRECISION_FP32;
+    opts->cullRMS = 0.0;
+}
+
+/* NULL for options that work together, or what is wrong with them */
+static const char* checkFractureOptions(const fractureOptions* opts)
+{
+    if (opts->coarseCandidates > 0 && opts->engine != ENGINE_INT)
+    {
+        return "coarse search needs the int engine";
+    }
+    if (opts->spiral && (opts->engine != ENGINE_INT || opts->coarseCandidates > 0))
+    {
+        return "spiral search needs the int engine and no coarse search";
+    }
+    if (opts->isometries && opts->engine != ENGINE_INT)
+    {
+        return "isometries need the int engine";
+    }
+    if (opts->domainStep > 0 && opts->engine != ENGINE_INT && opts->engine != ENGINE_GEMM)
+    {
+        return "a domain step needs the int or gemm engine";
+    }
+    if (opts->cacheLevels != 0 && (opts->cacheLevels < MIN_RANGE_CACHE_LEVELS || opts->cacheLevels > MAX_RANGE_CACHE_LEVELS))
+    {
+        return "range cache levels must be 2 to 254";
+    }
+    if (opts->cacheLevels > 0 && opts->engine != ENGINE_GL && opts->engine != ENGINE_INT)
+    {
+        return "range cache needs the gl or int engine";
+    }
+    if (opts->fixedParents && (opts->coarseCandidates > 0 || opts->spiral || opts->cacheLevels > 0 || opts->budgetSeconds > 0.0 || opts->budgetSearches > 0))
+    {
+        return "fixed parents need no coarse search or budget";
+    }
+    if (opts->snapshotInterval > 0.0 && opts->budgetSeconds <= 0.0 && opts->budgetSearches == 0)
+    {
+        return "snapshots need a budget or searches";
+    }
+    
+    return NULL;
+}
+
+fractureContext* createFractureContext(const fractureOptions* opts, const char** failure)
+{
+    *failure = checkFractureOptions(opts);
+    if (*failure != NULL)
+    {
+        return NULL;
+    }
+    
+    glBackend* backend = NULL;
+    if (opts->engine == ENGINE_GL || opts->engine == ENGINE_COMPUTE)
+    {
+        backend = findGLBackend(opts->backend);
+        if (backend == NULL)
+        {
+            *failure = "unknown GL backend";
+            return NULL;
+        }
+    }
+    
+    fractureContext* fc = calloc(1, sizeof(fractureContext));
+    fc->options = *opts;
+    
+    if (backend != NULL)
+    {
+        fc->backend = backend;
+        fc->cgl_ctx = backend->createContext(failure);
+        if (fc->cgl_ctx == NULL)
+        {
+            free(fc);
+            return NULL;
+        }
+    }
+    if (opts->engine == ENGINE_GL)
+    {
+        fc->ge = createGLEncoder(fc->cgl_ctx);
+        fc->ge->cullRMS = opts->cullRMS;
+    }
+    if (opts->engine == ENGINE_COMPUTE)
+    {
+        fc->ce = createComputeEncoder(fc->cgl_ctx);
+        if (fc->ce == NULL)
+        {
+            *failure = "compute shaders not supported by this OpenGL";
+            releaseFractureContext(fc);
+            return NULL;
+        }
+    }
+    if (fc->cgl_ctx != NULL)
+    {
+        fc->backend->clearCurrent(fc->cgl_ctx);
+    }
+    
+    return fc;
+}
+
+void releaseFractureContext(fractureContext* fc)
+{
+    if (fc->cgl_ctx != NULL)
+    {
+        fc->backend->makeCurrent(fc->cgl_ctx);
+        if (fc->ge != NULL)
+        {
+            releaseGLEncoder(fc->ge);
+        }
+        if (fc->ce != NULL)
+        {
+            releaseComputeEncoder(fc->ce);
+        }
+        if (fc->gd != NULL)
+        {
+            releaseGLDecoder(fc->gd);
+        }
+        fc->backend->releaseContext(fc->cgl_ctx);
+    }
+    free(fc);
+}
+
+static void reportProgress(fractureContext* fc, size_t rowsDone, size_t rows)
+{
+    if (fc->options.progress != NULL)
+    {
+        fc->options.progress(fc->options.userData, rowsDone, rows);
+    }
+}
+
+/* refits range (r_i, r_j) to the domain cached for its shape, returning 0 when it must be searched */
+static int refitCached(rangeCache* cache, cpuEncodeData* ced, fractureEncoding* enc,
+    size_t r_i, size_t r_j)
+{
+    size_t r = r_j * enc->rangeCols + r_i;
+    size_t d_i, d_j;
+    if (cache == NULL || !findRangeDomain(cache, ced, r, &d_i, &d_j))
+    {
+        return 0;
+    }
+    
+    cpuSearchRangeNear(ced, r_i, r_j, d_i, d_j, 0, &enc->transforms[r]);
+    enc->cacheHits++;
+    return 1;
+}
+
+/*
+ * With transformsT, results are copied into it on the GPU instead of read
+ * back into enc->transforms, and the fp16 check is skipped. With
+ * searchMask, only ranges flagged in it are searched. With ced and the
+ * range cache on, cache hits are refit on the CPU instead. With
+ * levelData, from createEncodeDataLevels, it is searched instead of
+ * building encodeData for this image alone, and left to the caller.
+ */
+static void encodeGL(fractureContext* fc, fractureEncoding* enc, texInfo* srcImgT, texInfo* transformsT,
+    const uint8_t* searchMask, cpuEncodeData* ced, encodeData* levelData)
+{
+    glEncoder* ge = fc->ge;
+    int precision = fc->options.precision;
+    rangeCache* cache = NULL;
+    if (ced != NULL && transformsT == NULL && fc->options.cacheLevels > 0)
+    {
+        cache = createRangeCache(ced, fc->options.cacheLevels);
+    }
+    
+    resizeGLEncoder(ge, enc->w, enc->h);
+    
+    encodeData* ed32 = NULL;
+    ge->halfStorage = precision != PRECISION_FP32;
+    encodeData* ed = levelData;
+    if (ed == NULL)
+    {
+        ed = createEncodeData(ge, srcImgT, enc->d_size, enc->r_size);
+    }
+    if (precision == PRECISION_FP16_CHECK && transformsT == NULL)
+    {
+        ge->halfStorage = GL_FALSE;
+        ed32 = createEncodeData(ge, srcImgT, enc->d_size, enc->r_size);
+    }
+    ge->originXMult = ed->sumD_sumD2_T->aH;
+    
+    size_t r_i, r_j;
+    for (r_j = 0; r_j < enc->rangeRows; r_j++)
+    {
+        for (r_i = 0; r_i < enc->rangeCols; r_i++)
+        {
+            if (searchMask != NULL && !searchMask[r_j * enc->rangeCols + r_i])
+            {
+                continue;
+            }
+            
+            if (refitCached(cache, ced, enc, r_i, r_j))
+            {
+                continue;
+            }
+            
+            ge->halfStorage = precision != PRECISION_FP32;
+            if (transformsT != NULL)
+            {
+                searchRangeToTexture(ge, ed, enc->r_size, r_i, r_j, transformsT);
+                continue;
+            }
+            
+            rangeTransform* t = &enc->transforms[r_j * enc->rangeCols + r_i];
+            searchRange(ge, ed, enc->r_size, r_i, r_j, t);
+            if (cache != NULL)
+            {
+                cacheRangeDomain(cache, t->d_i, t->d_j);
+            }
+            
+            if (ed32 != NULL)
+            {
+                rangeTransform t32;
+                ge->halfStorage = GL_FALSE;
+                searchRange(ge, ed32, enc->r_size, r_i, r_j, &t32);
+                if (t32.d_i != t->d_i || t32.d_j != t->d_j)
+                {
+                    enc->fp16Mismatches++;
+                }
+            }
+        }
+        
+        reportProgress(fc, 1 + r_j, enc->rangeRows);
+    }
+    
+    if (ed->cullDepths != NULL)
+    {
+        size_t numDomains = ed->sumD_sumD2_T->aW * ed->sumD_sumD2_T->aH;
+        enc->culledFraction = (double)ed->numCulled / (numDomains * enc->rangeCols * enc->rangeRows);
+    }
+    if (ed32 != NULL)
+    {
+        releaseEncodeData(ge, ed32);
+    }
+    if (levelData == NULL)
+    {
+        releaseEncodeData(ge, ed);
+    }
+    if (cache != NULL)
+    {
+        releaseRangeCache(cache);
+    }
+}
+
+const char* checkFractureBlockSizes(const fractureContext* fc,
+    size_t w, size_t h, size_t d_size, size_t r_size)
+{
+    size_t ratio = r_size > 0 ? d_size / r_size : 0;
+    if (r_size == 0 || d_size < r_size || d_size % r_size != 0 || (ratio & (ratio - 1)) != 0)
+    {
+        return "d_size must be r_size times a power of two";
+    }
+    if (w < d_size || h < d_size)
+    {
+        return "image smaller than a domain block";
+    }
+    
+    /* the int kernels, and the compute shader, are written for blocks of at most 8x8 */
+    const fractureOptions* opts = &fc->options;
+    int glOnly = opts->engine == ENGINE_GL && opts->cacheLevels == 0 && !opts->fixedParents &&
+        opts->budgetSeconds <= 0.0 && opts->budgetSearches == 0;
+    if (!glOnly && r_size > 8)
+    {
+        return "r_size above 8 needs the gl engine without budgets, range cache or fixed parents";
+    }
+    if (opts->engine == ENGINE_GL && (r_size < 2 || (r_size & (r_size - 1)) != 0))
+    {
+        return "the gl engine needs r_size a power of two of at least 2";
+    }
+    if (opts->coarseCandidates > 0 && r_size < 4)
+    {
+        return "coarse search needs r_size >= 4";
+    }
+    
+    return NULL;
+}
+
+static fractureEncoding* createFractureEncoding(const fractureContext* fc,
+    size_t w, size_t h, size_t d_size, size_t r_size, size_t d_step)
+{
+    const char* failure = checkFractureBlockSizes(fc, w, h, d_size, r_size);
+    if (failure != NULL)
+    {
+        ERR((char*)failure, "");
+    }
+    
+    fractureEncoding* enc = calloc(1, sizeof(fractureEncoding));
+    enc->w = w;
+    enc->h = h;
+    enc->d_size = d_size;
+    enc->r_size = r_size;
+    enc->d_step = d_step;
+    enc->rangeCols = w / r_size;
+    enc->rangeRows = h / r_size;
+    enc->transforms = malloc(enc->rangeCols * enc->rangeRows * sizeof(rangeTransform));
+    
+    return enc;
+}
+
+/* the context's domain step, r_size to tile the decimated image */
+static size_t domainStep(const fractureContext* fc, size_t r_size)
+{
+    return fc->options.domainStep > 0 ? fc->options.domainStep : r_size;
+}
+
+/* the int kernels' data for the image enc is about to hold */
+static cpuEncodeData* createImageEncodeData(fractureContext* fc, const fractureEncoding* enc,
+    const uint8_t* pixels, size_t stride)
+{
+    cpuEncodeData* ced = createCPUEncodeData(pixels, enc->w, enc->h, stride, enc->d_size, enc->r_size, enc->d_step);
+    if (fc->options.isometries)
+    {
+        createIsometryBlocks(ced);
+    }
+    
+    return ced;
+}
+
+/* the domain block at range (r_i, r_j)'s position in the decimated image */
+static void parentDomain(const cpuEncodeData* ced, const fractureEncoding* enc,
+    size_t r_i, size_t r_j, size_t* d_i, size_t* d_j)
+{
+    *d_i = r_i * enc->r_size * enc->r_size / enc->d_size / enc->d_step;
+    *d_j = r_j * enc->r_size * enc->r_size / enc->d_size / enc->d_step;
+    if (*d_i >= ced->domainCols) *d_i = ced->domainCols - 1;
+    if (*d_j >= ced->domainRows) *d_j = ced->domainRows - 1;
+}
+
+/* fits each flagged range to the domain block enclosing it, or the best within radius of that */
+static void fitParents(cpuEncodeData* ced, fractureEncoding* enc,
+    size_t radius, const uint8_t* searchMask)
+{
+    size_t r_i, r_j;
+    for (r_j = 0; r_j < enc->rangeRows; r_j++)
+    {
+        for (r_i = 0; r_i < enc->rangeCols; r_i++)
+        {
+            size_t r = r_j * enc->rangeCols + r_i;
+            if (searchMask != NULL && !searchMask[r])
+            {
+                continue;
+            }
+            
+            size_t d_i, d_j;
+            parentDomain(ced, enc, r_i, r_j, &d_i, &d_j);
+            cpuSearchRangeNear(ced, r_i, r_j, d_i, d_j, radius, &enc->transforms[r]);
+        }
+    }
+}
+
+/* one range with the int kernels, as the context's options ask */
+static void cpuSearch(fractureContext* fc, fractureEncoding* enc, cpuEncodeData* ced,
+    size_t r_i, size_t r_j, rangeTransform* t)
+{
+    const fractureOptions* opts = &fc->options;
+    if (opts->spiral)
+    {
+        size_t d_i, d_j;
+        parentDomain(ced, enc, r_i, r_j, &d_i, &d_j);
+        enc->domainsExamined += cpuSearchRangeSpiral(ced, r_i, r_j, d_i, d_j,
+            opts->spiralMaxDomains, opts->spiralStopMSE, opts->spiralStopRelative, t);
+    }
+    else if (opts->coarseCandidates > 0)
+    {
+        cpuSearchRangeCoarse(ced, r_i, r_j, opts->coarseCandidates, t);
+    }
+    else
+    {
+        cpuSearchRange(ced, r_i, r_j, t);
+    }
+}
+
+/*
+ * Searches the ranges flagged in searchMask, or all of them when it is
+ * NULL, with the context's engine. ced is the image's CPU encode data when
+ * the caller already has it. With a mask, the gemm engine searches one
+ * range at a time with the integer kernels, and the compute engine still
+ * searches everything but keeps only the flagged ranges.
+ */
+static void searchRanges(fractureContext* fc, fractureEncoding* enc,
+    const uint8_t* pixels, size_t stride,
+    cpuEncodeData* ced, const uint8_t* searchMask)
+{
+    size_t numRanges = enc->rangeCols * enc->rangeRows;
+    
+    if (fc->options.fixedParents)
+    {
+        cpuEncodeData* ownCED = NULL;
+        if (ced == NULL)
+        {
+            ced = ownCED = createImageEncodeData(fc, enc, pixels, stride);
+        }
+        fitParents(ced, enc, fc->options.parentRadius, searchMask);
+        reportProgress(fc, enc->rangeRows, enc->rangeRows);
+        if (ownCED != NULL)
+        {
+            releaseCPUEncodeData(ownCED);
+        }
+        
+        return;
+    }
+    
+    if (fc->options.engine == ENGINE_INT || fc->options.engine == ENGINE_GEMM)
+    {
+        cpuEncodeData* ownCED = NULL;
+        if (ced == NULL)
+        {
+            ced = ownCED = createImageEncodeData(fc, enc, pixels, stride);
+        }
+        if (fc->options.engine == ENGINE_GEMM && searchMask == NULL)
+        {
+            gemmEncodeData* ged = createGEMMEncodeData(ced);
+            gemmSearchAll(ged, enc->transforms);
+            releaseGEMMEncodeData(ged);
+            reportProgress(fc, enc->rangeRows, enc->rangeRows);
+        }
+        else
+        {
+            rangeCache* cache = NULL;
+            if (fc->options.cacheLevels > 0)
+            {
+                cache = createRangeCache(ced, fc->options.cacheLevels);
+            }
+            
+            size_t r_i, r_j;
+            for (r_j = 0; r_j < enc->rangeRows; r_j++)
+            {
+                for (r_i = 0; r_i < enc->rangeCols; r_i++)
+                {
+                    size_t r = r_j * enc->rangeCols + r_i;
+                    if (searchMask != NULL && !searchMask[r])
+                    {
+                        continue;
+                    }
+                    
+                    if (refitCached(cache, ced, enc, r_i, r_j))
+                    {
+                        continue;
+                    }
+                    
+                    rangeTransform* t = &enc->transforms[r];
+                    cpuSearch(fc, enc, ced, r_i, r_j, t);
+                    if (cache != NULL)
+                    {
+                        cacheRangeDomain(cache, t->d_i, t->d_j);
+                    }
+                    if (fc->options.coarseCandidates > 0 && fc->options.coarseCheck)
+                    {
+                        rangeTransform exact;
+                        cpuSearchRange(ced, r_i, r_j, &exact);
+                        if (exact.d_i != t->d_i || exact.d_j != t->d_j)
+                        {
+                            enc->coarseMisses++;
+                        }
+                        enc->coarseExcessMSE += (t->MSE - exact.MSE) / (enc->rangeCols * enc->rangeRows);
+                    }
+                }
+                reportProgress(fc, 1 + r_j, enc->rangeRows);
+            }
+            
+            if (cache != NULL)
+            {
+                releaseRangeCache(cache);
+            }
+        }
+        if (ownCED != NULL)
+        {
+            releaseCPUEncodeData(ownCED);
+        }
+        
+        return;
+    }
+    
+    glContextObj cgl_ctx = fc->cgl_ctx;
+    fc->backend->makeCurrent(cgl_ctx);
+    texInfo* srcImgT = createTextureFromGrayBytes(cgl_ctx, pixels, enc->w, enc->h, stride);
+    
+    if (fc->options.engine == ENGINE_COMPUTE)
+    {
+        rangeTransform* found = enc->transforms;
+        if (searchMask != NULL)
+        {
+            found = malloc(numRanges * sizeof(rangeTransform));
+        }
+        computeSearchAll(fc->ce, srcImgT, enc->d_size, enc->r_size, found);
+        if (searchMask != NULL)
+        {
+            size_t r;
+            for (r = 0; r < numRanges; r++)
+            {
+                if (searchMask[r])
+                {
+                    enc->transforms[r] = found[r];
+                }
+            }
+            free(found);
+        }
+        reportProgress(fc, enc->rangeRows, enc->rangeRows);
+    }
+    else
+    {
+        cpuEncodeData* ownCED = NULL;
+        if (ced == NULL && fc->options.cacheLevels > 0)
+        {
+            ced = ownCED = createImageEncodeData(fc, enc, pixels, stride);
+        }
+        encodeGL(fc, enc, srcImgT, NULL, searchMask, ced, NULL);
+        if (ownCED != NULL)
+        {
+            releaseCPUEncodeData(ownCED);
+        }
+    }
+    
+    releaseTexture(cgl_ctx, srcImgT);
+    fc->backend->clearCurrent(cgl_ctx);
+}
+
+static double monotonicSeconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+typedef struct rangeOrder {
+    float MSE;
+    size_t r;
+} rangeOrder;
+
+static int compareRangeOrderWorstFirst(const void* a, const void* b)
+{
+    float x = ((const rangeOrder*)a)->MSE;
+    float y = ((const rangeOrder*)b)->MSE;
+    return (x < y) - (x > y);
+}
+
+static void encodeAnytime(fractureContext* fc, fractureEncoding* enc,
+    const uint8_t* pixels, size_t stride)
+{
+    const fractureOptions* opts = &fc->options;
+    double start = monotonicSeconds();
+    double lastSnapshot = start;
+    size_t numRanges = enc->rangeCols * enc->rangeRows;
+    
+    /* a complete first answer: each range against the domains around its own position */
+    cpuEncodeData* ced = createImageEncodeData(fc, enc, pixels, stride);
+    fitParents(ced, enc, 1, NULL);
+    rangeOrder* order = malloc(numRanges * sizeof(rangeOrder));
+    size_t r;
+    for (r = 0; r < numRanges; r++)
+    {
+        order[r].MSE = enc->transforms[r].MSE;
+        order[r].r = r;
+    }
+    qsort(order, numRanges, sizeof(rangeOrder), compareRangeOrderWorstFirst);
+    
+    glContextObj cgl_ctx = fc->cgl_ctx;
+    texInfo* srcImgT = NULL;
+    encodeData* ed = NULL;
+    if (opts->engine == ENGINE_GL)
+    {
+        fc->backend->makeCurrent(cgl_ctx);
+        srcImgT = createTextureFromGrayBytes(cgl_ctx, pixels, enc->w, enc->h, stride);
+        resizeGLEncoder(fc->ge, enc->w, enc->h);
+        fc->ge->halfStorage = opts->precision != PRECISION_FP32;
+        ed = createEncodeData(fc->ge, srcImgT, enc->d_size, enc->r_size);
+    }
+    
+    /* then full searches, worst fit first, for as long as the budget lasts */
+    size_t i;
+    for (i = 0; i < numRanges; i++)
+    {
+        double now = monotonicSeconds();
+        if ((opts->budgetSeconds > 0.0 && now - start >= opts->budgetSeconds) ||
+            (opts->budgetSearches > 0 && i >= opts->budgetSearches))
+        {
+            break;
+        }
+        if (opts->snapshot != NULL && now - lastSnapshot >= opts->snapshotInterval)
+        {
+            opts->snapshot(opts->userData, enc);
+            lastSnapshot = now;
+        }
+        
+        r = order[i].r;
+        size_t r_i = r % enc->rangeCols;
+        size_t r_j = r / enc->rangeCols;
+        if (ed != NULL)
+        {
+            searchRange(fc->ge, ed, enc->r_size, r_i, r_j, &enc->transforms[r]);
+        }
+        else
+        {
+            cpuSearch(fc, enc, ced, r_i, r_j, &enc->transforms[r]);
+        }
+        enc->rangesSearched++;
+    }
+    
+    if (ed != NULL)
+    {
+        releaseEncodeData(fc->ge, ed);
+        releaseTexture(cgl_ctx, srcImgT);
+        fc->backend->clearCurrent(cgl_ctx);
+    }
+    free(order);
+    releaseCPUEncodeData(ced);
+}
+
+fractureEncoding* fractureEncode(fractureContext* fc,
+    const uint8_t* pixels, size_t w, size_t h, size_t stride,
+    size_t d_size, size_t r_size)
+{
+    fractureEncoding* enc = createFractureEncoding(fc, w, h, d_size, r_size, domainStep(fc, r_size));
+    if (fc->options.budgetSeconds > 0.0 || fc->options.budgetSearches > 0)
+    {
+        encodeAnytime(fc, enc, pixels, stride);
+        return enc;
+    }
+    
+    searchRanges(fc, enc, pixels, stride, NULL, NULL);
+    enc->rangesSearched = enc->rangeCols * enc->rangeRows;
+    
+    return enc;
+}
+
+void fractureEncodeLevels(fractureContext* fc,
+    const uint8_t* pixels, size_t w, size_t h, size_t stride,
+    const size_t* d_sizes, const size_t* r_sizes, size_t count,
+    fractureEncoding** encs)
+{
+    size_t k;
+    if (fc->options.engine != ENGINE_GL || fc->options.fixedParents ||
+        fc->options.budgetSeconds > 0.0 || fc->options.budgetSearches > 0)
+    {
+        for (k = 0; k < count; k++)
+        {
+            encs[k] = fractureEncode(fc, pixels, w, h, stride, d_sizes[k], r_sizes[k]);
+        }
+        
+        return;
+    }
+    
+    /* every level's sizes are checked before any GL work */
+    for (k = 0; k < count; k++)
+    {
+        encs[k] = createFractureEncoding(fc, w, h, d_sizes[k], r_sizes[k], domainStep(fc, r_sizes[k]));
+    }
+    
+    glContextObj cgl_ctx = fc->cgl_ctx;
+    fc->backend->makeCurrent(cgl_ctx);
+    texInfo* srcImgT = createTextureFromGrayBytes(cgl_ctx, pixels, w, h, stride);
+    
+    glEncoder* ge = fc->ge;
+    resizeGLEncoder(ge, w, h);
+    ge->halfStorage = fc->options.precision != PRECISION_FP32;
+    encodeData** eds = malloc(count * sizeof(encodeData*));
+    createEncodeDataLevels(ge, srcImgT, d_sizes, r_sizes, count, eds);
+    
+    for (k = 0; k < count; k++)
+    {
+        fractureEncoding* enc = encs[k];
+        cpuEncodeData* ced = NULL;
+        if (fc->options.cacheLevels > 0)
+        {
+            ced = createImageEncodeData(fc, enc, pixels, stride);
+        }
+        encodeGL(fc, enc, srcImgT, NULL, NULL, ced, eds[k]);
+        enc->rangesSearched = enc->rangeCols * enc->rangeRows;
+        if (ced != NULL)
+        {
+            releaseCPUEncodeData(ced);
+        }
+    }
+    
+    /* the owner of the shared images last */
+    for (k = 0; k < count; k++)
+    {
+        if (eds[k]->sharedImages)
+        {
+            releaseEncodeData(ge, eds[k]);
+        }
+    }
+    for (k = 0; k < count; k++)
+    {
+        if (!eds[k]->sharedImages)
+        {
+            releaseEncodeData(ge, eds[k]);
+        }
+    }
+    free(eds);
+    
+    releaseTexture(cgl_ctx, srcImgT);
+    fc->backend->clearCurrent(cgl_ctx);
+}
+
+struct fractureSequence {
+    fractureContext* fc;
+    size_t d_size;
+    size_t r_size;
+    float changeThreshold;
+    size_t w, h;
+    uint8_t* prevPixels;            /* the previous frame, packed, NULL before the first */
+    rangeTransform* prevTransforms;
+    float* searchedMSE;             /* each range's MSE from its last full search */
+};
+
+fractureSequence* createFractureSequence(fractureContext* fc,
+    size_t d_size, size_t r_size,
+    float changeThreshold)
+{
+    fractureSequence* seq = calloc(1, sizeof(fractureSequence));
+    seq->fc = fc;
+    seq->d_size = d_size;
+    seq->r_size = r_size;
+    seq->changeThreshold = changeThreshold;
+    
+    return seq;
+}
+
+void releaseFractureSequence(fractureSequence* seq)
+{
+    free(seq->prevPixels);
+    free(seq->prevTransforms);
+    free(seq->searchedMSE);
+    free(seq);
+}
+
+/* sum of absolute differences between one range block of two frames */
+static size_t rangeSAD(const uint8_t* pixels, size_t stride,
+    const uint8_t* prevPixels, size_t w,
+    size_t r_size, size_t r_i, size_t r_j)
+{
+    size_t sad = 0;
+    size_t x, y;
+    for (y = r_j * r_size; y < (r_j + 1) * r_size; y++)
+    {
+        const uint8_t* row = pixels + y * stride;
+        const uint8_t* prevRow = prevPixels + y * w;
+        for (x = r_i * r_size; x < (r_i + 1) * r_size; x++)
+        {
+            sad += abs((int)row[x] - (int)prevRow[x]);
+        }
+    }
+    
+    return sad;
+}
+
+fractureEncoding* fractureEncodeFrame(fractureSequence* seq,
+    const uint8_t* pixels, size_t w, size_t h, size_t stride)
+{
+    fractureEncoding* enc = createFractureEncoding(seq->fc, w, h, seq->d_size, seq->r_size, domainStep(seq->fc, seq->r_size));
+    size_t numRanges = enc->rangeCols * enc->rangeRows;
+    
+    if (seq->prevPixels == NULL || w != seq->w || h != seq->h)
+    {
+        searchRanges(seq->fc, enc, pixels, stride, NULL, NULL);
+        enc->rangesSearched = numRanges;
+        
+        free(seq->prevPixels);
+        free(seq->prevTransforms);
+        free(seq->searchedMSE);
+        seq->w = w;
+        seq->h = h;
+        seq->prevPixels = malloc(w * h);
+        seq->prevTransforms = malloc(numRanges * sizeof(rangeTransform));
+        seq->searchedMSE = malloc(numRanges * sizeof(float));
+        size_t r;
+        for (r = 0; r < numRanges; r++)
+        {
+            seq->searchedMSE[r] = enc->transforms[r].MSE;
+        }
+    }
+    else
+    {
+        /*
+         * A range whose pixels moved by less than the threshold keeps the
+         * best of its previous domain and that domain's neighbours, refit
+         * to this frame. It is searched again if it moved more, or if the
+         * refit is worse than its last full search's fit by more than the
+         * threshold, so refits cannot drift a little further every frame.
+         */
+        cpuEncodeData* ced = createImageEncodeData(seq->fc, enc, pixels, stride);
+        uint8_t* searchMask = malloc(numRanges);
+        size_t maxSAD = seq->changeThreshold * seq->r_size * seq->r_size;
+        float maxMSEGrowth = (seq->changeThreshold / 255.0f) * (seq->changeThreshold / 255.0f);
+        size_t r_i, r_j;
+        for (r_j = 0; r_j < enc->rangeRows; r_j++)
+        {
+            for (r_i = 0; r_i < enc->rangeCols; r_i++)
+            {
+                size_t r = r_j * enc->rangeCols + r_i;
+                const rangeTransform* prev = &seq->prevTransforms[r];
+                rangeTransform* t = &enc->transforms[r];
+                searchMask[r] = rangeSAD(pixels, stride, seq->prevPixels, w, seq->r_size, r_i, r_j) > maxSAD;
+                if (!searchMask[r])
+                {
+                    cpuSearchRangeNear(ced, r_i, r_j, prev->d_i, prev->d_j, 1, t);
+                    searchMask[r] = t->MSE > seq->searchedMSE[r] + maxMSEGrowth;
+                }
+                enc->rangesSearched += searchMask[r];
+            }
+        }
+        
+        if (enc->rangesSearched > 0)
+        {
+            searchRanges(seq->fc, enc, pixels, stride, ced, searchMask);
+        }
+        size_t r;
+        for (r = 0; r < numRanges; r++)
+        {
+            if (searchMask[r])
+            {
+                seq->searchedMSE[r] = enc->transforms[r].MSE;
+            }
+        }
+        
+        free(searchMask);
+        releaseCPUEncodeData(ced);
+    }
+    
+    size_t y;
+    for (y = 0; y < h; y++)
+    {
+        memcpy(seq->prevPixels + y * w, pixels + y * stride, w);
+    }
+    memcpy(seq->prevTransforms, enc->transforms, numRanges * sizeof(rangeTransform));
+    
+    return enc;
+}
+
+void releaseFractureEncoding(fractureEncoding* enc)
+{
+    free(enc->transforms);
+    free(enc);
+}
+
+/* box filter by 2^m, as avgReduce in test/fpimage.py */
+static void averageReduce(const float* src, size_t w, size_t h, int m, float* dst)
+{
+    size_t b = (size_t)1 << m;
+    size_t dW = w >> m;
+    size_t dH = h >> m;
+    size_t x, y, i, j;
+    for (y = 0; y < dH; y++)
+    {
+        for (x = 0; x < dW; x++)
+        {
+            float sum = 0.0f;
+            for (j = 0; j < b; j++)
+            {
+                for (i = 0; i < b; i++)
+                {
+                    sum += src[(y * b + j) * w + x * b + i];
+                }
+            }
+            dst[y * dW + x] = sum / (b * b);
+        }
+    }
+}
+
+static uint8_t* quantizeDecoded(const float* R, size_t numPixels)
+{
+    uint8_t* pixels = malloc(numPixels);
+    size_t i;
+    for (i = 0; i < numPixels; i++)
+    {
+        float v = R[i] < 0.0f ? 0.0f : (R[i] > 1.0f ? 1.0f : R[i]);
+        pixels[i] = (uint8_t)(v * 255.0f + 0.5f);
+    }
+    
+    return pixels;
+}
+
+static uint8_t* decodeCPU(const fractureEncoding* enc,
+    size_t magExp, size_t iterations)
+{
+    size_t w = enc->w << magExp;
+    size_t h = enc->h << magExp;
+    size_t r_size = enc->r_size << magExp;
+    int m = 0;
+    while ((enc->r_size << m) < enc->d_size)
+    {
+        m++;
+    }
+    
+    float* R = malloc(w * h * sizeof(float));
+    float* D = malloc((w >> m) * (h >> m) * sizeof(float));
+    size_t i;
+    for (i = 0; i < w * h; i++)
+    {
+        R[i] = 0.5f;
+    }
+    
+    size_t iter;
+    for (iter = 0; iter < iterations; iter++)
+    {
+        averageReduce(R, w, h, m, D);
+        size_t dW = w >> m;
+        
+        size_t r;
+        for (r = 0; r < enc->rangeCols * enc->rangeRows; r++)
+        {
+            const rangeTransform* t = &enc->transforms[r];
+            size_t rx = (r % enc->rangeCols) * r_size;
+            size_t ry = (r / enc->rangeCols) * r_size;
+            size_t dx = t->d_i * (enc->d_step << magExp);
+            size_t dy = t->d_j * (enc->d_step << magExp);
+            size_t x, y, u, v;
+            for (y = 0; y < r_size; y++)
+            {
+                for (x = 0; x < r_size; x++)
+                {
+                    isometrySource(t->iso, r_size, x, y, &u, &v);
+                    R[(ry + y) * w + rx + x] = t->s * D[(dy + v) * dW + dx + u] + t->o;
+                }
+            }
+        }
+    }
+    
+    uint8_t* pixels = quantizeDecoded(R, w * h);
+    
+    free(R);
+    free(D);
+    
+    return pixels;
+}
+
+/* the GL decoder, when fc has a context and the decoded image fits in a texture */
+static glDecoder* findGLDecoder(fractureContext* fc, size_t w, size_t h, size_t magExp)
+{
+    if (fc == NULL || fc->cgl_ctx == NULL)
+    {
+        return NULL;
+    }
+    if (fc->gd == NULL)
+    {
+        fc->gd = createGLDecoder(fc->cgl_ctx);
+    }
+    if (fc->gd == NULL || (w << magExp) > fc->gd->maxSize || (h << magExp) > fc->gd->maxSize)
+    {
+        return NULL;
+    }
+    
+    return fc->gd;
+}
+
+uint8_t* fractureDecode(fractureContext* fc,
+    const fractureEncoding* enc,
+    size_t magExp, size_t iterations)
+{
+    if (fc == NULL || fc->cgl_ctx == NULL)
+    {
+        return decodeCPU(enc, magExp, iterations);
+    }
+    
+    glContextObj cgl_ctx = fc->cgl_ctx;
+    fc->backend->makeCurrent(cgl_ctx);
+    
+    uint8_t* pixels;
+    glDecoder* gd = findGLDecoder(fc, enc->w, enc->h, magExp);
+    if (gd != NULL)
+    {
+        texInfo* transformsT = createTransformTexture(gd, enc->transforms, enc->rangeCols, enc->rangeRows);
+        GLfloat* R = decodeTransformTexture(gd, transformsT,
+            enc->w, enc->h, enc->d_size, enc->r_size, enc->d_step, magExp, iterations);
+        pixels = quantizeDecoded(R, (enc->w << magExp) * (enc->h << magExp));
+        free(R);
+        releaseTexture(cgl_ctx, transformsT);
+    }
+    else
+    {
+        pixels = decodeCPU(enc, magExp, iterations);
+    }
+    
+    fc->backend->clearCurrent(cgl_ctx);
+    
+    return pixels;
+}
+
+uint8_t* fractureEnlarge(fractureContext* fc,
+    const uint8_t* pixels, size_t w, size_t h, size_t stride,
+    size_t d_size, size_t r_size,
+    size_t magExp, size_t iterations)
+{
+    if (fc->options.engine != ENGINE_GL || fc->options.fixedParents || fc->options.cacheLevels > 0 ||
+        fc->options.budgetSeconds > 0.0 || fc->options.budgetSearches > 0)
+    {
+        fractureEncoding* enc = fractureEncode(fc, pixels, w, h, stride, d_size, r_size);
+        uint8_t* enlarged = fractureDecode(fc, enc, magExp, iterations);
+        releaseFractureEncoding(enc);
+        return enlarged;
+    }
+    
+    glContextObj cgl_ctx = fc->cgl_ctx;
+    fc->backend->makeCurrent(cgl_ctx);
+    
+    fractureEncoding* enc = createFractureEncoding(fc, w, h, d_size, r_size, r_size);
+    texInfo* srcImgT = createTextureFromGrayBytes(cgl_ctx, pixels, w, h, stride);
+    glDecoder* gd = findGLDecoder(fc, w, h, magExp);
+    uint8_t* enlarged;
+    if (gd != NULL)
+    {
+        texInfo* transformsT = createEmptyTexture(cgl_ctx, floatTextureFormat(4), enc->rangeCols, enc->rangeRows);
+        transformsT->aW = enc->rangeCols;
+        transformsT->aH = enc->rangeRows;
+        transformsT->aC = 4;
+        
+        encodeGL(fc, enc, srcImgT, transformsT, NULL, NULL, NULL);
+        gd->originXMult = fc->ge->originXMult;
+        GLfloat* R = decodeTransformTexture(gd, transformsT,
+            w, h, d_size, r_size, r_size, magExp, iterations);
+        enlarged = quantizeDecoded(R, (w << magExp) * (h << magExp));
+        free(R);
+        releaseTexture(cgl_ctx, transformsT);
+    }
+    else
+    {
+        encodeGL(fc, enc, srcImgT, NULL, NULL, NULL, NULL);
+        enlarged = decodeCPU(enc, magExp, iterations);
+    }
+    
+    releaseTexture(cgl_ctx, srcImgT);
+    releaseFractureEncoding(enc);
+    fc->backend->clearCurrent(cgl_ctx);
+    
+    return enlarged;
+}
+
+void writeFractureEncoding(FILE* f, const fractureEncoding* enc)
+{
+    fprintf(f, "# orig_w = %d\n", (int)enc->w);
+    fprintf(f, "# orig_h = %d\n", (int)enc->h);
+    fprintf(f, "# d_size = %d\n", (int)enc->d_size);
+    fprintf(f, "# r_size = %d\n", (int)enc->r_size);
+    
+    size_t r_size = enc->r_size;
+    size_t d_size = enc->d_size;
+    size_t originStep = enc->d_step * (d_size / r_size);
+    size_t r_i, r_j;
+    for (r_j = 0; r_j < enc->rangeRows; r_j++)
+    {
+        for (r_i = 0; r_i < enc->rangeCols; r_i++)
+        {
+            const rangeTransform* t = &enc->transforms[r_j * enc->rangeCols + r_i];
+            fprintf(f, "[%03d : %03d, %03d : %03d] = % f + % f * [%03d : %03d, %03d : %03d]",
+                (int)(r_i * r_size), (int)((r_i + 1) * r_size),
+                (int)(r_j * r_size), (int)((r_j + 1) * r_size),
+                t->o, t->s,
+                (int)(t->d_i * originStep), (int)(t->d_i * originStep + d_size),
+                (int)(t->d_j * originStep), (int)(t->d_j * originStep + d_size));
+            if (t->iso != 0)
+            {
+                fprintf(f, " iso %d", t->iso);
+            }
+            fprintf(f, "\n");
+        }
+    }
+}
+
+fractureEncoding* readFractureEncoding(FILE* f, const char** failure)
+{
+    fractureEncoding* enc = calloc(1, sizeof(fractureEncoding));
+    char line[256];
+    *failure = NULL;
+    
+    while (fgets(line, sizeof(line), f) != NULL)
+    {
+        char key[32];
+        int value;
+        int rx1, rx2, ry1, ry2, dx1, dx2, dy1, dy2;
+        int iso = 0;
+        float o, s;
+        if (sscanf(line, "# %31s = %d", key, &value) == 2)
+        {
+            /* the transforms array is sized by the header, which may not change after it */
+            if (enc->transforms != NULL)
+            {
+                *failure = "header line after the header";
+                break;
+            }
+            size_t* field = NULL;
+            if      (strcmp("orig_w", key) == 0) field = &enc->w;
+            else if (strcmp("orig_h", key) == 0) field = &enc->h;
+            else if (strcmp("d_size", key) == 0) field = &enc->d_size;
+            else if (strcmp("r_size", key) == 0) field = &enc->r_size;
+            if (field != NULL && (value <= 0 || *field != 0))
+            {
+                *failure = "bad or repeated header value";
+                break;
+            }
+            if (field != NULL)
+            {
+                *field = value;
+            }
+            
+            if (enc->w && enc->h && enc->d_size && enc->r_size)
+            {
+                /* decoders shrink domains by shifting, so the ratio is a power of two */
+                size_t ratio = enc->d_size / enc->r_size;
+                if (enc->d_size < enc->r_size || enc->d_size % enc->r_size != 0 || (ratio & (ratio - 1)) != 0 ||
+                    enc->w < enc->d_size || enc->h < enc->d_size)
+                {
+                    *failure = "bad block sizes";
+                    break;
+                }
+                
+                /* domains are read at any decimated pixel, whatever step they were found at */
+                enc->d_step = 1;
+                enc->rangeCols = enc->w / enc->r_size;
+                enc->rangeRows = enc->h / enc->r_size;
+                enc->transforms = calloc(enc->rangeCols * enc->rangeRows, sizeof(rangeTransform));
+            }
+        }
+        else if (sscanf(line, "[%d : %d, %d : %d] = %f + %f * [%d : %d, %d : %d] iso %d",
+            &rx1, &rx2, &ry1, &ry2, &o, &s, &dx1, &dx2, &dy1, &dy2, &iso) >= 10)
+        {
+            if (enc->transforms == NULL)
+            {
+                *failure = "transform before header";
+                break;
+            }
+            size_t r_i = rx1 / enc->r_size;
+            size_t r_j = ry1 / enc->r_size;
+            if (r_i >= enc->rangeCols || r_j >= enc->rangeRows)
+            {
+                *failure = "range outside image";
+                break;
+            }
+            rangeTransform* t = &enc->transforms[r_j * enc->rangeCols + r_i];
+            t->o = o;
+            t->s = s;
+            size_t scale = enc->d_size / enc->r_size;
+            if (dx1 < 0 || dy1 < 0 || dx1 % scale != 0 || dy1 % scale != 0 ||
+                dx1 + enc->d_size > enc->w || dy1 + enc->d_size > enc->h)
+            {
+                *failure = "bad domain";
+                break;
+            }
+            t->d_i = dx1 / scale;
+            t->d_j = dy1 / scale;
+            if (iso < 0 || iso >= NUM_ISOMETRIES)
+            {
+                *failure = "bad isometry";
+                break;
+            }
+            t->iso = iso;
+        }
+        else
+        {
+            *failure = "bad transform line";
+            break;
+        }
+    }
+    
+    if (*failure == NULL && enc->transforms == NULL)
+    {
+        *failure = "incomplete transform header";
+    }
+    if (*failure != NULL)
+    {
+        releaseFractureEncoding(enc);
+        return NULL;
+    }
+    
+    return enc;
+}
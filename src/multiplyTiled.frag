@@ -9,5 +9,6 @@ void main()
 {
     vec2 d_pos = gl_TexCoord[0].st;
     vec2 r_pos = mod(d_pos, r_size) + vec2(r_x, r_y);
-    gl_FragData[0] = texture2DRect(D_tex, d_pos) * texture2DRect(R_tex, r_pos);
+    float Dr = texture2DRect(D_tex, d_pos).r * texture2DRect(R_tex, r_pos).r;
+    gl_FragData[0] = vec4(Dr, 0.0, 0.0, 0.0);
 }
\ No newline at end of file
@@ -0,0 +1,106 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "errors.h"
+
+#include "rangecache.h"
+
+/* key of a block whose standard deviation is under half a gray level */
+#define FLAT_KEY (MAX_RANGE_CACHE_LEVELS + 1)
+
+rangeCache* createRangeCache(const cpuEncodeData* ced, int levels)
+{
+    if (levels < MIN_RANGE_CACHE_LEVELS || levels > MAX_RANGE_CACHE_LEVELS)
+    {
+        ERR("bad range cache levels", "");
+    }
+    
+    rangeCache* rc = calloc(1, sizeof(rangeCache));
+    rc->n = ced->n;
+    rc->levels = levels;
+    rc->capacity = 1;
+    while (rc->capacity < 2 * ced->rangeCols * ced->rangeRows)
+    {
+        rc->capacity *= 2;
+    }
+    rc->keys = malloc(rc->capacity * rc->n);
+    rc->hashes = malloc(rc->capacity * sizeof(uint32_t));
+    rc->used = calloc(rc->capacity, 1);
+    rc->d_i = malloc(rc->capacity * sizeof(size_t));
+    rc->d_j = malloc(rc->capacity * sizeof(size_t));
+    
+    return rc;
+}
+
+void releaseRangeCache(rangeCache* rc)
+{
+    free(rc->keys);
+    free(rc->hashes);
+    free(rc->used);
+    free(rc->d_i);
+    free(rc->d_j);
+    free(rc);
+}
+
+static void rangeKey(const rangeCache* rc, const cpuEncodeData* ced, size_t r, uint8_t* key)
+{
+    const int16_t* block = ced->rangeBlocks + r * ced->nPad;
+    double mean = (double)ced->sumR[r] / ced->n;
+    double variance = (double)ced->sumR2[r] / ced->n - mean * mean;
+    size_t k;
+    if (variance < 0.25)
+    {
+        memset(key, FLAT_KEY, rc->n);
+        return;
+    }
+    
+    /* two standard deviations either side of the mean over the levels */
+    double scale = rc->levels / (4.0 * sqrt(variance));
+    for (k = 0; k < rc->n; k++)
+    {
+        double q = floor((block[k] - mean) * scale + rc->levels / 2);
+        key[k] = q < 0.0 ? 0 : q >= rc->levels ? rc->levels - 1 : (uint8_t)q;
+    }
+}
+
+int findRangeDomain(rangeCache* rc, const cpuEncodeData* ced, size_t r,
+    size_t* d_i, size_t* d_j)
+{
+    uint8_t key[64];
+    rangeKey(rc, ced, r, key);
+    
+    /* FNV-1a */
+    uint32_t hash = 2166136261u;
+    size_t k;
+    for (k = 0; k < rc->n; k++)
+    {
+        hash = (hash ^ key[k]) * 16777619u;
+    }
+    
+    /* linear probing; never full, so every probe ends at a match or a free slot */
+    size_t slot = hash & (rc->capacity - 1);
+    while (rc->used[slot])
+    {
+        if (rc->hashes[slot] == hash && memcmp(rc->keys + slot * rc->n, key, rc->n) == 0)
+        {
+            *d_i = rc->d_i[slot];
+            *d_j = rc->d_j[slot];
+            return 1;
+        }
+        slot = (slot + 1) & (rc->capacity - 1);
+    }
+    
+    memcpy(rc->keys + slot * rc->n, key, rc->n);
+    rc->hashes[slot] = hash;
+    rc->pending = slot;
+    return 0;
+}
+
+void cacheRangeDomain(rangeCache* rc, size_t d_i, size_t d_j)
+{
+    rc->used[rc->pending] = 1;
+    rc->d_i[rc->pending] = d_i;
+    rc->d_j[rc->pending] = d_j;
+}
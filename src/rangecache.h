@@ -0,0 +1,44 @@
+#ifndef RANGECACHE_H
+#define RANGECACHE_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "cpuenc.h"
+
+/*
+ * Domains found for range blocks, keyed on the block's shape: its samples
+ * with the mean removed, divided by the standard deviation and quantized
+ * to a few levels. Nearly flat blocks share one key. Since s and o absorb
+ * contrast and brightness, a range with the shape of one already searched
+ * can take that range's domain and only be refit.
+ */
+
+/* quantization levels a cache accepts, see checkFractureOptions */
+#define MIN_RANGE_CACHE_LEVELS 2
+#define MAX_RANGE_CACHE_LEVELS 254
+
+typedef struct rangeCache {
+    size_t n;             /* samples per block, bytes per key */
+    int levels;
+    size_t capacity;      /* a power of two, at least twice the ranges */
+    uint8_t* keys;        /* capacity * n */
+    uint32_t* hashes;
+    uint8_t* used;
+    size_t* d_i;
+    size_t* d_j;
+    size_t pending;       /* slot of the last miss, see cacheRangeDomain */
+} rangeCache;
+
+rangeCache* createRangeCache(const cpuEncodeData* ced, int levels);
+void releaseRangeCache(rangeCache* rc);
+
+/*
+ * The cached domain for range r of ced, returning 0 on a miss. After a
+ * miss, cacheRangeDomain stores the domain then found for that range.
+ */
+int findRangeDomain(rangeCache* rc, const cpuEncodeData* ced, size_t r,
+    size_t* d_i, size_t* d_j);
+void cacheRangeDomain(rangeCache* rc, size_t d_i, size_t d_j);
+
+#endif
@@ -0,0 +1,730 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+#include "errors.h"
+#include "imageio.h"
+#include "server.h"
+
+#define OP_ENCODE 0
+#define OP_DECODE 1
+#define NUM_OPS 2
+
+static const char* opNames[NUM_OPS] = { "encode", "decode" };
+
+/* request paths, matching the widths in createServerJob */
+#define MAX_PATH 4096
+#define MAX_REQUEST (2 * MAX_PATH + 64)
+#define REQUEST_TIMEOUT_MS 2000   /* for a client to send its request line */
+
+/*
+ * small LRU cache of byte blobs keyed by path and modification time,
+ * lookups hand out copies so entries can be evicted at any time
+ */
+typedef struct cacheEntry {
+    char* key;
+    time_t mtime;
+    void* data;
+    size_t size;
+    unsigned long lastUse;
+} cacheEntry;
+
+typedef struct blobCache {
+    pthread_mutex_t lock;
+    cacheEntry* entries;
+    size_t capacity;
+    unsigned long clock;
+    size_t hits;
+    size_t misses;
+} blobCache;
+
+typedef struct serverJob {
+    int fd;
+    int op;
+    int priority;
+    unsigned long seq;
+    size_t d_size;
+    size_t r_size;
+    size_t magExp;
+    size_t iterations;
+    char inPath[MAX_PATH];
+    char outPath[MAX_PATH];
+    struct timeval received;
+} serverJob;
+
+typedef struct opStats {
+    size_t count;
+    double queueMs;
+    double runMs;
+    double maxMs;
+} opStats;
+
+typedef struct serverState {
+    const serverOptions* so;
+    
+    pthread_mutex_t lock;
+    pthread_cond_t notEmpty;
+    serverJob** pending;
+    size_t numPending;
+    unsigned long nextSeq;
+    int stopping;
+    
+    pthread_mutex_t statsLock;
+    opStats stats[NUM_OPS];
+    
+    blobCache images;           /* gray pixels by source path */
+    blobCache encodings;        /* transform sets by .trn path, or source path and block sizes */
+} serverState;
+
+static void initBlobCache(blobCache* c, size_t capacity)
+{
+    pthread_mutex_init(&c->lock, NULL);
+    c->entries = calloc(capacity, sizeof(cacheEntry));
+    c->capacity = capacity;
+    c->clock = 0;
+    c->hits = 0;
+    c->misses = 0;
+}
+
+static void releaseBlobCache(blobCache* c)
+{
+    size_t i;
+    for (i = 0; i < c->capacity; i++)
+    {
+        free(c->entries[i].key);
+        free(c->entries[i].data);
+    }
+    free(c->entries);
+    pthread_mutex_destroy(&c->lock);
+}
+
+static void* createBlobFromCache(blobCache* c, const char* key, time_t mtime)
+{
+    void* data = NULL;
+    pthread_mutex_lock(&c->lock);
+    size_t i;
+    for (i = 0; i < c->capacity; i++)
+    {
+        cacheEntry* e = &c->entries[i];
+        if (e->key != NULL && e->mtime == mtime && strcmp(e->key, key) == 0)
+        {
+            e->lastUse = ++c->clock;
+            data = malloc(e->size);
+            memcpy(data, e->data, e->size);
+            break;
+        }
+    }
+    if (data != NULL) c->hits++;
+    else c->misses++;
+    pthread_mutex_unlock(&c->lock);
+    
+    return data;
+}
+
+static void storeBlob(blobCache* c, const char* key, time_t mtime, const void* data, size_t size)
+{
+    if (c->capacity == 0)
+    {
+        return;
+    }
+    
+    pthread_mutex_lock(&c->lock);
+    cacheEntry* victim = &c->entries[0];
+    size_t i;
+    for (i = 0; i < c->capacity; i++)
+    {
+        cacheEntry* e = &c->entries[i];
+        if (e->key != NULL && strcmp(e->key, key) == 0)
+        {
+            victim = e;
+            break;
+        }
+        if (e->key == NULL || (victim->key != NULL && e->lastUse < victim->lastUse))
+        {
+            victim = e;
+        }
+    }
+    free(victim->key);
+    free(victim->data);
+    victim->key = strdup(key);
+    victim->mtime = mtime;
+    victim->data = malloc(size);
+    memcpy(victim->data, data, size);
+    victim->size = size;
+    victim->lastUse = ++c->clock;
+    pthread_mutex_unlock(&c->lock);
+}
+
+/* blob layout: the fractureEncoding, then its transforms */
+static void storeEncoding(blobCache* c, const char* key, time_t mtime, const fractureEncoding* enc)
+{
+    size_t numTransforms = enc->rangeCols * enc->rangeRows;
+    size_t size = sizeof(fractureEncoding) + numTransforms * sizeof(rangeTransform);
+    char* blob = malloc(size);
+    memcpy(blob, enc, sizeof(fractureEncoding));
+    memcpy(blob + sizeof(fractureEncoding), enc->transforms, numTransforms * sizeof(rangeTransform));
+    storeBlob(c, key, mtime, blob, size);
+    free(blob);
+}
+
+static fractureEncoding* createEncodingFromCache(blobCache* c, const char* key, time_t mtime)
+{
+    char* blob = createBlobFromCache(c, key, mtime);
+    if (blob == NULL)
+    {
+        return NULL;
+    }
+    
+    fractureEncoding* enc = malloc(sizeof(fractureEncoding));
+    memcpy(enc, blob, sizeof(fractureEncoding));
+    size_t transformsSize = enc->rangeCols * enc->rangeRows * sizeof(rangeTransform);
+    enc->transforms = malloc(transformsSize);
+    memcpy(enc->transforms, blob + sizeof(fractureEncoding), transformsSize);
+    free(blob);
+    
+    return enc;
+}
+
+/* blob layout: w, h, then the pixels; NULL with a message in *failure if the image cannot be read */
+static GLubyte* createCachedGrayBytes(serverState* ss, char* path, time_t mtime, size_t* w, size_t* h,
+    const char** failure)
+{
+    size_t header = 2 * sizeof(size_t);
+    char* blob = createBlobFromCache(&ss->images, path, mtime);
+    if (blob != NULL)
+    {
+        memcpy(w, blob, sizeof(size_t));
+        memcpy(h, blob + sizeof(size_t), sizeof(size_t));
+        GLubyte* pixels = malloc(*w * *h);
+        memcpy(pixels, blob + header, *w * *h);
+        free(blob);
+        
+        return pixels;
+    }
+    
+    grayImage* img = loadGrayImage(path, failure);
+    if (img == NULL)
+    {
+        return NULL;
+    }
+    *w = img->w;
+    *h = img->h;
+    GLubyte* pixels = malloc(*w * *h);
+    size_t y;
+    for (y = 0; y < *h; y++)
+    {
+        memcpy(pixels + y * *w, img->data + y * img->stride, *w);
+    }
+    releaseGrayImage(img);
+    
+    blob = malloc(header + *w * *h);
+    memcpy(blob, w, sizeof(size_t));
+    memcpy(blob + sizeof(size_t), h, sizeof(size_t));
+    memcpy(blob + header, pixels, *w * *h);
+    storeBlob(&ss->images, path, mtime, blob, header + *w * *h);
+    free(blob);
+    
+    return pixels;
+}
+
+static double elapsedMs(const struct timeval* from, const struct timeval* to)
+{
+    return 1e3 * (to->tv_sec - from->tv_sec) + 1e-3 * (to->tv_usec - from->tv_usec);
+}
+
+static void respond(int fd, const char* format, ...)
+{
+    char line[256];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    
+    /* the client may be gone already, which is its own business */
+    ssize_t written = write(fd, line, strlen(line));
+    (void)written;
+}
+
+/* higher priority first, then first come first served */
+static serverJob* popServerJob(serverState* ss)
+{
+    pthread_mutex_lock(&ss->lock);
+    while (ss->numPending == 0 && !ss->stopping)
+    {
+        pthread_cond_wait(&ss->notEmpty, &ss->lock);
+    }
+    serverJob* job = NULL;
+    if (ss->numPending > 0)
+    {
+        size_t best = 0;
+        size_t i;
+        for (i = 1; i < ss->numPending; i++)
+        {
+            serverJob* j = ss->pending[i];
+            if (j->priority > ss->pending[best]->priority ||
+                (j->priority == ss->pending[best]->priority && j->seq < ss->pending[best]->seq))
+            {
+                best = i;
+            }
+        }
+        job = ss->pending[best];
+        ss->pending[best] = ss->pending[--ss->numPending];
+    }
+    pthread_mutex_unlock(&ss->lock);
+    
+    return job;
+}
+
+static int pushServerJob(serverState* ss, serverJob* job)
+{
+    int accepted = 0;
+    pthread_mutex_lock(&ss->lock);
+    if (ss->numPending < ss->so->queueLength)
+    {
+        job->seq = ss->nextSeq++;
+        ss->pending[ss->numPending++] = job;
+        pthread_cond_signal(&ss->notEmpty);
+        accepted = 1;
+    }
+    pthread_mutex_unlock(&ss->lock);
+    
+    return accepted;
+}
+
+/* returns NULL on success, or a message for the client */
+static const char* runEncodeJob(serverState* ss, fractureContext* fc, serverJob* job, int* cached)
+{
+    struct stat st;
+    if (stat(job->inPath, &st) == -1)
+    {
+        return "cannot stat input";
+    }
+    
+    char key[MAX_PATH + 32];
+    snprintf(key, sizeof(key), "%s:%d:%d", job->inPath, (int)job->d_size, (int)job->r_size);
+    fractureEncoding* enc = createEncodingFromCache(&ss->encodings, key, st.st_mtime);
+    *cached = enc != NULL;
+    if (enc == NULL)
+    {
+        size_t w, h;
+        const char* failure;
+        GLubyte* pixels = createCachedGrayBytes(ss, job->inPath, st.st_mtime, &w, &h, &failure);
+        if (pixels == NULL)
+        {
+            return failure;
+        }
+        failure = checkFractureBlockSizes(fc, w, h, job->d_size, job->r_size);
+        if (failure != NULL)
+        {
+            free(pixels);
+            return failure;
+        }
+        enc = fractureEncode(fc, pixels, w, h, w, job->d_size, job->r_size);
+        free(pixels);
+        storeEncoding(&ss->encodings, key, st.st_mtime, enc);
+    }
+    
+    FILE* trnOutFile = fopen(job->outPath, "w");
+    if (trnOutFile != NULL)
+    {
+        writeFractureEncoding(trnOutFile, enc);
+        fclose(trnOutFile);
+    }
+    releaseFractureEncoding(enc);
+    
+    return trnOutFile != NULL ? NULL : "cannot open output";
+}
+
+static const char* runDecodeJob(serverState* ss, fractureContext* fc, serverJob* job, int* cached)
+{
+    struct stat st;
+    if (stat(job->inPath, &st) == -1)
+    {
+        return "cannot stat input";
+    }
+    
+    const char* failure;
+    fractureEncoding* enc = createEncodingFromCache(&ss->encodings, job->inPath, st.st_mtime);
+    *cached = enc != NULL;
+    if (enc == NULL)
+    {
+        FILE* trnInFile = fopen(job->inPath, "r");
+        if (trnInFile == NULL)
+        {
+            return "cannot open input";
+        }
+        enc = readFractureEncoding(trnInFile, &failure);
+        fclose(trnInFile);
+        if (enc == NULL)
+        {
+            return failure;
+        }
+        storeEncoding(&ss->encodings, job->inPath, st.st_mtime, enc);
+    }
+    
+    uint8_t* pixels = fractureDecode(fc, enc, job->magExp, job->iterations);
+    size_t w = enc->w << job->magExp;
+    failure = writeGrayImage(job->outPath, pixels, w, enc->h << job->magExp, w, &ss->so->output);
+    free(pixels);
+    releaseFractureEncoding(enc);
+    
+    return failure;
+}
+
+static void* workerMain(void* arg)
+{
+    serverState* ss = arg;
+    const char* failure;
+    fractureContext* fc = createFractureContext(&ss->so->encoder, &failure);
+    CHK_NULL(fc, (char*)failure, "");
+    
+    serverJob* job;
+    while ((job = popServerJob(ss)) != NULL)
+    {
+        struct timeval started, finished;
+        gettimeofday(&started, NULL);
+        int cached = 0;
+        failure = job->op == OP_ENCODE ?
+            runEncodeJob(ss, fc, job, &cached) :
+            runDecodeJob(ss, fc, job, &cached);
+        gettimeofday(&finished, NULL);
+        
+        double queueMs = elapsedMs(&job->received, &started);
+        double runMs = elapsedMs(&started, &finished);
+        if (failure != NULL)
+        {
+            respond(job->fd, "err %s\n", failure);
+        }
+        else
+        {
+            respond(job->fd, "ok queue_ms=%0.1f run_ms=%0.1f cached=%d\n", queueMs, runMs, cached);
+        }
+        close(job->fd);
+        printf("%s %s: %s, queue %0.1f ms, run %0.1f ms%s\n",
+            opNames[job->op], job->inPath, failure != NULL ? failure : "ok",
+            queueMs, runMs, cached ? " (cached)" : "");
+        
+        pthread_mutex_lock(&ss->statsLock);
+        opStats* s = &ss->stats[job->op];
+        s->count++;
+        s->queueMs += queueMs;
+        s->runMs += runMs;
+        if (queueMs + runMs > s->maxMs)
+        {
+            s->maxMs = queueMs + runMs;
+        }
+        pthread_mutex_unlock(&ss->statsLock);
+        
+        free(job);
+    }
+    
+    releaseFractureContext(fc);
+    
+    return NULL;
+}
+
+static void respondStats(serverState* ss, int fd)
+{
+    char line[1024];
+    size_t len = 0;
+    
+    pthread_mutex_lock(&ss->statsLock);
+    len += snprintf(line + len, sizeof(line) - len, "ok");
+    int op;
+    for (op = 0; op < NUM_OPS; op++)
+    {
+        opStats* s = &ss->stats[op];
+        double n = s->count > 0 ? s->count : 1;
+        len += snprintf(line + len, sizeof(line) - len,
+            " %s: n=%d mean_queue_ms=%0.1f mean_run_ms=%0.1f max_ms=%0.1f;",
+            opNames[op], (int)s->count, s->queueMs / n, s->runMs / n, s->maxMs);
+    }
+    pthread_mutex_unlock(&ss->statsLock);
+    
+    pthread_mutex_lock(&ss->lock);
+    len += snprintf(line + len, sizeof(line) - len, " pending=%d", (int)ss->numPending);
+    pthread_mutex_unlock(&ss->lock);
+    
+    snprintf(line + len, sizeof(line) - len,
+        " image_cache=%d/%d encoding_cache=%d/%d\n",
+        (int)ss->images.hits, (int)(ss->images.hits + ss->images.misses),
+        (int)ss->encodings.hits, (int)(ss->encodings.hits + ss->encodings.misses));
+    respond(fd, "%s", line);
+}
+
+/*
+ * reads up to a newline, which is replaced by the terminator; the accept
+ * loop waits on this, so a client gets REQUEST_TIMEOUT_MS for the whole
+ * line, however slowly it arrives
+ */
+static int readRequest(int fd, char* line, size_t size)
+{
+    struct timeval timeout = { REQUEST_TIMEOUT_MS / 1000, (REQUEST_TIMEOUT_MS % 1000) * 1000 };
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    struct timeval started, now;
+    gettimeofday(&started, NULL);
+    
+    size_t len = 0;
+    while (len + 1 < size)
+    {
+        /* each read waits only for what is left of the timeout */
+        gettimeofday(&now, NULL);
+        double leftMs = REQUEST_TIMEOUT_MS - elapsedMs(&started, &now);
+        if (leftMs < 1.0)
+        {
+            return 0;
+        }
+        timeout.tv_sec = (time_t)(leftMs / 1000);
+        timeout.tv_usec = (suseconds_t)(1000 * leftMs) % 1000000;
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        ssize_t n = read(fd, line + len, 1);
+        if (n <= 0)
+        {
+            return 0;
+        }
+        if (line[len] == '\n')
+        {
+            break;
+        }
+        len++;
+    }
+    line[len] = '\0';
+    
+    return 1;
+}
+
+static serverJob* createServerJob(int fd, char* line)
+{
+    serverJob* job = calloc(1, sizeof(serverJob));
+    job->fd = fd;
+    gettimeofday(&job->received, NULL);
+    
+    char quality[8];
+    int magExp, iterations;
+    if (sscanf(line, "encode %d %7s %4095s %4095s",
+        &job->priority, quality, job->inPath, job->outPath) == 4)
+    {
+        job->op = OP_ENCODE;
+        if      (strcmp("SD", quality) == 0) { job->d_size = 8; job->r_size = 4; }
+        else if (strcmp("HD", quality) == 0) { job->d_size = 4; job->r_size = 2; }
+        else
+        {
+            free(job);
+            return NULL;
+        }
+    }
+    else if (sscanf(line, "decode %d %d %d %4095s %4095s",
+        &job->priority, &magExp, &iterations, job->inPath, job->outPath) == 5 &&
+        magExp >= 0 && magExp <= 4 && iterations > 0)
+    {
+        job->op = OP_DECODE;
+        job->magExp = magExp;
+        job->iterations = iterations;
+    }
+    else
+    {
+        free(job);
+        return NULL;
+    }
+    
+    return job;
+}
+
+void runServer(const char* socketPath, const serverOptions* so)
+{
+    serverState ss;
+    memset(&ss, 0, sizeof(serverState));
+    ss.so = so;
+    pthread_mutex_init(&ss.lock, NULL);
+    pthread_cond_init(&ss.notEmpty, NULL);
+    pthread_mutex_init(&ss.statsLock, NULL);
+    ss.pending = malloc(so->queueLength * sizeof(serverJob*));
+    initBlobCache(&ss.images, so->cacheEntries);
+    initBlobCache(&ss.encodings, so->cacheEntries);
+    
+    signal(SIGPIPE, SIG_IGN);
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(socketPath) >= sizeof(addr.sun_path)) ERR("socket path too long", (char*)socketPath);
+    strcpy(addr.sun_path, socketPath);
+    
+    int listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    CHK_SYSCALL(listenFd, "socket() failed", (char*)socketPath);
+    unlink(socketPath);
+    CHK_SYSCALL(bind(listenFd, (struct sockaddr*)&addr, sizeof(addr)), "bind() failed", (char*)socketPath);
+    CHK_SYSCALL(listen(listenFd, 16), "listen() failed", (char*)socketPath);
+    
+    pthread_t* workers = malloc(so->numWorkers * sizeof(pthread_t));
+    size_t i;
+    for (i = 0; i < so->numWorkers; i++)
+    {
+        if (pthread_create(&workers[i], NULL, workerMain, &ss) != 0) ERR("pthread_create() failed", "worker");
+    }
+    printf("listening on %s with %d workers\n", socketPath, (int)so->numWorkers);
+    
+    for (;;)
+    {
+        int fd = accept(listenFd, NULL, NULL);
+        if (fd == -1)
+        {
+            continue;
+        }
+        
+        char line[MAX_REQUEST];
+        if (!readRequest(fd, line, sizeof(line)))
+        {
+            close(fd);
+            continue;
+        }
+        
+        if (strcmp("stats", line) == 0)
+        {
+            respondStats(&ss, fd);
+            close(fd);
+            continue;
+        }
+        if (strcmp("shutdown", line) == 0)
+        {
+            respond(fd, "ok\n");
+            close(fd);
+            break;
+        }
+        
+        serverJob* job = createServerJob(fd, line);
+        if (job == NULL)
+        {
+            respond(fd, "err bad request\n");
+            close(fd);
+        }
+        else if (!pushServerJob(&ss, job))
+        {
+            respond(fd, "err busy\n");
+            close(fd);
+            free(job);
+        }
+    }
+    
+    /* workers finish the pending jobs first */
+    pthread_mutex_lock(&ss.lock);
+    ss.stopping = 1;
+    pthread_cond_broadcast(&ss.notEmpty);
+    pthread_mutex_unlock(&ss.lock);
+    for (i = 0; i < so->numWorkers; i++)
+    {
+        pthread_join(workers[i], NULL);
+    }
+    
+    close(listenFd);
+    unlink(socketPath);
+    
+    free(workers);
+    free(ss.pending);
+    releaseBlobCache(&ss.images);
+    releaseBlobCache(&ss.encodings);
+    pthread_mutex_destroy(&ss.lock);
+    pthread_cond_destroy(&ss.notEmpty);
+    pthread_mutex_destroy(&ss.statsLock);
+}
+
+/* the server does not share our working directory */
+static char* createAbsolutePath(const char* path)
+{
+    char* absolute;
+    if (path[0] == '/')
+    {
+        absolute = strdup(path);
+    }
+    else
+    {
+        char cwd[PATH_MAX];
+        CHK_NULL(getcwd(cwd, sizeof(cwd)), "getcwd() failed", "");
+        asprintf(&absolute, "%s/%s", cwd, path);
+    }
+    if (strpbrk(absolute, " \t\n") != NULL)
+    {
+        ERR("paths with whitespace are not supported", absolute);
+    }
+    
+    return absolute;
+}
+
+int runClient(const char* socketPath, int argc, char** argv)
+{
+    if (argc < 1)
+    {
+        ERR("not enough arguments", "");
+    }
+    
+    int priority = 0;
+    int magExp = 0;
+    int iterations = 10;
+    int numPositional = strcmp("encode", argv[0]) == 0 ? 4 : (strcmp("decode", argv[0]) == 0 ? 3 : 1);
+    if (argc < numPositional)
+    {
+        ERR("not enough arguments", argv[0]);
+    }
+    int argi;
+    for (argi = numPositional; argi < argc; argi++)
+    {
+        char* opt = argv[argi];
+        if      (strncmp("priority=", opt, 9) == 0) priority = atoi(opt + 9);
+        else if (strncmp("mag=", opt, 4) == 0) magExp = atoi(opt + 4);
+        else if (strncmp("iterations=", opt, 11) == 0) iterations = atoi(opt + 11);
+        else ERR("unknown option", opt);
+    }
+    
+    char* request;
+    if (numPositional > 1)
+    {
+        char* inPath = createAbsolutePath(argv[1]);
+        char* outPath = createAbsolutePath(argv[2]);
+        if (numPositional == 4)
+        {
+            asprintf(&request, "encode %d %s %s %s\n", priority, argv[3], inPath, outPath);
+        }
+        else
+        {
+            asprintf(&request, "decode %d %d %d %s %s\n", priority, magExp, iterations, inPath, outPath);
+        }
+        free(inPath);
+        free(outPath);
+    }
+    else
+    {
+        asprintf(&request, "%s\n", argv[0]);
+    }
+    
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(socketPath) >= sizeof(addr.sun_path)) ERR("socket path too long", (char*)socketPath);
+    strcpy(addr.sun_path, socketPath);
+    
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    CHK_SYSCALL(fd, "socket() failed", (char*)socketPath);
+    CHK_SYSCALL(connect(fd, (struct sockaddr*)&addr, sizeof(addr)), "connect() failed", (char*)socketPath);
+    if (write(fd, request, strlen(request)) != (ssize_t)strlen(request))
+    {
+        ERR("write() failed", (char*)socketPath);
+    }
+    
+    char response[1024] = "";
+    int ok = readRequest(fd, response, sizeof(response)) && strncmp("ok", response, 2) == 0;
+    printf("%s\n", response);
+    close(fd);
+    free(request);
+    
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
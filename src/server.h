@@ -0,0 +1,38 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <stdlib.h>
+
+#include "fracture.h"
+#include "imageio.h"
+
+/*
+ * local encode/decode daemon on a Unix domain socket
+ *
+ * Each worker thread owns a warm fractureContext, so GL contexts and
+ * programs survive across requests, and recently loaded images and
+ * transform sets are cached by path and modification time.
+ *
+ * One request per connection, a single line:
+ *   encode <priority> <SD|HD> <in image> <out.trn>
+ *   decode <priority> <magExp> <iterations> <in.trn> <out image>
+ *   stats
+ *   shutdown
+ * answered by one line starting with "ok" or "err". Paths are absolute
+ * and contain no whitespace; higher priorities run first.
+ */
+
+typedef struct serverOptions {
+    fractureOptions encoder;    /* for every worker's context */
+    size_t numWorkers;
+    size_t queueLength;         /* pending jobs before requests are refused */
+    size_t cacheEntries;        /* per cache */
+    imageWriteOptions output;   /* for decoded images */
+} serverOptions;
+
+void runServer(const char* socketPath, const serverOptions* so);
+
+/* argv: encode <in.png> <out.trn> <SD|HD> | decode <in.trn> <out.png> | stats | shutdown, then priority= mag= iterations= */
+int runClient(const char* socketPath, int argc, char** argv);
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef SHADERS_H
+#define SHADERS_H
+
+#include <stdlib.h>
+
+/*
+ * shader sources compiled into the binary by embedShaders.cmake, so the
+ * encoder does not depend on its working directory
+ */
+
+typedef struct embeddedShader {
+    const char* name;      /* file name, e.g. "calcSO.frag" */
+    const char* source;
+    size_t length;
+} embeddedShader;
+
+/* terminated by an entry with a NULL name */
+extern const embeddedShader embeddedShaders[];
+
+#endif
@@ -0,0 +1,98 @@
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+
+#include <stdlib.h>
+#include <math.h>
+
+/*
+ * one range block's transform: range = o + s * iso(domain)
+ *
+ * (d_i, d_j) index domain blocks in the decimated domain image, so the
+ * domain covers [d_i * d_size, (d_i + 1) * d_size) in the source image.
+ * iso is one of the eight rotations and flips of the domain block, see
+ * isometrySource; only the int engine searches them.
+ */
+typedef struct rangeTransform {
+    float MSE;
+    float s;
+    float o;
+    size_t d_i;
+    size_t d_j;
+    int iso;
+} rangeTransform;
+
+#define ISO_FLIP_X    1
+#define ISO_FLIP_Y    2
+#define ISO_TRANSPOSE 4
+#define NUM_ISOMETRIES 8
+
+/*
+ * the sample of a size x size domain block that isometry iso moves to
+ * (x, y): transposed first, then mirrored
+ */
+static inline void isometrySource(int iso, size_t size,
+    size_t x, size_t y, size_t* u, size_t* v)
+{
+    *u = (iso & ISO_TRANSPOSE) ? y : x;
+    *v = (iso & ISO_TRANSPOSE) ? x : y;
+    if (iso & ISO_FLIP_X) *u = size - 1 - *u;
+    if (iso & ISO_FLIP_Y) *v = size - 1 - *v;
+}
+
+#define FIT_EPSILON 0.0001f
+
+/* closed-form scale and offset fit, same arithmetic as calcSO.frag */
+static inline void fitSO(
+    float n, float sumD, float sumD2, float sumDr, float sumR, float sumR2,
+    rangeTransform* t)
+{
+    float S_lo = n * sumD2 + sumD * sumD;
+    float S, O, squaredError;
+    if (fabsf(S_lo) > FIT_EPSILON)
+    {
+        float S_hi = n * sumDr + sumR * sumD;
+        S = S_hi / S_lo;
+        S = S < -1.0f + FIT_EPSILON ? -1.0f + FIT_EPSILON : S;
+        S = S >  1.0f - FIT_EPSILON ?  1.0f - FIT_EPSILON : S;
+        O = (sumR - S * sumD) / n;
+        squaredError = S * (S * sumD2 + 2.0f * (O * sumD - sumDr));
+    }
+    else
+    {
+        S = 0.0f;
+        O = sumR / n;
+        squaredError = 0.0f;
+    }
+    squaredError += sumR2 + O * (n * O - 2.0f * sumR);
+    t->MSE = squaredError / n;
+    t->s = S;
+    t->o = O;
+}
+
+/* interleaves the bits of i and j, i in the low position */
+static inline size_t mortonIndex(size_t i, size_t j)
+{
+    size_t m = 0;
+    size_t b;
+    for (b = 0; (i >> b) | (j >> b); b++)
+    {
+        m |= ((i >> b) & 1) << (2 * b);
+        m |= ((j >> b) & 1) << (2 * b + 1);
+    }
+    return m;
+}
+
+/*
+ * argmin step: searchReduction.frag keeps the first of four candidates on
+ * ties, so of two equal MSEs the one earlier in Morton order wins
+ */
+static inline int betterTransform(const rangeTransform* a, const rangeTransform* b)
+{
+    if (a->MSE != b->MSE)
+    {
+        return a->MSE < b->MSE;
+    }
+    return mortonIndex(a->d_i, a->d_j) < mortonIndex(b->d_i, b->d_j);
+}
+
+#endif
@@ -6,5 +6,5 @@ void main()
     vec2 tc = gl_TexCoord[0].st;
     vec4 s1 = texture2DRect(RG_tex, tc);
     vec4 s2 = texture2DRect(BA_tex, tc);
-    gl_FragData[0] = vec4(s1.r, s1.g, s2.r, s2.g);
+    gl_FragData[0] = vec4(s1.r, s1.g, s2.r, 0.0);
 }
\ No newline at end of file
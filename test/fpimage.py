@@ -10,6 +10,12 @@ import glob
 import numpy
 import Image
 
+# native encoder and decoder, built with fracture as fracture.so
+try:
+    import fracture
+except ImportError:
+    fracture = None
+
 def readSt(f, fmt):
     buf = f.read(struct.calcsize(fmt))
     st = struct.unpack(fmt, buf)
@@ -22,26 +28,53 @@ def writeSt(f, fmt, *fields):
     buf = struct.pack(fmt, *fields)
     f.write(buf)
 
+fl32Align = 64
+fl32LayoutLinear = 0
+fl32LayoutTiled = 1
+
 def readFL32Image(filename):
     f = open(filename, 'rb')
+    fileLen = os.fstat(f.fileno()).st_size
     
     headerSigFmt = '!4s'
     sig = readSt1(f, headerSigFmt)
-    if   sig == "23lf":
-        headerAfterSigFmt = '<III'
+    if   sig == "23lv":
+        numChannels, width, height, version, headerSize, layout, tileW, tileH, rowStride = \
+            readSt(f, '<9I')
+        if version != 2:
+            raise SyntaxError("unsupported fl32 version %d" % version)
+        sampleFormat = '<f'
+    elif sig == "23lf":
+        # legacy: fracture's native size_t header, or our own '<4sIII'
+        numChannels, width, height = readSt(f, '<4xQQQ')
+        headerSize = 32
+        if headerSize + 4 * numChannels * width * height != fileLen:
+            f.seek(4)
+            numChannels, width, height = readSt(f, '<III')
+            headerSize = 16
+        layout = fl32LayoutLinear
         sampleFormat = '<f'
     elif sig == "fl32":
-        headerAfterSigFmt = '>III'
+        numChannels, width, height = readSt(f, '>III')
+        headerSize = 16
+        layout = fl32LayoutLinear
         sampleFormat = '>f'
     else:
         raise SyntaxError("not an fl32 file")
     
-    numChannels, width, height = readSt(f, headerAfterSigFmt)
-    
-    dataLen = width * height * numChannels
+    f.seek(headerSize)
     dataType = numpy.dtype(sampleFormat)
-    data = numpy.fromfile(f, dataType, dataLen)
-    data = numpy.reshape(data, (height, width, numChannels)) # [y, x, channel]
+    if layout == fl32LayoutTiled:
+        tilesX = (width + tileW - 1) / tileW
+        tilesY = (height + tileH - 1) / tileH
+        data = numpy.fromfile(f, dataType, tilesX * tilesY * tileH * tileW * numChannels)
+        data = numpy.reshape(data, (tilesY, tilesX, tileH, tileW, numChannels))
+        data = data.swapaxes(1, 2).reshape((tilesY * tileH, tilesX * tileW, numChannels))
+        data = data[:height, :width]
+    else:
+        dataLen = width * height * numChannels
+        data = numpy.fromfile(f, dataType, dataLen)
+        data = numpy.reshape(data, (height, width, numChannels)) # [y, x, channel]
     
     f.close()
     
@@ -56,11 +89,13 @@ def writeFL32Image(filename, data):
     data = numpy.asarray(data, numpy.dtype('<f'), 'C')
     buf = numpy.getbuffer(data)
     
-    sig = "23lf"
-    headerFmt = "<4sIII"
+    sig = "23lv"
+    headerFmt = "<4s9IQ16x"
+    rowStride = 4 * numChannels * width
     
     f = open(filename, 'wb')
-    writeSt(f, headerFmt, sig, numChannels, width, height)
+    writeSt(f, headerFmt, sig, numChannels, width, height,
+        2, fl32Align, fl32LayoutLinear, 0, 0, rowStride, len(buf))
     f.write(buf)
     f.close()
     
@@ -252,7 +287,7 @@ def encode(filename, d_size, r_size):
     return (orig_w, orig_h, d_size, r_size, transforms)
 
 transformAttrRE = re.compile(r'^#\s+(\w+)\s+=\s+(.*)$')
-transformLineRE = re.compile(r'^\[(\d+)\s+:\s+(\d+),\s+(\d+)\s+:\s+(\d+)\]\s+=\s+([-.\d]+)\s+\+\s+([-.\d]+)\s+\*\s+\[(\d+)\s+:\s+(\d+),\s+(\d+)\s+:\s+(\d+)\]$')
+transformLineRE = re.compile(r'^\[(\d+)\s+:\s+(\d+),\s+(\d+)\s+:\s+(\d+)\]\s+=\s+([-.\d]+)\s+\+\s+([-.\d]+)\s+\*\s+\[(\d+)\s+:\s+(\d+),\s+(\d+)\s+:\s+(\d+)\](?:\s+iso\s+(\d))?$')
 
 def saveTransformList(filename, (orig_w, orig_h, d_size, r_size, transforms)):
     f = open(filename, 'w')
@@ -260,9 +295,13 @@ def saveTransformList(filename, (orig_w, orig_h, d_size, r_size, transforms)):
     f.write("# orig_h = %d\n" % orig_h)
     f.write("# d_size = %d\n" % d_size)
     f.write("# r_size = %d\n" % r_size)
-    for (rs, o, s, ds) in transforms:
-        f.write("[%03d : %03d, %03d : %03d] = % f + % f * [%03d : %03d, %03d : %03d]\n" \
+    for t in transforms:
+        rs, o, s, ds = t[:4]
+        f.write("[%03d : %03d, %03d : %03d] = % f + % f * [%03d : %03d, %03d : %03d]" \
             % tuple(list(rs) + [o, s] + list(ds)))
+        if len(t) > 4 and t[4] != 0:
+            f.write(" iso %d" % t[4])
+        f.write("\n")
     f.close()
 
 def loadTransformList(filename):
@@ -286,7 +325,10 @@ def loadTransformList(filename):
             o = float(gs[4])
             s = float(gs[5])
             ds = tuple(int(d) for d in gs[6:10])
-            transforms.append((rs, o, s, ds))
+            if gs[10] is not None:
+                transforms.append((rs, o, s, ds, int(gs[10])))
+            else:
+                transforms.append((rs, o, s, ds))
     return (orig_w, orig_h, d_size, r_size, transforms)
 
 def decode(outputBasename, (orig_w, orig_h, d_size, r_size, transforms), magExp=0):
@@ -297,13 +339,22 @@ def decode(outputBasename, (orig_w, orig_h, d_size, r_size, transforms), magExp=
     for t in xrange(10):
         D = avgReduce(R, m)
         R = numpy.empty(dstShape, numpy.dtype('f'))
-        for rs, o, s, ds in transforms:
+        for tr in transforms:
+            rs, o, s, ds = tr[:4]
+            iso = tr[4] if len(tr) > 4 else 0
             z = magExp - m
             if z > 0:
                 dx1, dx2, dy1, dy2 = [d <<  z for d in ds]
             else:
                 dx1, dx2, dy1, dy2 = [d >> -z for d in ds]
             p = D[dy1 : dy2, dx1 : dx2]
+            # isometrySource in transform.h, as array operations
+            if iso & 1:
+                p = p[:, ::-1]
+            if iso & 2:
+                p = p[::-1, :]
+            if iso & 4:
+                p = p.T
             rx1, rx2, ry1, ry2 = [r << magExp for r in rs]
             R[ry1 : ry2, rx1 : rx2] = s * p + o
         
@@ -338,11 +389,18 @@ def main():
             outBaseName = '../build/Python-%s-HD-out' % srcBase
         if os.path.exists(trnPath) and not 'ovw' in mode:
             transformList = loadTransformList(trnPath)
+        elif 'native' in mode:
+            transformList = fracture.encode('../data/%s.png' % srcBase, d_size, r_size)
+            saveTransformList(trnPath, transformList)
         else:
             transformList = encode('../data/%s.png' % srcBase, d_size, r_size)
             saveTransformList(trnPath, transformList)
     
-    if 'dec' in mode:
+    if 'dec' in mode and 'native' in mode:
+        magExp = int(sys.argv[3]) if 'mag' in mode else 0
+        R = numpy.asarray(fracture.decode(transformList, magExp)) / 255.0
+        writePILImage(outBaseName + '_09.png', R)
+    elif 'dec' in mode:
         if 'mag' in mode:
             magExp = int(sys.argv[3])
             decode(outBaseName + '-%dx' % (1 << magExp), transformList, magExp)